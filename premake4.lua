@@ -1,11 +1,55 @@
 solution 'utilities'
     configurations {'release', 'debug'}
     location 'build'
+    project 'benchmark'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/mapped_file.hpp', 'source/pipeline.hpp', 'source/evt.hpp', 'source/dat.hpp', 'source/font.hpp', 'source/timecode.hpp', 'source/frames.hpp', 'source/benchmark.cpp'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+        configuration 'linux'
+            links {'pthread'}
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'macosx'
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'windows'
+            files {'.clang-format'}
     project 'crop'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/crop.cpp'}
+        files {'source/indexed_filename.hpp', 'source/crop.cpp'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+        configuration 'linux'
+            links {'pthread'}
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'macosx'
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'windows'
+            files {'.clang-format'}
+    project 'csv_to_es'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/mapped_file.hpp', 'source/csv_to_es.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -27,7 +71,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/timecode.hpp', 'source/cut.cpp'}
+        files {'source/timecode.hpp', 'source/time_index.hpp', 'source/indexed_filename.hpp', 'source/cut.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -49,7 +93,29 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/dat.hpp', 'source/dat_to_es.cpp'}
+        files {'source/pipeline.hpp', 'source/dat.hpp', 'source/dat_to_es.cpp'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+        configuration 'linux'
+            links {'pthread'}
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'macosx'
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'windows'
+            files {'.clang-format'}
+    project 'es_index'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/time_index.hpp', 'source/es_index.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -71,7 +137,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/es_to_csv.cpp'}
+        files {'source/pipeline.hpp', 'source/es_to_csv.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -93,7 +159,29 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/font.hpp', 'source/es_to_frames.cpp'}
+        files {'source/font.hpp', 'source/pipeline.hpp', 'source/timecode.hpp', 'source/frames.hpp', 'source/time_index.hpp', 'source/es_to_frames.cpp'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+        configuration 'linux'
+            links {'pthread'}
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'macosx'
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'windows'
+            files {'.clang-format'}
+    project 'es_to_npy'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/npy.hpp', 'source/es_to_npy.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -137,7 +225,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/event_rate.cpp'}
+        files {'source/time_index.hpp', 'source/event_rate.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -159,7 +247,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/evt.hpp', 'source/evt2_to_es.cpp'}
+        files {'source/mapped_file.hpp', 'source/pipeline.hpp', 'source/evt.hpp', 'source/evt2_to_es.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -181,7 +269,51 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/evt.hpp', 'source/evt3_to_es.cpp'}
+        files {'source/mapped_file.hpp', 'source/pipeline.hpp', 'source/evt.hpp', 'source/evt3_to_es.cpp'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+        configuration 'linux'
+            links {'pthread'}
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'macosx'
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'windows'
+            files {'.clang-format'}
+    project 'filter'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/timecode.hpp', 'source/time_index.hpp', 'source/filter.cpp'}
+        configuration 'release'
+            targetdir 'build/release'
+            defines {'NDEBUG'}
+            flags {'OptimizeSpeed'}
+        configuration 'debug'
+            targetdir 'build/debug'
+            defines {'DEBUG'}
+            flags {'Symbols'}
+        configuration 'linux'
+            links {'pthread'}
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'macosx'
+            buildoptions {'-std=c++11'}
+            linkoptions {'-std=c++11'}
+        configuration 'windows'
+            files {'.clang-format'}
+    project 'npy_to_es'
+        kind 'ConsoleApp'
+        language 'C++'
+        location 'build'
+        files {'source/mapped_file.hpp', 'source/npy.hpp', 'source/npy_to_es.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -225,7 +357,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/html.hpp', 'third_party/lodepng/lodepng.cpp', 'source/rainmaker.cpp'}
+        files {'source/html.hpp', 'source/time_index.hpp', 'third_party/lodepng/lodepng.cpp', 'source/rainmaker.cpp'}
         defines {'SEPIA_COMPILER_WORKING_DIRECTORY="' .. project().location .. '"'}
         configuration 'release'
             targetdir 'build/release'
@@ -270,7 +402,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/spatiospectrogram.cpp'}
+        files {'source/time_index.hpp', 'source/spatiospectrogram.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -292,7 +424,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/spectrogram.cpp', 'third_party/lodepng/lodepng.cpp'}
+        files {'source/time_index.hpp', 'source/spectrogram.cpp', 'third_party/lodepng/lodepng.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -314,7 +446,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/statistics.cpp'}
+        files {'source/fast_hash.hpp', 'source/npy.hpp', 'source/timecode.hpp', 'source/time_index.hpp', 'source/statistics.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
@@ -336,7 +468,7 @@ solution 'utilities'
         kind 'ConsoleApp'
         language 'C++'
         location 'build'
-        files {'source/synth.cpp'}
+        files {'source/time_index.hpp', 'source/synth.cpp'}
         configuration 'release'
             targetdir 'build/release'
             defines {'NDEBUG'}
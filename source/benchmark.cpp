@@ -0,0 +1,778 @@
+#include "../third_party/pontella/source/pontella.hpp"
+#include "../third_party/tarsier/source/hash.hpp"
+#include "dat.hpp"
+#include "evt.hpp"
+#include "fast_hash.hpp"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "frames.hpp"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+/// reference holds the decoders of earlier versions, used as baselines.
+namespace reference {
+    /// bytes_to_dvs_event converts raw bytes to a polarized event, resolving the layout for every event.
+    inline sepia::dvs_event bytes_to_dvs_event(std::array<uint8_t, 8> bytes, dat::header stream_header) {
+        if (stream_header.version < 2) {
+            return {
+                static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8)
+                    | (static_cast<uint64_t>(bytes[2]) << 16) | (static_cast<uint64_t>(bytes[3]) << 24),
+                static_cast<uint16_t>(static_cast<uint16_t>(bytes[4]) | (static_cast<uint16_t>(bytes[5] & 1) << 8)),
+                static_cast<uint16_t>(
+                    stream_header.height - 1
+                    - (static_cast<uint16_t>(bytes[5] >> 1) | (static_cast<uint16_t>(bytes[6] & 1) << 7))),
+                (bytes[6] & 0b10) == 0b10,
+            };
+        }
+        return {
+            static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8)
+                | (static_cast<uint64_t>(bytes[2]) << 16) | (static_cast<uint64_t>(bytes[3]) << 24),
+            static_cast<uint16_t>(static_cast<uint16_t>(bytes[4]) | (static_cast<uint16_t>(bytes[5] & 0b111111) << 8)),
+            static_cast<uint16_t>(
+                stream_header.height - 1
+                - (static_cast<uint16_t>(bytes[5] >> 6) | (static_cast<uint16_t>(bytes[6]) << 2)
+                   | (static_cast<uint16_t>(bytes[7] & 0b1111) << 10))),
+            (bytes[7] & 0b10000) == 0b10000,
+        };
+    }
+
+    /// td_observable dispatches DVS events from a td stream, reading one event at a time.
+    /// The header must be read from the stream before calling this function.
+    template <typename HandleEvent>
+    inline void td_observable(std::istream& stream, dat::header stream_header, HandleEvent handle_event) {
+        uint64_t previous_t = 0;
+        for (;;) {
+            std::array<uint8_t, 8> bytes;
+            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+            if (stream.eof()) {
+                break;
+            }
+            const auto dvs_event = reference::bytes_to_dvs_event(bytes, stream_header);
+            if (dvs_event.t >= previous_t && dvs_event.x < stream_header.width && dvs_event.y < stream_header.height) {
+                handle_event(dvs_event);
+                previous_t = dvs_event.t;
+            }
+        }
+    }
+
+    /// observable_2 dispatches DVS events from a stream, applying the type switch to every word.
+    /// The header must be read from the stream before calling this function.
+    template <typename HandleEvent>
+    inline void
+    observable_2(std::istream& stream, evt::header stream_header, bool normalize, HandleEvent handle_event) {
+        uint64_t offset = 0;
+        uint64_t t_without_offset = 0;
+        uint64_t reference_t = 0;
+        uint64_t first_t = normalize ? std::numeric_limits<uint64_t>::max() : 0;
+        uint64_t previous_t = 0;
+        std::vector<uint8_t> bytes(1 << 16);
+        for (;;) {
+            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+            for (std::size_t index = 0; index < static_cast<std::size_t>(stream.gcount() / 4) * 4; index += 4) {
+                switch (bytes[index + 3] >> 4) {
+                    case 0b0000:   // CD_OFF
+                    case 0b0001: { // CD_ON
+                        sepia::dvs_event event = {};
+                        event.t = reference_t
+                                  + ((static_cast<uint64_t>(bytes[index + 2]) >> 6)
+                                     | (static_cast<uint64_t>(bytes[index + 3] & 0b1111) << 2));
+                        if (first_t == std::numeric_limits<uint64_t>::max()) {
+                            first_t = event.t;
+                        }
+                        event.t -= first_t;
+                        if (event.t < previous_t) {
+                            event.t = previous_t;
+                        } else {
+                            previous_t = event.t;
+                        }
+                        event.x = static_cast<uint16_t>(bytes[index + 1] >> 3)
+                                  | (static_cast<uint16_t>(bytes[index + 2] & 0b111111) << 5);
+                        event.y = static_cast<uint16_t>(bytes[index])
+                                  | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8);
+                        event.is_increase = (bytes[index + 3] >> 4) == 0b0001;
+                        if (event.x < stream_header.width && event.y < stream_header.height) {
+                            event.y = stream_header.height - 1 - event.y;
+                            handle_event(event);
+                        } else {
+                            std::cerr << "out of bounds event (t=" << event.t << ", x=" << event.x << ", y=" << event.y
+                                      << ", on=" << (event.is_increase ? "true" : "false") << ")" << std::endl;
+                        }
+                        break;
+                    }
+                    case 0b1000: { // EVT_TIME_HIGH
+                        const auto new_t_without_offset =
+                            ((static_cast<uint32_t>(bytes[index]) | (static_cast<uint32_t>(bytes[index + 1]) << 8)
+                              | (static_cast<uint32_t>(bytes[index + 2]) << 16)
+                              | (static_cast<uint32_t>(bytes[index + 3] & 0b1111) << 24)))
+                            << 6;
+                        if (new_t_without_offset < t_without_offset) {
+                            offset += (1ull << 34);
+                        }
+                        t_without_offset = new_t_without_offset;
+                        reference_t = t_without_offset + offset;
+                        break;
+                    }
+                    case 0b1010: // EXT_TRIGGER
+                        break;
+                    case 0b1110: // OTHERS
+                        break;
+                    case 0b1111: // CONTINUED
+                        break;
+                }
+            }
+            if (stream.eof()) {
+                break;
+            }
+        }
+    }
+
+    /// observable_3 dispatches DVS events from a stream, testing vector masks bit by bit.
+    /// The header must be read from the stream before calling this function.
+    template <typename HandleEvent>
+    inline void
+    observable_3(std::istream& stream, evt::header stream_header, bool normalize, HandleEvent handle_event) {
+        uint32_t previous_msb_t = 0;
+        uint32_t previous_lsb_t = 0;
+        uint32_t overflows = 0;
+        uint64_t first_t = normalize ? std::numeric_limits<uint64_t>::max() : 0;
+        sepia::dvs_event event = {};
+        std::vector<uint8_t> bytes(1 << 16);
+        for (;;) {
+            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+            for (std::size_t index = 0; index < static_cast<std::size_t>(stream.gcount() / 2) * 2; index += 2) {
+                switch (bytes[index + 1] >> 4) {
+                    case 0b0000: // EVT_ADDR_Y
+                        event.y = static_cast<uint16_t>(
+                            stream_header.height - 1
+                            - (bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8)));
+                        break;
+                    case 0b0001:
+                        break;
+                    case 0b0010: // EVT_ADDR_X
+                        event.x = static_cast<uint16_t>(
+                            bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8));
+                        event.is_increase = ((bytes[index + 1] >> 3) & 1) == 1;
+                        if (event.x < stream_header.width && event.y < stream_header.height) {
+                            handle_event(event);
+                        } else {
+                            std::cerr << "out of bounds event (t=" << event.t << ", x=" << event.x << ", y=" << event.y
+                                      << ", on=" << (event.is_increase ? "true" : "false") << ")" << std::endl;
+                        }
+                        break;
+                    case 0b0011: // VECT_BASE_X
+                        event.x = static_cast<uint16_t>(
+                            bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8));
+                        event.is_increase = ((bytes[index + 1] >> 3) & 1) == 1;
+                        break;
+                    case 0b0100: // VECT_12
+                        for (uint8_t bit = 0; bit < 8; ++bit) {
+                            if (((bytes[index] >> bit) & 1) == 1) {
+                                if (event.x < stream_header.width && event.y < stream_header.height) {
+                                    handle_event(event);
+                                }
+                            }
+                            ++event.x;
+                        }
+                        for (uint8_t bit = 0; bit < 4; ++bit) {
+                            if (((bytes[index + 1] >> bit) & 1) == 1) {
+                                if (event.x < stream_header.width && event.y < stream_header.height) {
+                                    handle_event(event);
+                                }
+                            }
+                            ++event.x;
+                        }
+                        break;
+                    case 0b0101: // VECT_8
+                        for (uint8_t bit = 0; bit < 8; ++bit) {
+                            if (((bytes[index] >> bit) & 1) == 1) {
+                                if (event.x < stream_header.width && event.y < stream_header.height) {
+                                    handle_event(event);
+                                }
+                            }
+                            ++event.x;
+                        }
+                        break;
+                    case 0b0110: { // EVT_TIME_LOW
+                        const auto lsb_t = static_cast<uint32_t>(
+                            bytes[index] | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8));
+                        if (lsb_t != previous_lsb_t) {
+                            previous_lsb_t = lsb_t;
+                            auto t = static_cast<uint64_t>(previous_lsb_t | (previous_msb_t << 12))
+                                     + (static_cast<uint64_t>(overflows) << 24);
+                            if (first_t == std::numeric_limits<uint64_t>::max()) {
+                                first_t = t;
+                            }
+                            t -= first_t;
+                            if (t >= event.t) {
+                                event.t = t;
+                            }
+                        }
+                        break;
+                    }
+                    case 0b0111:
+                        break;
+                    case 0b1000: { // EVT_TIME_HIGH
+                        const auto msb_t = static_cast<uint32_t>(
+                            bytes[index] | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8));
+                        if (msb_t != previous_msb_t) {
+                            if (msb_t > previous_msb_t) {
+                                if (msb_t - previous_msb_t < static_cast<uint32_t>((1 << 12) - 2)) {
+                                    previous_lsb_t = 0;
+                                    previous_msb_t = msb_t;
+                                }
+                            } else {
+                                if (previous_msb_t - msb_t > static_cast<uint32_t>((1 << 12) - 2)) {
+                                    ++overflows;
+                                    previous_lsb_t = 0;
+                                    previous_msb_t = msb_t;
+                                }
+                            }
+                            auto t = static_cast<uint64_t>(previous_lsb_t | (previous_msb_t << 12))
+                                     + (static_cast<uint64_t>(overflows) << 24);
+                            if (first_t == std::numeric_limits<uint64_t>::max()) {
+                                first_t = t;
+                            }
+                            t -= first_t;
+                            if (t >= event.t) {
+                                event.t = t;
+                            }
+                        }
+                    }
+                    case 0b1001:
+                        break;
+                    case 0b1010: // EXT_TRIGGER
+                        break;
+                    case 0b1011:
+                    case 0b1100:
+                    case 0b1101:
+                    case 0b1110:
+                    case 0b1111:
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (stream.eof()) {
+                break;
+            }
+        }
+    }
+}
+
+/// sensor_header is the geometry of the generated recordings.
+constexpr evt::header sensor_header{1280, 720};
+
+/// sink counts and checksums the dispatched events, so that two decoders can be compared
+/// and their loops cannot be optimized away.
+struct sink {
+    uint64_t events = 0;
+    uint64_t checksum = 0;
+
+    void operator()(const sepia::dvs_event& event) {
+        ++events;
+        checksum = checksum * 1099511628211ull
+                   + (event.t ^ (static_cast<uint64_t>(event.x) << 32) ^ (static_cast<uint64_t>(event.y) << 48)
+                      ^ (event.is_increase ? 1 : 0));
+    }
+};
+
+/// generated_recording holds the bytes of a generated file (without header) and its number of events.
+struct generated_recording {
+    std::string bytes;
+    std::size_t events;
+};
+
+/// push_word_2 appends a little-endian EVT2 word.
+inline void push_word_2(std::string& bytes, uint32_t word) {
+    for (uint8_t byte = 0; byte < 4; ++byte) {
+        bytes.push_back(static_cast<char>((word >> (byte * 8)) & 0xff));
+    }
+}
+
+/// generate_2 generates an EVT2 recording with rate events per microsecond (between 1 and 64),
+/// and an EVT_TIME_HIGH word every 64 microseconds.
+inline generated_recording generate_2(std::size_t events, uint32_t rate) {
+    std::mt19937_64 engine(42);
+    generated_recording recording{{}, events};
+    recording.bytes.reserve(events * 4 + events / rate);
+    for (std::size_t index = 0; index < events; ++index) {
+        const auto t = static_cast<uint32_t>(index / rate);
+        if (index % (static_cast<std::size_t>(rate) * 64) == 0) {
+            push_word_2(recording.bytes, (0b1000u << 28) | ((t >> 6) & 0xfffffff));
+        }
+        const auto x = static_cast<uint32_t>(engine() % sensor_header.width);
+        const auto y = static_cast<uint32_t>(engine() % sensor_header.height);
+        push_word_2(
+            recording.bytes,
+            (static_cast<uint32_t>(engine() & 1) << 28) | ((t & 0b111111) << 22) | (x << 11) | y);
+    }
+    return recording;
+}
+
+/// push_word_3 appends a little-endian EVT3 word.
+inline void push_word_3(std::string& bytes, uint8_t type, uint16_t payload) {
+    bytes.push_back(static_cast<char>(payload & 0xff));
+    bytes.push_back(static_cast<char>((type << 4) | ((payload >> 8) & 0b1111)));
+}
+
+/// generate_vectors_3 generates a busy EVT3 recording made of rows of VECT_12 or VECT_8 words.
+/// Every row starts with timestamp, EVT_ADDR_Y and VECT_BASE_X words, followed by up to 16 vectors
+/// whose masks have on average three quarters of their bits set.
+inline generated_recording generate_vectors_3(std::size_t events, uint16_t bits) {
+    std::mt19937_64 engine(42);
+    generated_recording recording{{}, 0};
+    const uint32_t full_mask = (1u << bits) - 1;
+    uint64_t t = 0;
+    uint32_t msb_t = std::numeric_limits<uint32_t>::max();
+    while (recording.events < events) {
+        ++t;
+        if (((t >> 12) & 0xfff) != msb_t) {
+            msb_t = static_cast<uint32_t>((t >> 12) & 0xfff);
+            push_word_3(recording.bytes, 0b1000, static_cast<uint16_t>(msb_t));
+        }
+        push_word_3(recording.bytes, 0b0110, static_cast<uint16_t>(t & 0xfff));
+        push_word_3(recording.bytes, 0b0000, static_cast<uint16_t>(engine() % sensor_header.height));
+        const auto vectors = 1 + engine() % 16;
+        const auto polarity = static_cast<uint16_t>((engine() & 1) << 11);
+        push_word_3(
+            recording.bytes,
+            0b0011,
+            static_cast<uint16_t>(polarity | (engine() % (sensor_header.width - vectors * bits + 1))));
+        for (std::size_t vector = 0; vector < vectors; ++vector) {
+            const auto mask = static_cast<uint32_t>(engine() | engine()) & full_mask;
+            push_word_3(recording.bytes, bits == 12 ? 0b0100 : 0b0101, static_cast<uint16_t>(mask));
+#if defined(__GNUC__)
+            recording.events += static_cast<std::size_t>(__builtin_popcount(mask));
+#else
+            for (auto remaining = mask; remaining != 0; remaining &= remaining - 1) {
+                ++recording.events;
+            }
+#endif
+        }
+    }
+    return recording;
+}
+
+/// generate_td generates a td recording (version 2 layout) with one event every microsecond on average.
+inline generated_recording generate_td(std::size_t events) {
+    std::mt19937_64 engine(42);
+    generated_recording recording{{}, events};
+    recording.bytes.reserve(events * 8);
+    uint32_t t = 0;
+    for (std::size_t index = 0; index < events; ++index) {
+        t += static_cast<uint32_t>(engine() % 3);
+        const auto x = static_cast<uint32_t>(engine() % sensor_header.width);
+        const auto y = static_cast<uint32_t>(engine() % sensor_header.height);
+        const auto is_increase = static_cast<uint32_t>(engine() & 1);
+        const uint64_t word = static_cast<uint64_t>(t) | (static_cast<uint64_t>(x) << 32)
+                              | (static_cast<uint64_t>(y) << 46) | (static_cast<uint64_t>(is_increase) << 60);
+        for (uint8_t byte = 0; byte < 8; ++byte) {
+            recording.bytes.push_back(static_cast<char>((word >> (byte * 8)) & 0xff));
+        }
+    }
+    return recording;
+}
+
+/// measure runs decode repeats times on a fresh stream over the recording's bytes,
+/// prints the best throughput in millions of events per second, and returns the sink of the last run.
+template <typename Decode>
+inline sink measure(const std::string& name, const generated_recording& recording, std::size_t repeats, Decode decode) {
+    sink result;
+    auto best = std::numeric_limits<double>::infinity();
+    for (std::size_t repeat = 0; repeat < repeats; ++repeat) {
+        std::istringstream stream(recording.bytes);
+        result = sink();
+        const auto begin = std::chrono::steady_clock::now();
+        decode(stream, result);
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - begin).count());
+    }
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << static_cast<double>(result.events) / best / 1e6 << " MEv/s" << std::endl;
+    return result;
+}
+
+/// compare throws if two decoders dispatched different events.
+inline void compare(const std::string& name, const sink& expected, const sink& result) {
+    if (expected.events != result.events || expected.checksum != result.checksum) {
+        throw std::runtime_error(name + " does not dispatch the same events as the reference decoder");
+    }
+}
+
+/// benchmark_evt2 compares the EVT2 decoders on a sparse and a busy recording.
+inline void benchmark_evt2(std::size_t events, std::size_t repeats) {
+    for (const uint32_t rate : {1, 16}) {
+        const auto recording = generate_2(events, rate);
+        const auto name = std::string("evt2 ") + std::to_string(rate) + " ev/us";
+        const auto expected =
+            measure(name + " (old)", recording, repeats, [](std::istream& stream, sink& result) {
+                reference::observable_2(stream, sensor_header, false, [&](sepia::dvs_event event) {
+                    result(event);
+                });
+            });
+        compare(
+            name,
+            expected,
+            measure(name + " (new)", recording, repeats, [](std::istream& stream, sink& result) {
+                evt::observable_2(stream, sensor_header, false, [&](sepia::dvs_event event) {
+                    result(event);
+                });
+            }));
+    }
+}
+
+/// benchmark_evt3 compares the EVT3 decoders on dense VECT_12 and VECT_8 recordings.
+inline void benchmark_evt3(std::size_t events, std::size_t repeats) {
+    for (const uint16_t bits : {12, 8}) {
+        const auto recording = generate_vectors_3(events, bits);
+        const auto name = std::string("evt3 VECT_") + std::to_string(bits);
+        const auto expected =
+            measure(name + " (old)", recording, repeats, [](std::istream& stream, sink& result) {
+                reference::observable_3(stream, sensor_header, false, [&](sepia::dvs_event event) {
+                    result(event);
+                });
+            });
+        compare(
+            name,
+            expected,
+            measure(name + " (new)", recording, repeats, [](std::istream& stream, sink& result) {
+                evt::observable_3(stream, sensor_header, false, [&](sepia::dvs_event event) {
+                    result(event);
+                });
+            }));
+    }
+}
+
+/// benchmark_dat compares the td decoders.
+inline void benchmark_dat(std::size_t events, std::size_t repeats) {
+    const auto recording = generate_td(events);
+    const dat::header stream_header{2, sensor_header.width, sensor_header.height};
+    const auto expected = measure("dat td (old)", recording, repeats, [&](std::istream& stream, sink& result) {
+        reference::td_observable(stream, stream_header, [&](sepia::dvs_event event) {
+            result(event);
+        });
+    });
+    compare("dat td", expected, measure("dat td (new)", recording, repeats, [&](std::istream& stream, sink& result) {
+                dat::td_observable(stream, stream_header, [&](sepia::dvs_event event) {
+                    result(event);
+                });
+            }));
+}
+
+/// frames_tau and frames_frametime are es_to_frames' default decay and time between frames, in microseconds.
+constexpr uint64_t frames_tau = 200000;
+constexpr uint64_t frames_frametime = 20000;
+
+/// generate_events generates uniformly distributed DVS events, ten every microsecond.
+inline std::vector<sepia::dvs_event> generate_events(std::size_t events) {
+    std::mt19937_64 engine(42);
+    std::vector<sepia::dvs_event> result(events);
+    for (std::size_t index = 0; index < events; ++index) {
+        result[index].t = index / 10;
+        result[index].x = static_cast<uint16_t>(engine() % sensor_header.width);
+        result[index].y = static_cast<uint16_t>(engine() % sensor_header.height);
+        result[index].is_increase = (engine() & 1) == 1;
+    }
+    return result;
+}
+
+/// render applies events to the state of a decay style and paints a frame every frames_frametime microseconds,
+/// as es_to_frames does with its default settings, and returns the number of frames.
+template <style decay_style>
+inline std::size_t render(const std::vector<sepia::dvs_event>& events, frame& output_frame) {
+    state style_state;
+    kernel<decay_style>::resize(
+        style_state, static_cast<std::size_t>(sensor_header.width) * sensor_header.height, frames_tau);
+    std::size_t frames = 0;
+    auto frame_t = events.front().t;
+    for (const auto& event : events) {
+        while (event.t >= frame_t) {
+            output_frame.paste_state<decay_style>(
+                sensor_header.width,
+                sensor_header.height,
+                style_state,
+                0,
+                0,
+                frames_tau,
+                color(0xf4, 0xc2, 0x0d),
+                color(0x1e, 0x88, 0xe5),
+                color(0x19, 0x19, 0x19),
+                frame_t,
+                0.01f,
+                1.0f,
+                true);
+            ++frames;
+            frame_t += frames_frametime;
+        }
+        kernel<decay_style>::update(
+            style_state, event.x + event.y * sensor_header.width, event.t, event.is_increase, frames_tau);
+    }
+    return frames;
+}
+
+/// benchmark_frames renders generated events with each es_to_frames style, on a single thread.
+inline void benchmark_frames(std::size_t events, std::size_t repeats) {
+    const auto generated_events = generate_events(events);
+    frame output_frame(sensor_header.width, sensor_header.height, 1, 1);
+    const std::vector<std::pair<std::string, std::size_t (*)(const std::vector<sepia::dvs_event>&, frame&)>> styles{
+        {"exponential", render<style::exponential>},
+        {"linear", render<style::linear>},
+        {"window", render<style::window>},
+        {"cumulative", render<style::cumulative>},
+        {"cumulative-shared", render<style::cumulative_shared>},
+    };
+    for (const auto& name_and_render : styles) {
+        std::size_t frames = 0;
+        auto best = std::numeric_limits<double>::infinity();
+        for (std::size_t repeat = 0; repeat < repeats; ++repeat) {
+            const auto begin = std::chrono::steady_clock::now();
+            frames = name_and_render.second(generated_events, output_frame);
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - begin).count());
+        }
+        std::cout << std::left << std::setw(32) << ("frames " + name_and_render.first) << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(10) << static_cast<double>(events) / best / 1e6 << " MEv/s"
+                  << std::setw(10) << static_cast<double>(frames) / best << " frames/s" << std::endl;
+    }
+}
+
+/// fast_digest returns the fast hash of a sequence of bytes.
+inline std::pair<uint64_t, uint64_t> fast_digest(const uint8_t* bytes, std::size_t size) {
+    fast_hash::hash hash;
+    hash.update(bytes, size);
+    return hash.digest();
+}
+
+/// count_flipped_bits adds the differing bits of two digests to counts.
+inline void count_flipped_bits(
+    std::pair<uint64_t, uint64_t> first,
+    std::pair<uint64_t, uint64_t> second,
+    std::array<uint64_t, 128>& counts) {
+    for (uint8_t bit = 0; bit < 64; ++bit) {
+        counts[bit] += ((first.first ^ second.first) >> bit) & 1;
+        counts[64 + bit] += ((first.second ^ second.second) >> bit) & 1;
+    }
+}
+
+/// avalanche_bias returns the largest deviation from 1/2 of the probability that an output bit flips
+/// when an input bit flips, and the limit of that deviation for an ideal hash (six standard deviations).
+/// Inputs of up to 64 bytes are tested for every pair of input and output bits, larger inputs for every output
+/// bit with randomly chosen input bits.
+inline std::pair<double, double> avalanche_bias(std::size_t size, std::size_t samples, std::mt19937_64& engine) {
+    std::vector<uint8_t> bytes(size);
+    auto worst = 0.0;
+    if (size <= 64) {
+        std::vector<std::array<uint64_t, 128>> counts(size * 8, std::array<uint64_t, 128>{});
+        for (std::size_t sample = 0; sample < samples; ++sample) {
+            std::generate(bytes.begin(), bytes.end(), [&]() { return static_cast<uint8_t>(engine()); });
+            const auto reference_digest = fast_digest(bytes.data(), size);
+            for (std::size_t bit = 0; bit < size * 8; ++bit) {
+                bytes[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+                count_flipped_bits(reference_digest, fast_digest(bytes.data(), size), counts[bit]);
+                bytes[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+            }
+        }
+        for (const auto& input_counts : counts) {
+            for (const auto count : input_counts) {
+                worst = std::max(worst, std::abs(static_cast<double>(count) / samples - 0.5));
+            }
+        }
+    } else {
+        std::array<uint64_t, 128> counts{};
+        const std::size_t flips_per_input = 64;
+        for (std::size_t sample = 0; sample < samples; sample += flips_per_input) {
+            std::generate(bytes.begin(), bytes.end(), [&]() { return static_cast<uint8_t>(engine()); });
+            const auto reference_digest = fast_digest(bytes.data(), size);
+            for (std::size_t flip = 0; flip < flips_per_input; ++flip) {
+                const auto bit = engine() % (size * 8);
+                bytes[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+                count_flipped_bits(reference_digest, fast_digest(bytes.data(), size), counts);
+                bytes[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+            }
+        }
+        samples = (samples / flips_per_input) * flips_per_input;
+        for (const auto count : counts) {
+            worst = std::max(worst, std::abs(static_cast<double>(count) / samples - 0.5));
+        }
+    }
+    return {worst, 6 * 0.5 / std::sqrt(static_cast<double>(samples))};
+}
+
+/// check_collisions throws if two of the digests are equal, or if their low 32 bits collide
+/// significantly more often than those of an ideal hash, and prints the number of 32 bits collisions.
+inline void check_collisions(const std::string& name, std::vector<std::pair<uint64_t, uint64_t>> digests) {
+    std::sort(digests.begin(), digests.end());
+    if (std::adjacent_find(digests.begin(), digests.end()) != digests.end()) {
+        throw std::runtime_error("the fast hash has collisions on " + name);
+    }
+    std::vector<uint32_t> lows(digests.size());
+    std::transform(digests.begin(), digests.end(), lows.begin(), [](std::pair<uint64_t, uint64_t> digest) {
+        return static_cast<uint32_t>(digest.first);
+    });
+    std::sort(lows.begin(), lows.end());
+    uint64_t collisions = 0;
+    for (std::size_t begin = 0, end = 0; begin < lows.size(); begin = end) {
+        for (end = begin + 1; end < lows.size() && lows[end] == lows[begin]; ++end) {
+        }
+        collisions += (end - begin) * (end - begin - 1) / 2;
+    }
+    const auto expected =
+        static_cast<double>(lows.size()) * static_cast<double>(lows.size() - 1) / std::pow(2.0, 33);
+    std::cout << std::left << std::setw(32) << ("hash collisions " + name) << std::right << std::setw(10)
+              << collisions << " 32 bits collisions (" << std::fixed << std::setprecision(1) << expected
+              << " expected)" << std::endl;
+    if (collisions > expected + 6 * std::sqrt(expected) + 6) {
+        throw std::runtime_error("the fast hash has too many 32 bits collisions on " + name);
+    }
+}
+
+/// benchmark_hash compares the fast hash with tarsier's hash on timestamps, and checks the fast hash's avalanche
+/// and collisions.
+inline void benchmark_hash(std::size_t events, std::size_t repeats) {
+    std::mt19937_64 engine(42);
+    std::vector<uint64_t> ts(events);
+    std::generate(ts.begin(), ts.end(), [&]() { return engine(); });
+    // digest_low is volatile so that the hash loops cannot be optimized away
+    volatile uint64_t digest_low = 0;
+    const auto print = [&](const std::string& name, double duration) {
+        std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << static_cast<double>(events) / duration / 1e6 << " MEv/s" << std::endl;
+    };
+    {
+        auto best = std::numeric_limits<double>::infinity();
+        for (std::size_t repeat = 0; repeat < repeats; ++repeat) {
+            const auto begin = std::chrono::steady_clock::now();
+            {
+                auto t_hash = tarsier::make_hash<uint64_t>(
+                    [&](std::pair<uint64_t, uint64_t> hash_value) { digest_low = hash_value.first; });
+                for (const auto t : ts) {
+                    t_hash(t);
+                }
+            }
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - begin).count());
+        }
+        print("hash t (tarsier)", best);
+    }
+    {
+        auto best = std::numeric_limits<double>::infinity();
+        for (std::size_t repeat = 0; repeat < repeats; ++repeat) {
+            const auto begin = std::chrono::steady_clock::now();
+            fast_hash::hash t_hash;
+            t_hash.update_values(ts.data(), ts.size());
+            digest_low = t_hash.digest().first;
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - begin).count());
+        }
+        print("hash t (fast)", best);
+    }
+    for (const auto& size_and_samples : std::vector<std::pair<std::size_t, std::size_t>>{
+             {3, 20000}, {16, 10000}, {64, 4000}, {1100, 1 << 18}, {5000, 1 << 18}}) {
+        const auto bias_and_limit = avalanche_bias(size_and_samples.first, size_and_samples.second, engine);
+        std::cout << std::left << std::setw(32) << ("hash avalanche " + std::to_string(size_and_samples.first) + " B")
+                  << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+                  << bias_and_limit.first * 100 << " % worst bias (" << bias_and_limit.second * 100 << " % limit)"
+                  << std::endl;
+        if (bias_and_limit.first > bias_and_limit.second) {
+            throw std::runtime_error("the fast hash fails the avalanche check");
+        }
+    }
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> digests(1 << 21);
+        for (uint64_t index = 0; index < digests.size(); ++index) {
+            digests[index] = fast_digest(reinterpret_cast<const uint8_t*>(&index), sizeof(index));
+        }
+        check_collisions("counters", std::move(digests));
+    }
+    {
+        std::vector<uint8_t> zeros(1 << 13, 0);
+        std::vector<std::pair<uint64_t, uint64_t>> digests(zeros.size());
+        for (std::size_t size = 0; size < zeros.size(); ++size) {
+            digests[size] = fast_digest(zeros.data(), size);
+        }
+        check_collisions("zero lengths", std::move(digests));
+    }
+    {
+        std::vector<uint8_t> bytes(1100, 0);
+        std::vector<std::pair<uint64_t, uint64_t>> digests;
+        digests.reserve(bytes.size() * 255);
+        for (std::size_t index = 0; index < bytes.size(); ++index) {
+            for (uint16_t value = 1; value < 256; ++value) {
+                bytes[index] = static_cast<uint8_t>(value);
+                digests.push_back(fast_digest(bytes.data(), bytes.size()));
+            }
+            bytes[index] = 0;
+        }
+        check_collisions("single bytes", std::move(digests));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {"benchmark measures the throughput of the decoders, renderers and hashes on generated data",
+         "    The earlier decoders are measured as well, and the decoded events are compared",
+         "Syntax: ./benchmark [options] [suite...]",
+         "    suite is one of evt2, evt3, dat, frames, hash, all the suites are run if none is given",
+         "Available options:",
+         "    -e events, --events events       sets the number of generated events per recording",
+         "                                         defaults to 20000000",
+         "    -r repeats, --repeats repeats    sets the number of runs per decoder or style, the fastest is reported",
+         "                                         defaults to 3",
+         "    -h, --help                       shows this help message"},
+        argc,
+        argv,
+        -1,
+        {
+            {"events", {"e"}},
+            {"repeats", {"r"}},
+        },
+        {},
+        [](pontella::command command) {
+            std::size_t events = 20000000;
+            {
+                const auto name_and_argument = command.options.find("events");
+                if (name_and_argument != command.options.end()) {
+                    events = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (events == 0) {
+                        throw std::runtime_error("the number of events must be larger than 0");
+                    }
+                }
+            }
+            std::size_t repeats = 3;
+            {
+                const auto name_and_argument = command.options.find("repeats");
+                if (name_and_argument != command.options.end()) {
+                    repeats = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (repeats == 0) {
+                        throw std::runtime_error("the number of repeats must be larger than 0");
+                    }
+                }
+            }
+            const std::vector<std::pair<std::string, std::function<void(std::size_t, std::size_t)>>> suites{
+                {"evt2", benchmark_evt2},
+                {"evt3", benchmark_evt3},
+                {"dat", benchmark_dat},
+                {"frames", benchmark_frames},
+                {"hash", benchmark_hash},
+            };
+            for (const auto& argument : command.arguments) {
+                if (std::none_of(
+                        suites.begin(),
+                        suites.end(),
+                        [&](const std::pair<std::string, std::function<void(std::size_t, std::size_t)>>& suite) {
+                            return suite.first == argument;
+                        })) {
+                    throw std::runtime_error("unknown suite " + argument);
+                }
+            }
+            for (const auto& suite : suites) {
+                if (command.arguments.empty()
+                    || std::find(command.arguments.begin(), command.arguments.end(), suite.first)
+                           != command.arguments.end()) {
+                    suite.second(events, repeats);
+                }
+            }
+        });
+}
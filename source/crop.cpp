@@ -1,33 +1,91 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
+#include "indexed_filename.hpp"
+#include <map>
+#include <set>
 
-/// crop creates a new Event Stream file with only events from the given region.
+/// region is a rectangle written to a dedicated output.
+struct region {
+    std::string filename;
+    uint16_t left;
+    uint16_t bottom;
+    uint16_t width;
+    uint16_t height;
+};
+
+/// crop creates new Event Stream files with only events from the given regions.
+/// A per-pixel lookup table maps each pixel to the list of regions that contain it,
+/// hence the cost per event does not depend on the number of regions.
 template <sepia::type event_stream_type>
 void crop(
     const sepia::header& header,
     std::unique_ptr<std::istream> input_stream,
-    std::unique_ptr<std::ostream> output_stream,
-    uint16_t left,
-    uint16_t bottom,
-    uint16_t width,
-    uint16_t height,
+    const std::vector<region>& regions,
     bool preserve_offset) {
-    const auto right = left + width;
-    const auto top = bottom + height;
+    // pixel_to_set maps each pixel to a set of regions, stored in set_regions between set_begins[set] and
+    // set_begins[set + 1]. The set 0 is empty. Regions are added in order, hence sets are built by appending
+    // a region to an existing set, and identical sets are shared.
+    std::vector<uint32_t> pixel_to_set(static_cast<std::size_t>(header.width) * header.height, 0);
+    std::vector<std::vector<uint32_t>> sets(1);
+    {
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> set_and_region_to_set;
+        for (uint32_t region_index = 0; region_index < regions.size(); ++region_index) {
+            const auto& crop_region = regions[region_index];
+            for (uint32_t y = crop_region.bottom; y < crop_region.bottom + crop_region.height; ++y) {
+                auto previous_set = std::numeric_limits<uint32_t>::max();
+                uint32_t next_set = 0;
+                for (uint32_t x = crop_region.left; x < crop_region.left + crop_region.width; ++x) {
+                    auto& set = pixel_to_set[x + y * header.width];
+                    if (set != previous_set) {
+                        previous_set = set;
+                        const auto set_and_region = std::make_pair(set, region_index);
+                        const auto set_and_region_and_set = set_and_region_to_set.find(set_and_region);
+                        if (set_and_region_and_set == set_and_region_to_set.end()) {
+                            next_set = static_cast<uint32_t>(sets.size());
+                            sets.push_back(sets[set]);
+                            sets.back().push_back(region_index);
+                            set_and_region_to_set.insert({set_and_region, next_set});
+                        } else {
+                            next_set = set_and_region_and_set->second;
+                        }
+                    }
+                    set = next_set;
+                }
+            }
+        }
+    }
+    std::vector<std::size_t> set_begins;
+    std::vector<uint32_t> set_regions;
+    set_begins.reserve(sets.size() + 1);
+    for (const auto& set : sets) {
+        set_begins.push_back(set_regions.size());
+        set_regions.insert(set_regions.end(), set.begin(), set.end());
+    }
+    set_begins.push_back(set_regions.size());
+    std::vector<sepia::write<event_stream_type>> writes;
+    writes.reserve(regions.size());
+    for (const auto& crop_region : regions) {
+        writes.emplace_back(
+            sepia::filename_to_ofstream(crop_region.filename),
+            preserve_offset ? header.width : crop_region.width,
+            preserve_offset ? header.height : crop_region.height);
+    }
     if (preserve_offset) {
-        sepia::write<event_stream_type> write(std::move(output_stream), header.width, header.height);
         sepia::join_observable<event_stream_type>(std::move(input_stream), [&](sepia::event<event_stream_type> event) {
-            if (event.x >= left && event.x < right && event.y >= bottom && event.y < top) {
-                write(event);
+            const auto set = pixel_to_set[event.x + event.y * header.width];
+            for (auto index = set_begins[set]; index < set_begins[set + 1]; ++index) {
+                writes[set_regions[index]](event);
             }
         });
     } else {
-        sepia::write<event_stream_type> write(std::move(output_stream), width, height);
         sepia::join_observable<event_stream_type>(std::move(input_stream), [&](sepia::event<event_stream_type> event) {
-            if (event.x >= left && event.x < right && event.y >= bottom && event.y < top) {
-                event.x -= left;
-                event.y -= bottom;
-                write(event);
+            const auto set = pixel_to_set[event.x + event.y * header.width];
+            for (auto index = set_begins[set]; index < set_begins[set + 1]; ++index) {
+                const auto& crop_region = regions[set_regions[index]];
+                auto region_event = event;
+                region_event.x -= crop_region.left;
+                region_event.y -= crop_region.bottom;
+                writes[set_regions[index]](region_event);
             }
         });
     }
@@ -37,70 +95,106 @@ int main(int argc, char* argv[]) {
     return pontella::main(
         {
             "crop generates a new Event Stream file with only events from the given region.",
-            "Syntax: ./crop [options] /path/to/input.es /path/to/output.es left bottom width height",
+            "    Several regions can be cropped in a single pass by repeating the output, left, bottom, width and",
+            "    height arguments. An event that belongs to several regions is written to each of them.",
+            "Syntax: ./crop [options] /path/to/input.es /path/to/output.es left bottom width height [...]",
+            "        ./crop [options] --grid [columns]x[rows] /path/to/input.es /path/to/output.es",
             "Available options:",
-            "    -p, --preserve-offset    prevents the coordinates of the cropped area from being normalized",
-            "    -h, --help               shows this help message",
+            "    -g [grid], --grid [grid]    splits the sensor into columns x rows tiles (for example, 4x4)",
+            "                                    the tile index (row-major, starting at the bottom left)",
+            "                                    is appended to the output name (output_0.es, output_1.es...)",
+            "    -p, --preserve-offset       prevents the coordinates of the cropped area from being normalized",
+            "    -h, --help                  shows this help message",
         },
         argc,
         argv,
-        6,
-        {},
+        -1,
+        {{"grid", {"g"}}},
         {{"preserve-offset", {"p"}}},
         [](pontella::command command) {
-            if (command.arguments[0] == command.arguments[1]) {
-                throw std::runtime_error("The Event Stream input and output must be different files");
+            const auto grid_and_argument = command.options.find("grid");
+            if (grid_and_argument == command.options.end()) {
+                if (command.arguments.size() < 6 || (command.arguments.size() - 1) % 5 != 0) {
+                    throw std::runtime_error(
+                        "crop expects an input followed by output, left, bottom, width, height quintuplets");
+                }
+            } else if (command.arguments.size() != 2) {
+                throw std::runtime_error("crop expects an input and an output with the grid option");
             }
             const auto header = sepia::read_header(sepia::filename_to_ifstream(command.arguments[0]));
-            const auto left = std::stoull(command.arguments[2]);
-            const auto bottom = std::stoull(command.arguments[3]);
-            const auto width = std::stoull(command.arguments[4]);
-            const auto height = std::stoull(command.arguments[5]);
-            if (left + width > header.width || bottom + height > header.height) {
-                throw std::runtime_error("The selected region is out of scope");
+            std::vector<region> regions;
+            if (grid_and_argument == command.options.end()) {
+                for (std::size_t index = 1; index < command.arguments.size(); index += 5) {
+                    const auto left = std::stoull(command.arguments[index + 1]);
+                    const auto bottom = std::stoull(command.arguments[index + 2]);
+                    const auto width = std::stoull(command.arguments[index + 3]);
+                    const auto height = std::stoull(command.arguments[index + 4]);
+                    if (left + width > header.width || bottom + height > header.height) {
+                        throw std::runtime_error("The selected region is out of scope");
+                    }
+                    regions.push_back({
+                        command.arguments[index],
+                        static_cast<uint16_t>(left),
+                        static_cast<uint16_t>(bottom),
+                        static_cast<uint16_t>(width),
+                        static_cast<uint16_t>(height),
+                    });
+                }
+            } else {
+                const auto separator = grid_and_argument->second.find('x');
+                if (separator == std::string::npos) {
+                    throw std::runtime_error("grid must have the format [columns]x[rows]");
+                }
+                const auto columns = std::stoull(grid_and_argument->second.substr(0, separator));
+                const auto rows = std::stoull(grid_and_argument->second.substr(separator + 1));
+                if (columns == 0 || rows == 0 || columns > header.width || rows > header.height) {
+                    throw std::runtime_error("grid dimensions must be between 1 and the sensor size");
+                }
+                for (uint64_t row = 0; row < rows; ++row) {
+                    for (uint64_t column = 0; column < columns; ++column) {
+                        const auto left = column * header.width / columns;
+                        const auto bottom = row * header.height / rows;
+                        regions.push_back({
+                            indexed_filename(
+                                command.arguments[1],
+                                static_cast<std::size_t>(column + row * columns),
+                                static_cast<std::size_t>(columns * rows)),
+                            static_cast<uint16_t>(left),
+                            static_cast<uint16_t>(bottom),
+                            static_cast<uint16_t>((column + 1) * header.width / columns - left),
+                            static_cast<uint16_t>((row + 1) * header.height / rows - bottom),
+                        });
+                    }
+                }
+            }
+            {
+                std::set<std::string> filenames;
+                for (const auto& crop_region : regions) {
+                    if (crop_region.filename == command.arguments[0]) {
+                        throw std::runtime_error("The Event Stream input and output must be different files");
+                    }
+                    if (!filenames.insert(crop_region.filename).second) {
+                        throw std::runtime_error("The Event Stream outputs must be different files");
+                    }
+                }
             }
             const auto preserve_offset = command.flags.find("preserve-offset") != command.flags.end();
             auto input_stream = sepia::filename_to_ifstream(command.arguments[0]);
-            auto output_stream = sepia::filename_to_ofstream(command.arguments[1]);
             switch (header.event_stream_type) {
                 case sepia::type::generic: {
                     throw std::runtime_error("Unsupported event type: generic");
                     break;
                 }
                 case sepia::type::dvs: {
-                    crop<sepia::type::dvs>(
-                        header,
-                        std::move(input_stream),
-                        std::move(output_stream),
-                        left,
-                        bottom,
-                        width,
-                        height,
-                        preserve_offset);
+                    crop<sepia::type::dvs>(header, std::move(input_stream), regions, preserve_offset);
                     break;
                 }
                 case sepia::type::atis: {
-                    crop<sepia::type::atis>(
-                        header,
-                        std::move(input_stream),
-                        std::move(output_stream),
-                        left,
-                        bottom,
-                        width,
-                        height,
-                        preserve_offset);
+                    crop<sepia::type::atis>(header, std::move(input_stream), regions, preserve_offset);
                     break;
                 }
                 case sepia::type::color: {
-                    crop<sepia::type::color>(
-                        header,
-                        std::move(input_stream),
-                        std::move(output_stream),
-                        left,
-                        bottom,
-                        width,
-                        height,
-                        preserve_offset);
+                    crop<sepia::type::color>(header, std::move(input_stream), regions, preserve_offset);
                     break;
                 }
             }
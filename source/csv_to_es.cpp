@@ -0,0 +1,244 @@
+#include "../third_party/pontella/source/pontella.hpp"
+#include "../third_party/sepia/source/sepia.hpp"
+#include "mapped_file.hpp"
+#include <array>
+#include <cstring>
+
+/// maximum_columns is the largest number of columns in a supported CSV file.
+constexpr std::size_t maximum_columns = 6;
+
+/// line_error creates an exception that points to a line of the input.
+inline std::runtime_error line_error(uint64_t line, const std::string& message) {
+    return std::runtime_error("line " + std::to_string(line) + ": " + message);
+}
+
+/// parse_row parses the comma-separated unsigned integers of a line, and returns the number of columns.
+/// Digits are accumulated directly, without copying the line or calling locale-aware functions.
+inline std::size_t parse_row(
+    const char* begin,
+    const char* end,
+    uint64_t line,
+    std::array<uint64_t, maximum_columns>& values) {
+    if (end > begin && *(end - 1) == '\r') {
+        --end;
+    }
+    std::size_t columns = 0;
+    for (auto position = begin;;) {
+        if (columns == maximum_columns) {
+            throw line_error(line, "too many columns");
+        }
+        uint64_t value = 0;
+        const auto digits_begin = position;
+        for (; position != end; ++position) {
+            const auto digit = static_cast<uint8_t>(*position - '0');
+            if (digit > 9) {
+                break;
+            }
+            if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+                throw line_error(line, "integer overflow");
+            }
+            value = value * 10 + digit;
+        }
+        if (position == digits_begin) {
+            throw line_error(line, "expected an unsigned integer");
+        }
+        values[columns] = value;
+        ++columns;
+        if (position == end) {
+            break;
+        }
+        if (*position != ',') {
+            throw line_error(line, "expected a comma");
+        }
+        ++position;
+    }
+    return columns;
+}
+
+/// for_each_line calls handle_line with the boundaries and number of every non-empty line after the first.
+/// Newlines are located with memchr, which the standard library vectorizes.
+template <typename HandleLine>
+void for_each_line(const char* begin, const char* end, HandleLine&& handle_line) {
+    uint64_t line = 1;
+    for (auto position = begin; position < end; ++line) {
+        auto line_end = static_cast<const char*>(std::memchr(position, '\n', static_cast<std::size_t>(end - position)));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        if (line > 1 && line_end > position && !(line_end - position == 1 && *position == '\r')) {
+            handle_line(position, line_end, line);
+        }
+        position = line_end + 1;
+    }
+}
+
+/// row_to_event converts the integers of a CSV row to an event, and checks their range.
+template <sepia::type event_stream_type>
+sepia::event<event_stream_type> row_to_event(const std::array<uint64_t, maximum_columns>& values, uint64_t line);
+template <>
+sepia::dvs_event row_to_event<sepia::type::dvs>(const std::array<uint64_t, maximum_columns>& values, uint64_t line) {
+    if (values[3] > 1) {
+        throw line_error(line, "is_increase must be 0 or 1");
+    }
+    return {values[0], static_cast<uint16_t>(values[1]), static_cast<uint16_t>(values[2]), values[3] == 1};
+}
+template <>
+sepia::atis_event row_to_event<sepia::type::atis>(const std::array<uint64_t, maximum_columns>& values, uint64_t line) {
+    if (values[3] > 1 || values[4] > 1) {
+        throw line_error(line, "is_threshold_crossing and polarity must be 0 or 1");
+    }
+    return {
+        values[0],
+        static_cast<uint16_t>(values[1]),
+        static_cast<uint16_t>(values[2]),
+        values[3] == 1,
+        values[4] == 1,
+    };
+}
+template <>
+sepia::color_event
+row_to_event<sepia::type::color>(const std::array<uint64_t, maximum_columns>& values, uint64_t line) {
+    if (values[3] > 255 || values[4] > 255 || values[5] > 255) {
+        throw line_error(line, "r, g and b must be in the range [0, 255]");
+    }
+    return {
+        values[0],
+        static_cast<uint16_t>(values[1]),
+        static_cast<uint16_t>(values[2]),
+        static_cast<uint8_t>(values[3]),
+        static_cast<uint8_t>(values[4]),
+        static_cast<uint8_t>(values[5]),
+    };
+}
+
+/// csv_to_es parses the rows of a CSV file, checks them, and writes the events.
+/// If width or height is zero, a first pass over the rows calculates the sensor size.
+template <sepia::type event_stream_type>
+void csv_to_es(
+    const char* begin,
+    const char* end,
+    std::size_t columns,
+    uint16_t width,
+    uint16_t height,
+    const std::string& output) {
+    std::array<uint64_t, maximum_columns> values;
+    const auto parse = [&](const char* line_begin, const char* line_end, uint64_t line) {
+        if (parse_row(line_begin, line_end, line, values) != columns) {
+            throw line_error(line, "expected " + std::to_string(columns) + " columns");
+        }
+        if (values[1] >= std::numeric_limits<uint16_t>::max() || values[2] >= std::numeric_limits<uint16_t>::max()) {
+            throw line_error(line, "x and y must be smaller than 65535");
+        }
+    };
+    if (width == 0 || height == 0) {
+        uint64_t maximum_x = 0;
+        uint64_t maximum_y = 0;
+        for_each_line(begin, end, [&](const char* line_begin, const char* line_end, uint64_t line) {
+            parse(line_begin, line_end, line);
+            maximum_x = std::max(maximum_x, values[1]);
+            maximum_y = std::max(maximum_y, values[2]);
+        });
+        if (width == 0) {
+            width = static_cast<uint16_t>(maximum_x + 1);
+        }
+        if (height == 0) {
+            height = static_cast<uint16_t>(maximum_y + 1);
+        }
+    }
+    sepia::write<event_stream_type> write(sepia::filename_to_ofstream(output), width, height);
+    uint64_t previous_t = 0;
+    for_each_line(begin, end, [&](const char* line_begin, const char* line_end, uint64_t line) {
+        parse(line_begin, line_end, line);
+        const auto event = row_to_event<event_stream_type>(values, line);
+        if (event.t < previous_t) {
+            throw line_error(line, "the timestamp is smaller than the previous one");
+        }
+        if (event.x >= width || event.y >= height) {
+            throw line_error(line, "the coordinates are out of the sensor's scope");
+        }
+        previous_t = event.t;
+        write(event);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {"csv_to_es converts a csv file (in the format generated by es_to_csv) into an Event Stream file",
+         "    The event type is determined by the csv header (t,x,y,is_increase for DVS events,",
+         "    t,x,y,is_threshold_crossing,polarity for ATIS events and t,x,y,r,g,b for color events).",
+         "Syntax: ./csv_to_es [options] /path/to/input.csv /path/to/output.es",
+         "Available options:",
+         "    -x size, --width size     sets the sensor width in pixels",
+         "                                  defaults to the largest x plus one",
+         "    -y size, --height size    sets the sensor height in pixels",
+         "                                  defaults to the largest y plus one",
+         "    -h, --help                shows this help message"},
+        argc,
+        argv,
+        2,
+        {
+            {"width", {"x"}},
+            {"height", {"y"}},
+        },
+        {},
+        [](pontella::command command) {
+            if (command.arguments[0] == command.arguments[1]) {
+                throw std::runtime_error("The csv input and the Event Stream output must be different files");
+            }
+            uint16_t width = 0;
+            {
+                const auto name_and_argument = command.options.find("width");
+                if (name_and_argument != command.options.end()) {
+                    width = static_cast<uint16_t>(std::stoull(name_and_argument->second));
+                    if (width == 0) {
+                        throw std::runtime_error("width must be larger than 0");
+                    }
+                }
+            }
+            uint16_t height = 0;
+            {
+                const auto name_and_argument = command.options.find("height");
+                if (name_and_argument != command.options.end()) {
+                    height = static_cast<uint16_t>(std::stoull(name_and_argument->second));
+                    if (height == 0) {
+                        throw std::runtime_error("height must be larger than 0");
+                    }
+                }
+            }
+            auto file = filename_to_mapped_file(command.arguments[0]);
+            std::vector<char> bytes;
+            const char* begin = nullptr;
+            const char* end = nullptr;
+            if (file) {
+                begin = reinterpret_cast<const char*>(file->data());
+                end = begin + file->size();
+            } else {
+                auto stream = sepia::filename_to_ifstream(command.arguments[0]);
+                bytes.assign(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+                begin = bytes.data();
+                end = begin + bytes.size();
+            }
+            auto header_end = end;
+            if (begin != end) {
+                const auto newline = std::memchr(begin, '\n', static_cast<std::size_t>(end - begin));
+                if (newline != nullptr) {
+                    header_end = static_cast<const char*>(newline);
+                }
+            }
+            std::string csv_header(begin, header_end);
+            if (!csv_header.empty() && csv_header.back() == '\r') {
+                csv_header.pop_back();
+            }
+            if (csv_header == "t,x,y,is_increase") {
+                csv_to_es<sepia::type::dvs>(begin, end, 4, width, height, command.arguments[1]);
+            } else if (csv_header == "t,x,y,is_threshold_crossing,polarity") {
+                csv_to_es<sepia::type::atis>(begin, end, 5, width, height, command.arguments[1]);
+            } else if (csv_header == "t,x,y,r,g,b") {
+                csv_to_es<sepia::type::color>(begin, end, 6, width, height, command.arguments[1]);
+            } else {
+                throw std::runtime_error(
+                    "unsupported csv header '" + csv_header
+                    + "' (expected t,x,y,is_increase or t,x,y,is_threshold_crossing,polarity or t,x,y,r,g,b)");
+            }
+        });
+}
@@ -1,96 +1,368 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
+#include "indexed_filename.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
+#include <set>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 enum class timestamp { preserve, relative, zero };
 
-/// cut creates a new Event Stream file with only events from the given time range.
+/// copy_bytes appends the bytes [begin, end[ of the input file to the output file.
+/// copy_file_range lets the kernel copy the bytes without moving them through user space (when supported).
+inline void copy_bytes(
+    const std::string& input_filename,
+    const std::string& output_filename,
+    uint64_t begin,
+    uint64_t end) {
+    if (begin >= end) {
+        return;
+    }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    {
+        const auto input_descriptor = open(input_filename.c_str(), O_RDONLY);
+        const auto output_descriptor = open(output_filename.c_str(), O_WRONLY);
+        if (input_descriptor >= 0 && output_descriptor >= 0 && lseek(output_descriptor, 0, SEEK_END) >= 0) {
+            auto offset = static_cast<loff_t>(begin);
+            while (static_cast<uint64_t>(offset) < end) {
+                const auto copied = copy_file_range(
+                    input_descriptor,
+                    &offset,
+                    output_descriptor,
+                    nullptr,
+                    static_cast<std::size_t>(end - static_cast<uint64_t>(offset)),
+                    0);
+                if (copied <= 0) {
+                    break;
+                }
+            }
+            begin = static_cast<uint64_t>(offset);
+        }
+        if (input_descriptor >= 0) {
+            close(input_descriptor);
+        }
+        if (output_descriptor >= 0) {
+            close(output_descriptor);
+        }
+        if (begin >= end) {
+            return;
+        }
+    }
+#endif
+    auto input = sepia::filename_to_ifstream(input_filename);
+    input->seekg(static_cast<std::streamoff>(begin));
+    std::ofstream output(output_filename, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+    if (!output.good()) {
+        throw sepia::unwritable_file(output_filename);
+    }
+    std::vector<char> bytes(1 << 20);
+    while (begin < end && input->good()) {
+        input->read(bytes.data(), static_cast<std::streamsize>(std::min(end - begin, uint64_t(bytes.size()))));
+        const auto size = static_cast<uint64_t>(input->gcount());
+        if (size == 0) {
+            break;
+        }
+        output.write(bytes.data(), static_cast<std::streamsize>(size));
+        begin += size;
+    }
+}
+
+/// cut_preserve creates a new Event Stream file with only events from the given time range, without re-encoding them.
+/// Only the first event is encoded again (its timestamp is relative to the beginning of the file),
+/// the following bytes are copied verbatim since Event Stream timestamps are differences with the previous event.
+/// Decoding starts at the indexed event boundary closest to begin_t, and the index (if any) also bounds
+/// the range that must be decoded to find the last event before end_t.
 template <sepia::type event_stream_type>
-void cut(sepia::header header, const pontella::command& command) {
-    const auto begin_t = timecode(command.arguments[2]).value();
-    const auto end_t = timecode(command.arguments[3]).value();
-    auto first_t = std::numeric_limits<uint64_t>::max();
-    auto timestamp_strategy = timestamp::preserve;
+void cut_preserve(
+    const sepia::header& header,
+    const std::string& input_filename,
+    const std::string& output_filename,
+    uint64_t begin_t,
+    uint64_t end_t) {
+    auto stream = sepia::filename_to_ifstream(input_filename);
+    sepia::read_header(*stream);
+    sepia::event<event_stream_type> event = {};
+    event.t = time_index::seek(*stream, input_filename, begin_t);
+    auto offset = static_cast<uint64_t>(stream->tellg());
+    std::vector<uint8_t> bytes(1 << 16);
+    auto found = false;
+    {
+        sepia::handle_byte<event_stream_type> handle_byte(header.width, header.height);
+        while (!found) {
+            stream->read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+            const auto size = static_cast<std::size_t>(stream->gcount());
+            for (std::size_t index = 0; index < size; ++index) {
+                if (handle_byte(bytes[index], event) && event.t >= begin_t) {
+                    offset += index + 1;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                offset += size;
+                if (stream->eof()) {
+                    break;
+                }
+            }
+        }
+    }
     {
-        const auto name_and_argument = command.options.find("timestamp");
-        if (name_and_argument != command.options.end()) {
-            if (name_and_argument->second == "relative") {
-                timestamp_strategy = timestamp::relative;
-            } else if (name_and_argument->second == "zero") {
-                timestamp_strategy = timestamp::zero;
-            } else if (name_and_argument->second != "preserve") {
-                throw std::runtime_error("timestamp must be one of {preserve, relative, zero}");
+        sepia::write<event_stream_type> write(
+            sepia::filename_to_ofstream(output_filename), header.width, header.height);
+        if (!found || event.t >= end_t) {
+            return;
+        }
+        write(event);
+    }
+    auto end = offset;
+    {
+        const auto entries = time_index::read(input_filename);
+        const auto entry_after = std::lower_bound(
+            entries.begin(), entries.end(), end_t, [](const time_index::entry& index_entry, uint64_t t) {
+                return index_entry.t < t;
+            });
+        if (entry_after != entries.begin() && std::prev(entry_after)->offset > offset) {
+            end = std::prev(entry_after)->offset;
+            event.t = std::prev(entry_after)->t;
+            copy_bytes(input_filename, output_filename, offset, end);
+            offset = end;
+        }
+    }
+    std::ofstream output(output_filename, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+    if (!output.good()) {
+        throw sepia::unwritable_file(output_filename);
+    }
+    stream->clear();
+    stream->seekg(static_cast<std::streamoff>(offset));
+    sepia::handle_byte<event_stream_type> handle_byte(header.width, header.height);
+    std::vector<uint8_t> pending;
+    for (auto done = false; !done;) {
+        stream->read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        const auto size = static_cast<std::size_t>(stream->gcount());
+        std::size_t block_end = 0;
+        for (std::size_t index = 0; index < size; ++index) {
+            if (handle_byte(bytes[index], event)) {
+                if (event.t >= end_t) {
+                    done = true;
+                    break;
+                }
+                block_end = index + 1;
+            }
+        }
+        if (block_end > 0) {
+            output.write(reinterpret_cast<const char*>(pending.data()), pending.size());
+            output.write(reinterpret_cast<const char*>(bytes.data()), block_end);
+            pending.clear();
+        }
+        if (!done) {
+            pending.insert(pending.end(), bytes.begin() + block_end, bytes.begin() + size);
+            if (stream->eof()) {
+                break;
             }
         }
     }
-    sepia::write<event_stream_type> write(
-        sepia::filename_to_ofstream(command.arguments[1]), header.width, header.height);
-    sepia::join_observable<event_stream_type>(
-        sepia::filename_to_ifstream(command.arguments[0]), [&](sepia::event<event_stream_type> event) {
+}
+
+/// range is a time interval written to a dedicated output.
+struct range {
+    std::string filename;
+    uint64_t begin_t;
+    uint64_t end_t;
+};
+
+/// cut creates new Event Stream files with only events from the given time ranges.
+/// All the ranges are written during a single decoding pass. Outputs are opened when their range begins
+/// and closed when it ends, so that only overlapping ranges are open at the same time.
+template <sepia::type event_stream_type>
+void cut(
+    sepia::header header,
+    const std::string& input_filename,
+    const std::vector<range>& ranges,
+    timestamp timestamp_strategy) {
+    if (ranges.empty()) {
+        return;
+    }
+    if (ranges.size() == 1 && timestamp_strategy == timestamp::preserve) {
+        cut_preserve<event_stream_type>(
+            header, input_filename, ranges.front().filename, ranges.front().begin_t, ranges.front().end_t);
+        return;
+    }
+    std::vector<std::size_t> order(ranges.size());
+    for (std::size_t index = 0; index < order.size(); ++index) {
+        order[index] = index;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t first, std::size_t second) {
+        return ranges[first].begin_t < ranges[second].begin_t;
+    });
+    auto begin_t = std::numeric_limits<uint64_t>::max();
+    uint64_t end_t = 0;
+    for (const auto& time_range : ranges) {
+        begin_t = std::min(begin_t, time_range.begin_t);
+        end_t = std::max(end_t, time_range.end_t);
+    }
+    std::vector<std::unique_ptr<sepia::write<event_stream_type>>> writes(ranges.size());
+    std::vector<uint64_t> first_ts(ranges.size(), std::numeric_limits<uint64_t>::max());
+    std::vector<bool> opened(ranges.size(), false);
+    std::vector<std::size_t> active;
+    std::size_t next = 0;
+    time_index::join_observable<event_stream_type>(
+        input_filename, begin_t, [&](sepia::event<event_stream_type> event) {
             if (event.t < begin_t) {
                 return;
             }
             if (event.t >= end_t) {
                 throw sepia::end_of_file();
             }
-            switch (timestamp_strategy) {
-                case timestamp::preserve: {
-                    break;
-                }
-                case timestamp::relative: {
-                    event.t -= begin_t;
-                    break;
+            for (; next < order.size() && ranges[order[next]].begin_t <= event.t; ++next) {
+                writes[order[next]] = sepia::make_unique<sepia::write<event_stream_type>>(
+                    sepia::filename_to_ofstream(ranges[order[next]].filename), header.width, header.height);
+                opened[order[next]] = true;
+                active.push_back(order[next]);
+            }
+            for (auto index_iterator = active.begin(); index_iterator != active.end();) {
+                const auto index = *index_iterator;
+                if (event.t >= ranges[index].end_t) {
+                    writes[index].reset();
+                    index_iterator = active.erase(index_iterator);
+                    continue;
                 }
-                case timestamp::zero: {
-                    if (first_t == std::numeric_limits<uint64_t>::max()) {
-                        first_t = event.t;
+                auto range_event = event;
+                switch (timestamp_strategy) {
+                    case timestamp::preserve: {
+                        break;
+                    }
+                    case timestamp::relative: {
+                        range_event.t -= ranges[index].begin_t;
+                        break;
+                    }
+                    case timestamp::zero: {
+                        if (first_ts[index] == std::numeric_limits<uint64_t>::max()) {
+                            first_ts[index] = range_event.t;
+                        }
+                        range_event.t -= first_ts[index];
+                        break;
                     }
-                    event.t -= first_t;
-                    break;
                 }
+                (*writes[index])(range_event);
+                ++index_iterator;
             }
-            write(event);
         });
+    writes.clear();
+    for (std::size_t index = 0; index < ranges.size(); ++index) {
+        if (!opened[index]) {
+            sepia::write<event_stream_type>(
+                sepia::filename_to_ofstream(ranges[index].filename), header.width, header.height);
+        }
+    }
 }
 
 int main(int argc, char* argv[]) {
     return pontella::main(
         {
             "cut generates a new Event Stream file with only events from the given time range.",
-            "Syntax: ./cut [options] /path/to/input.es /path/to/output.es begin end",
+            "    Several ranges can be cut in a single pass by repeating the output, begin and end arguments.",
+            "Syntax: ./cut [options] /path/to/input.es /path/to/output.es begin end [/path/to/output.es begin end...]",
             "Available options:",
             "    -t [strategy], --timestamp [strategy]    selects the timestamp conversion strategy",
             "                                                 one of preserve (default), relative, zero",
             "                                                 preserve uses the same timestamps as the original",
             "                                                 relative calculate timestamps relatively to begin",
             "                                                 zero sets the first generated timestamp to zero",
+            "    -s [duration], --segment [duration]      splits [begin, end[ into segments with the given duration",
+            "                                                 the segment index is appended to the output name",
+            "                                                 (for example, output_0.es, output_1.es...)",
             "    -h, --help                               shows this help message",
         },
         argc,
         argv,
-        4,
-        {{"timestamp", {"t"}}},
+        -1,
+        {
+            {"timestamp", {"t"}},
+            {"segment", {"s"}},
+        },
         {},
         [](pontella::command command) {
-            if (command.arguments[0] == command.arguments[1]) {
-                throw std::runtime_error("The Event Stream input and output must be different files");
+            if (command.arguments.size() < 4 || (command.arguments.size() - 1) % 3 != 0) {
+                throw std::runtime_error("cut expects an input followed by output, begin, end triplets");
+            }
+            auto timestamp_strategy = timestamp::preserve;
+            {
+                const auto name_and_argument = command.options.find("timestamp");
+                if (name_and_argument != command.options.end()) {
+                    if (name_and_argument->second == "relative") {
+                        timestamp_strategy = timestamp::relative;
+                    } else if (name_and_argument->second == "zero") {
+                        timestamp_strategy = timestamp::zero;
+                    } else if (name_and_argument->second != "preserve") {
+                        throw std::runtime_error("timestamp must be one of {preserve, relative, zero}");
+                    }
+                }
+            }
+            std::vector<range> ranges;
+            for (std::size_t index = 1; index < command.arguments.size(); index += 3) {
+                ranges.push_back({
+                    command.arguments[index],
+                    timecode(command.arguments[index + 1]).value(),
+                    timecode(command.arguments[index + 2]).value(),
+                });
+            }
+            {
+                const auto name_and_argument = command.options.find("segment");
+                if (name_and_argument != command.options.end()) {
+                    if (ranges.size() > 1) {
+                        throw std::runtime_error("segment cannot be used with several ranges");
+                    }
+                    const auto duration = timecode(name_and_argument->second).value();
+                    if (duration == 0) {
+                        throw std::runtime_error("segment must be larger than 0");
+                    }
+                    const auto segmented_range = ranges.front();
+                    ranges.clear();
+                    if (segmented_range.end_t > segmented_range.begin_t) {
+                        const auto count = static_cast<std::size_t>(
+                            (segmented_range.end_t - segmented_range.begin_t - 1) / duration + 1);
+                        for (std::size_t index = 0; index < count; ++index) {
+                            const auto begin_t = segmented_range.begin_t + index * duration;
+                            ranges.push_back({
+                                indexed_filename(segmented_range.filename, index, count),
+                                begin_t,
+                                std::min(segmented_range.end_t, begin_t + duration),
+                            });
+                        }
+                    }
+                }
+            }
+            {
+                std::set<std::string> filenames;
+                for (const auto& time_range : ranges) {
+                    if (time_range.filename == command.arguments[0]) {
+                        throw std::runtime_error("The Event Stream input and output must be different files");
+                    }
+                    if (!filenames.insert(time_range.filename).second) {
+                        throw std::runtime_error("The Event Stream outputs must be different files");
+                    }
+                }
             }
             const auto header = sepia::read_header(sepia::filename_to_ifstream(command.arguments[0]));
             switch (header.event_stream_type) {
                 case sepia::type::generic: {
-                    cut<sepia::type::generic>(header, command);
+                    cut<sepia::type::generic>(header, command.arguments[0], ranges, timestamp_strategy);
                     break;
                 }
                 case sepia::type::dvs: {
-                    cut<sepia::type::dvs>(header, command);
+                    cut<sepia::type::dvs>(header, command.arguments[0], ranges, timestamp_strategy);
                     break;
                 }
                 case sepia::type::atis: {
-                    cut<sepia::type::atis>(header, command);
+                    cut<sepia::type::atis>(header, command.arguments[0], ranges, timestamp_strategy);
                     break;
                 }
                 case sepia::type::color: {
-                    cut<sepia::type::color>(header, command);
+                    cut<sepia::type::color>(header, command.arguments[0], ranges, timestamp_strategy);
                     break;
                 }
             }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "../third_party/sepia/source/sepia.hpp"
+#include "pipeline.hpp"
 #include <algorithm>
+#include <array>
 
 namespace dat {
     /// header bundles a .dat file header's information.
@@ -78,42 +80,192 @@ namespace dat {
 
     /// bytes_to_dvs_event converts raw bytes to a polarized event.
     /// The DVS event type is used for both td and aps .dat files.
-    inline sepia::dvs_event bytes_to_dvs_event(std::array<uint8_t, 8> bytes, header stream_header) {
-        if (stream_header.version < 2) {
-            return {
-                static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8)
-                    | (static_cast<uint64_t>(bytes[2]) << 16) | (static_cast<uint64_t>(bytes[3]) << 24),
-                static_cast<uint16_t>(static_cast<uint16_t>(bytes[4]) | (static_cast<uint16_t>(bytes[5] & 1) << 8)),
-                static_cast<uint16_t>(
-                    stream_header.height - 1
-                    - (static_cast<uint16_t>(bytes[5] >> 1) | (static_cast<uint16_t>(bytes[6] & 1) << 7))),
-                (bytes[6] & 0b10) == 0b10,
-            };
-        }
+    /// legacy selects the layout of files with a version smaller than 2.
+    template <bool legacy>
+    inline sepia::dvs_event bytes_to_dvs_event(const uint8_t* bytes, uint16_t height);
+
+    template <>
+    inline sepia::dvs_event bytes_to_dvs_event<true>(const uint8_t* bytes, uint16_t height) {
+        return {
+            static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8)
+                | (static_cast<uint64_t>(bytes[2]) << 16) | (static_cast<uint64_t>(bytes[3]) << 24),
+            static_cast<uint16_t>(static_cast<uint16_t>(bytes[4]) | (static_cast<uint16_t>(bytes[5] & 1) << 8)),
+            static_cast<uint16_t>(
+                height - 1 - (static_cast<uint16_t>(bytes[5] >> 1) | (static_cast<uint16_t>(bytes[6] & 1) << 7))),
+            (bytes[6] & 0b10) == 0b10,
+        };
+    }
+
+    template <>
+    inline sepia::dvs_event bytes_to_dvs_event<false>(const uint8_t* bytes, uint16_t height) {
         return {
             static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8)
                 | (static_cast<uint64_t>(bytes[2]) << 16) | (static_cast<uint64_t>(bytes[3]) << 24),
             static_cast<uint16_t>(static_cast<uint16_t>(bytes[4]) | (static_cast<uint16_t>(bytes[5] & 0b111111) << 8)),
             static_cast<uint16_t>(
-                stream_header.height - 1
+                height - 1
                 - (static_cast<uint16_t>(bytes[5] >> 6) | (static_cast<uint16_t>(bytes[6]) << 2)
                    | (static_cast<uint16_t>(bytes[7] & 0b1111) << 10))),
             (bytes[7] & 0b10000) == 0b10000,
         };
     }
 
+    /// bytes_to_dvs_event converts raw bytes to a polarized event.
+    inline sepia::dvs_event bytes_to_dvs_event(std::array<uint8_t, 8> bytes, header stream_header) {
+        if (stream_header.version < 2) {
+            return bytes_to_dvs_event<true>(bytes.data(), stream_header.height);
+        }
+        return bytes_to_dvs_event<false>(bytes.data(), stream_header.height);
+    }
+
+    /// bytes_to_dvs_events converts a block of raw bytes to polarized events.
+    template <bool legacy>
+    inline void bytes_to_dvs_events(const uint8_t* bytes, std::size_t size, uint16_t height, sepia::dvs_event* events) {
+        for (std::size_t index = 0; index < size; ++index) {
+            events[index] = bytes_to_dvs_event<legacy>(bytes + index * 8, height);
+        }
+    }
+
+    /// event_reader decodes the events of a td or aps stream block by block.
+    /// The layout is resolved once, when the reader is constructed.
+    class event_reader {
+        public:
+        /// block_size is the number of events read from the stream at once.
+        static constexpr std::size_t block_size = 1 << 16;
+
+        event_reader(std::istream& stream, header stream_header) :
+            _stream(stream),
+            _height(stream_header.height),
+            _bytes_to_dvs_events(
+                stream_header.version < 2 ? bytes_to_dvs_events<true> : bytes_to_dvs_events<false>),
+            _bytes(block_size * 8),
+            _index(0),
+            _size(0),
+            _stream_eof(false),
+            _eof(false) {}
+        event_reader(const event_reader&) = delete;
+        event_reader(event_reader&& other) = default;
+        event_reader& operator=(const event_reader&) = delete;
+        event_reader& operator=(event_reader&& other) = delete;
+        virtual ~event_reader() {}
+
+        /// next decodes the next event, and returns false if the stream is exhausted.
+        /// Trailing bytes that do not form a complete event are ignored.
+        bool next(sepia::dvs_event& event) {
+            if (_index == _size) {
+                _index = 0;
+                if (!next_block(_events)) {
+                    _size = 0;
+                    _eof = true;
+                    return false;
+                }
+                _size = _events.size();
+            }
+            event = _events[_index];
+            ++_index;
+            return true;
+        }
+
+        /// next_block reads and decodes the next block, and returns false if the stream is exhausted.
+        /// It must not be mixed with calls to next.
+        bool next_block(std::vector<sepia::dvs_event>& events) {
+            if (_stream_eof) {
+                events.clear();
+                return false;
+            }
+            _stream.read(reinterpret_cast<char*>(_bytes.data()), _bytes.size());
+            _stream_eof = _stream.eof();
+            events.resize(static_cast<std::size_t>(_stream.gcount()) / 8);
+            _bytes_to_dvs_events(_bytes.data(), events.size(), _height, events.data());
+            return !events.empty();
+        }
+
+        /// eof returns true once next has returned false.
+        bool eof() const {
+            return _eof;
+        }
+
+        protected:
+        std::istream& _stream;
+        const uint16_t _height;
+        void (*_bytes_to_dvs_events)(const uint8_t*, std::size_t, uint16_t, sepia::dvs_event*);
+        std::vector<uint8_t> _bytes;
+        std::vector<sepia::dvs_event> _events;
+        std::size_t _index;
+        std::size_t _size;
+        bool _stream_eof;
+        bool _eof;
+    };
+
+    /// prefetched_event_reader decodes the events of a td or aps stream on a dedicated thread.
+    /// It has the same interface as event_reader, and buffers at most depth blocks ahead of the consumer.
+    class prefetched_event_reader {
+        public:
+        prefetched_event_reader(std::istream& stream, header stream_header, std::size_t depth) :
+            _ring(depth),
+            _index(0),
+            _eof(false),
+            _reader([this, &stream, stream_header]() {
+                try {
+                    event_reader reader(stream, stream_header);
+                    for (;;) {
+                        std::vector<sepia::dvs_event> events;
+                        if (!reader.next_block(events) || !_ring.push(std::move(events))) {
+                            break;
+                        }
+                    }
+                } catch (...) {
+                    _ring.close();
+                    throw;
+                }
+                _ring.close();
+            }) {}
+        prefetched_event_reader(const prefetched_event_reader&) = delete;
+        prefetched_event_reader(prefetched_event_reader&& other) = delete;
+        prefetched_event_reader& operator=(const prefetched_event_reader&) = delete;
+        prefetched_event_reader& operator=(prefetched_event_reader&& other) = delete;
+        virtual ~prefetched_event_reader() {
+            _ring.cancel();
+        }
+
+        /// next returns the next event, and returns false if the stream is exhausted.
+        bool next(sepia::dvs_event& event) {
+            if (_index == _events.size()) {
+                _index = 0;
+                if (_eof || !_ring.pop(_events)) {
+                    if (!_eof) {
+                        _eof = true;
+                        _reader.join();
+                    }
+                    return false;
+                }
+            }
+            event = _events[_index];
+            ++_index;
+            return true;
+        }
+
+        /// eof returns true once next has returned false.
+        bool eof() const {
+            return _eof;
+        }
+
+        protected:
+        pipeline::ring<sepia::dvs_event> _ring;
+        std::vector<sepia::dvs_event> _events;
+        std::size_t _index;
+        bool _eof;
+        pipeline::stage _reader;
+    };
+
     /// td_observable dispatches DVS events from a td stream.
     /// The header must be read from the stream before calling this function.
     template <typename HandleEvent>
     inline void td_observable(std::istream& stream, header stream_header, HandleEvent handle_event) {
+        event_reader reader(stream, stream_header);
         uint64_t previous_t = 0;
-        for (;;) {
-            std::array<uint8_t, 8> bytes;
-            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-            if (stream.eof()) {
-                break;
-            }
-            const auto dvs_event = bytes_to_dvs_event(bytes, stream_header);
+        sepia::dvs_event dvs_event;
+        while (reader.next(dvs_event)) {
             if (dvs_event.t >= previous_t && dvs_event.x < stream_header.width && dvs_event.y < stream_header.height) {
                 handle_event(dvs_event);
                 previous_t = dvs_event.t;
@@ -125,14 +277,10 @@ namespace dat {
     /// The header must be read from the stream before calling this function.
     template <typename HandleEvent>
     inline void aps_observable(std::istream& stream, header stream_header, HandleEvent handle_event) {
+        event_reader reader(stream, stream_header);
         uint64_t previous_t = 0;
-        for (;;) {
-            std::array<uint8_t, 8> bytes;
-            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-            if (stream.eof()) {
-                break;
-            }
-            const auto dvs_event = bytes_to_dvs_event(bytes, stream_header);
+        sepia::dvs_event dvs_event;
+        while (reader.next(dvs_event)) {
             if (dvs_event.t >= previous_t && dvs_event.x < stream_header.width && dvs_event.y < stream_header.height) {
                 handle_event(sepia::atis_event{dvs_event.t, dvs_event.x, dvs_event.y, true, dvs_event.is_increase});
                 previous_t = dvs_event.t;
@@ -140,52 +288,27 @@ namespace dat {
         }
     }
 
-    /// td_aps_observable dispatches ATIS events from a td stream and an aps stream.
-    /// The headers must be read from both streams before calling this function.
-    template <typename HandleEvent>
-    inline void td_aps_observable(
-        std::istream& td_stream,
-        std::istream& aps_stream,
-        header stream_header,
-        HandleEvent handle_event) {
+    /// merge_td_aps interleaves the events of a td reader and an aps reader by timestamp.
+    template <typename Reader, typename HandleEvent>
+    inline void merge_td_aps(Reader& td_reader, Reader& aps_reader, header stream_header, HandleEvent& handle_event) {
         sepia::dvs_event td_event = {};
         sepia::dvs_event aps_event = {};
         uint64_t previous_t = 0;
-        for (;;) {
-            std::array<uint8_t, 8> bytes;
-            td_stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-            if (td_stream.eof()) {
+        while (td_reader.next(td_event)) {
+            if (td_event.x < stream_header.width && td_event.y < stream_header.height) {
                 break;
-            } else {
-                td_event = bytes_to_dvs_event(bytes, stream_header);
-                if (td_event.x < stream_header.width && td_event.y < stream_header.height) {
-                    break;
-                }
             }
         }
-        for (;;) {
-            std::array<uint8_t, 8> bytes;
-            aps_stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-            if (aps_stream.eof()) {
+        while (aps_reader.next(aps_event)) {
+            if (aps_event.x < stream_header.width && aps_event.y < stream_header.height) {
                 break;
-            } else {
-                aps_event = bytes_to_dvs_event(bytes, stream_header);
-                if (aps_event.x < stream_header.width && aps_event.y < stream_header.height) {
-                    break;
-                }
             }
         }
-        while (!td_stream.eof() && !aps_stream.eof()) {
+        while (!td_reader.eof() && !aps_reader.eof()) {
             if (td_event.t <= aps_event.t) {
                 handle_event(sepia::atis_event{td_event.t, td_event.x, td_event.y, false, td_event.is_increase});
                 previous_t = td_event.t;
-                for (;;) {
-                    std::array<uint8_t, 8> bytes;
-                    td_stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-                    if (td_stream.eof()) {
-                        break;
-                    }
-                    td_event = bytes_to_dvs_event(bytes, stream_header);
+                while (td_reader.next(td_event)) {
                     if (td_event.t >= previous_t && td_event.x < stream_header.width
                         && td_event.y < stream_header.height) {
                         break;
@@ -194,13 +317,7 @@ namespace dat {
             } else {
                 handle_event(sepia::atis_event{aps_event.t, aps_event.x, aps_event.y, true, aps_event.is_increase});
                 previous_t = aps_event.t;
-                for (;;) {
-                    std::array<uint8_t, 8> bytes;
-                    aps_stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-                    if (aps_stream.eof()) {
-                        break;
-                    }
-                    aps_event = bytes_to_dvs_event(bytes, stream_header);
+                while (aps_reader.next(aps_event)) {
                     if (aps_event.t >= previous_t && aps_event.x < stream_header.width
                         && aps_event.y < stream_header.height) {
                         break;
@@ -208,15 +325,9 @@ namespace dat {
                 }
             }
         }
-        if (td_stream) {
+        if (!td_reader.eof()) {
             handle_event(sepia::atis_event{td_event.t, td_event.x, td_event.y, false, td_event.is_increase});
-            for (;;) {
-                std::array<uint8_t, 8> bytes;
-                td_stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-                if (td_stream.eof()) {
-                    break;
-                }
-                td_event = bytes_to_dvs_event(bytes, stream_header);
+            while (td_reader.next(td_event)) {
                 if (td_event.t >= previous_t && td_event.x < stream_header.width && td_event.y < stream_header.height) {
                     handle_event(sepia::atis_event{td_event.t, td_event.x, td_event.y, false, td_event.is_increase});
                     previous_t = td_event.t;
@@ -224,13 +335,7 @@ namespace dat {
             }
         } else {
             handle_event(sepia::atis_event{aps_event.t, aps_event.x, aps_event.y, false, aps_event.is_increase});
-            for (;;) {
-                std::array<uint8_t, 8> bytes;
-                aps_stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-                if (aps_stream.eof()) {
-                    break;
-                }
-                aps_event = bytes_to_dvs_event(bytes, stream_header);
+            while (aps_reader.next(aps_event)) {
                 if (aps_event.t >= previous_t && aps_event.x < stream_header.width
                     && aps_event.y < stream_header.height) {
                     handle_event(
@@ -240,4 +345,33 @@ namespace dat {
             }
         }
     }
+
+    /// td_aps_observable dispatches ATIS events from a td stream and an aps stream.
+    /// The headers must be read from both streams before calling this function.
+    template <typename HandleEvent>
+    inline void td_aps_observable(
+        std::istream& td_stream,
+        std::istream& aps_stream,
+        header stream_header,
+        HandleEvent handle_event) {
+        event_reader td_reader(td_stream, stream_header);
+        event_reader aps_reader(aps_stream, stream_header);
+        merge_td_aps(td_reader, aps_reader, stream_header, handle_event);
+    }
+
+    /// parallel_td_aps_observable dispatches ATIS events from a td stream and an aps stream, using several threads.
+    /// Each stream is read and decoded on its own thread, and the calling thread interleaves the events.
+    /// depth is the number of blocks buffered by each reader thread.
+    /// The headers must be read from both streams before calling this function.
+    template <typename HandleEvent>
+    inline void parallel_td_aps_observable(
+        std::istream& td_stream,
+        std::istream& aps_stream,
+        header stream_header,
+        std::size_t depth,
+        HandleEvent handle_event) {
+        prefetched_event_reader td_reader(td_stream, stream_header, depth);
+        prefetched_event_reader aps_reader(aps_stream, stream_header, depth);
+        merge_td_aps(td_reader, aps_reader, stream_header, handle_event);
+    }
 }
@@ -1,5 +1,6 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "dat.hpp"
+#include "pipeline.hpp"
 
 int main(int argc, char* argv[]) {
     return pontella::main(
@@ -8,12 +9,21 @@ int main(int argc, char* argv[]) {
          "    If the string 'none' (without quotes) is used for the td (respectively, aps) file,",
          "    the Event Stream file is build from the aps (respectively, td) file only",
          "Available options:",
-         "    -h, --help    shows this help message"},
+         "    -q depth, --queue-depth depth",
+         "                           sets the number of event blocks buffered for each reader and writer thread",
+         "                               defaults to 4",
+         "                               the writer thread is only used with two or more hardware cores",
+         "    -b, --back-pressure    prints the writer queue statistics to the standard error",
+         "    -h, --help             shows this help message"},
         argc,
         argv,
         3,
-        {},
-        {},
+        {
+            {"queue-depth", {"q"}},
+        },
+        {
+            {"back-pressure", {"b"}},
+        },
         [](pontella::command command) {
             if (command.arguments[0] == command.arguments[1]) {
                 throw std::runtime_error("The td and aps inputs must be different files, and cannot be both none");
@@ -27,22 +37,45 @@ int main(int argc, char* argv[]) {
             if (command.arguments[0] == "none" && command.arguments[1] == "none") {
                 throw std::runtime_error("none cannot be used for both the td file and aps file");
             }
+            auto depth = pipeline::default_depth;
+            {
+                const auto name_and_argument = command.options.find("queue-depth");
+                if (name_and_argument != command.options.end()) {
+                    depth = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (depth == 0) {
+                        throw std::runtime_error("the queue depth must be larger than 0");
+                    }
+                }
+            }
+            const auto back_pressure = command.flags.find("back-pressure") != command.flags.end();
             if (command.arguments[1] == "none") {
                 auto stream = sepia::filename_to_ifstream(command.arguments[0]);
                 const auto header = dat::read_header(*stream);
-                dat::td_observable(
-                    *stream,
-                    header,
+                pipeline::writer<sepia::dvs_event, sepia::write<sepia::type::dvs>> writer(
                     sepia::write<sepia::type::dvs>(
-                        sepia::filename_to_ofstream(command.arguments[2]), header.width, header.height));
+                        sepia::filename_to_ofstream(command.arguments[2]), header.width, header.height),
+                    depth);
+                dat::td_observable(*stream, header, [&](sepia::dvs_event event) {
+                    writer(event);
+                });
+                writer.close();
+                if (back_pressure) {
+                    std::cerr << "writer: " << writer.ring_statistics() << std::endl;
+                }
             } else if (command.arguments[0] == "none") {
                 auto stream = sepia::filename_to_ifstream(command.arguments[1]);
                 const auto header = dat::read_header(*stream);
-                dat::aps_observable(
-                    *stream,
-                    header,
+                pipeline::writer<sepia::atis_event, sepia::write<sepia::type::atis>> writer(
                     sepia::write<sepia::type::atis>(
-                        sepia::filename_to_ofstream(command.arguments[2]), header.width, header.height));
+                        sepia::filename_to_ofstream(command.arguments[2]), header.width, header.height),
+                    depth);
+                dat::aps_observable(*stream, header, [&](sepia::atis_event event) {
+                    writer(event);
+                });
+                writer.close();
+                if (back_pressure) {
+                    std::cerr << "writer: " << writer.ring_statistics() << std::endl;
+                }
             } else {
                 auto td_stream = sepia::filename_to_ifstream(command.arguments[0]);
                 auto aps_stream = sepia::filename_to_ifstream(command.arguments[1]);
@@ -54,12 +87,17 @@ int main(int argc, char* argv[]) {
                         throw std::runtime_error("the td and aps file have incompatible headers");
                     }
                 }
-                dat::td_aps_observable(
-                    *td_stream,
-                    *aps_stream,
-                    header,
+                pipeline::writer<sepia::atis_event, sepia::write<sepia::type::atis>> writer(
                     sepia::write<sepia::type::atis>(
-                        sepia::filename_to_ofstream(command.arguments[2]), header.width, header.height));
+                        sepia::filename_to_ofstream(command.arguments[2]), header.width, header.height),
+                    depth);
+                dat::parallel_td_aps_observable(*td_stream, *aps_stream, header, depth, [&](sepia::atis_event event) {
+                    writer(event);
+                });
+                writer.close();
+                if (back_pressure) {
+                    std::cerr << "writer: " << writer.ring_statistics() << std::endl;
+                }
             }
         });
 }
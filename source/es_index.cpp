@@ -0,0 +1,57 @@
+#include "../third_party/pontella/source/pontella.hpp"
+#include "time_index.hpp"
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "es_index builds a time index for an Event Stream file.",
+            "    The index is written next to the input, with the .idx extension appended",
+            "    (for example, /path/to/input.es.idx). Tools with a begin option use it to skip",
+            "    the events before begin. The index is ignored once the input file is modified.",
+            "Syntax: ./es_index [options] /path/to/input.es",
+            "Available options:",
+            "    -p events, --period events    sets the number of events between two index entries",
+            "                                      defaults to 65536",
+            "    -h, --help                    shows this help message",
+        },
+        argc,
+        argv,
+        1,
+        {
+            {"period", {"p"}},
+        },
+        {},
+        [](pontella::command command) {
+            auto period = time_index::default_period;
+            {
+                const auto name_and_argument = command.options.find("period");
+                if (name_and_argument != command.options.end()) {
+                    period = std::stoull(name_and_argument->second);
+                    if (period == 0) {
+                        throw std::runtime_error("period must be larger than 0");
+                    }
+                }
+            }
+            const auto file_signature = time_index::filename_to_signature(command.arguments[0]);
+            auto stream = sepia::filename_to_ifstream(command.arguments[0]);
+            const auto header = sepia::read_header(*stream);
+            const auto offset = static_cast<uint64_t>(stream->tellg());
+            std::vector<time_index::entry> entries;
+            switch (header.event_stream_type) {
+                case sepia::type::generic:
+                    entries = time_index::build<sepia::type::generic>(*stream, header, offset, period);
+                    break;
+                case sepia::type::dvs:
+                    entries = time_index::build<sepia::type::dvs>(*stream, header, offset, period);
+                    break;
+                case sepia::type::atis:
+                    entries = time_index::build<sepia::type::atis>(*stream, header, offset, period);
+                    break;
+                case sepia::type::color:
+                    entries = time_index::build<sepia::type::color>(*stream, header, offset, period);
+                    break;
+            }
+            time_index::write(time_index::filename_to_index_filename(command.arguments[0]), file_signature, entries);
+        });
+    return 0;
+}
@@ -1,60 +1,254 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
+#include "pipeline.hpp"
+#include <deque>
+#include <future>
+#include <thread>
+
+/// decimal_pairs contains the two-digit representations of the integers 0 to 99.
+constexpr const char* decimal_pairs =
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+/// hexadecimal_digits contains the hexadecimal digits in lower case.
+constexpr const char* hexadecimal_digits = "0123456789abcdef";
+
+/// write_decimal writes the decimal representation of an integer, and returns the position after the last digit.
+/// Digits are generated two at a time, from the least significant pair.
+inline char* write_decimal(char* output, uint64_t value) {
+    char digits[20];
+    auto begin = digits + sizeof(digits);
+    while (value >= 100) {
+        const auto pair = static_cast<std::size_t>(value % 100) * 2;
+        value /= 100;
+        begin -= 2;
+        begin[0] = decimal_pairs[pair];
+        begin[1] = decimal_pairs[pair + 1];
+    }
+    if (value >= 10) {
+        const auto pair = static_cast<std::size_t>(value) * 2;
+        begin -= 2;
+        begin[0] = decimal_pairs[pair];
+        begin[1] = decimal_pairs[pair + 1];
+    } else {
+        --begin;
+        *begin = static_cast<char>('0' + value);
+    }
+    return std::copy(begin, digits + sizeof(digits), output);
+}
+
+/// write_hexadecimal writes the hexadecimal representation of a byte (without leading zero),
+/// and returns the position after the last digit.
+inline char* write_hexadecimal(char* output, uint8_t value) {
+    if (value >= 16) {
+        *output = hexadecimal_digits[value >> 4];
+        ++output;
+    }
+    *output = hexadecimal_digits[value & 0xf];
+    return output + 1;
+}
+
+/// maximum_row_size returns an upper bound of the number of characters in the row of an event.
+template <typename Event>
+inline std::size_t maximum_row_size(const Event&) {
+    return 64;
+}
+template <>
+inline std::size_t maximum_row_size<sepia::generic_event>(const sepia::generic_event& generic_event) {
+    return 21 + generic_event.bytes.size() * 3;
+}
+
+/// write_row writes the CSV row of an event, and returns the position after the row.
+inline char* write_row(char* output, const sepia::generic_event& generic_event) {
+    output = write_decimal(output, generic_event.t);
+    *output = ',';
+    ++output;
+    for (std::size_t index = 0; index < generic_event.bytes.size(); ++index) {
+        output = write_hexadecimal(output, generic_event.bytes[index]);
+        *output = index == generic_event.bytes.size() - 1 ? '\n' : ' ';
+        ++output;
+    }
+    return output;
+}
+inline char* write_row(char* output, const sepia::dvs_event& dvs_event) {
+    output = write_decimal(output, dvs_event.t);
+    *output = ',';
+    output = write_decimal(output + 1, dvs_event.x);
+    *output = ',';
+    output = write_decimal(output + 1, dvs_event.y);
+    output[0] = ',';
+    output[1] = dvs_event.is_increase ? '1' : '0';
+    output[2] = '\n';
+    return output + 3;
+}
+inline char* write_row(char* output, const sepia::atis_event& atis_event) {
+    output = write_decimal(output, atis_event.t);
+    *output = ',';
+    output = write_decimal(output + 1, atis_event.x);
+    *output = ',';
+    output = write_decimal(output + 1, atis_event.y);
+    output[0] = ',';
+    output[1] = atis_event.is_threshold_crossing ? '1' : '0';
+    output[2] = ',';
+    output[3] = atis_event.polarity ? '1' : '0';
+    output[4] = '\n';
+    return output + 5;
+}
+inline char* write_row(char* output, const sepia::color_event& color_event) {
+    output = write_decimal(output, color_event.t);
+    *output = ',';
+    output = write_decimal(output + 1, color_event.x);
+    *output = ',';
+    output = write_decimal(output + 1, color_event.y);
+    *output = ',';
+    output = write_decimal(output + 1, color_event.r);
+    *output = ',';
+    output = write_decimal(output + 1, color_event.g);
+    *output = ',';
+    output = write_decimal(output + 1, color_event.b);
+    *output = '\n';
+    return output + 1;
+}
+
+/// formatter accumulates rows in a large buffer, and writes the buffer with a single call once it is full.
+class formatter {
+    public:
+    /// buffer_size is the default number of characters written at once.
+    static constexpr std::size_t buffer_size = 1 << 22;
+
+    formatter(std::ostream& output) : _output(output), _buffer(buffer_size), _size(0) {}
+    formatter(const formatter&) = delete;
+    formatter(formatter&& other) = delete;
+    formatter& operator=(const formatter&) = delete;
+    formatter& operator=(formatter&& other) = delete;
+    virtual ~formatter() {}
+
+    /// operator() appends the row of an event.
+    template <typename Event>
+    void operator()(const Event& event) {
+        const auto size = maximum_row_size(event);
+        if (_size + size > _buffer.size()) {
+            flush();
+            if (size > _buffer.size()) {
+                _buffer.resize(size);
+            }
+        }
+        _size = static_cast<std::size_t>(write_row(_buffer.data() + _size, event) - _buffer.data());
+    }
+
+    /// flush writes the buffered rows.
+    void flush() {
+        _output.write(_buffer.data(), static_cast<std::streamsize>(_size));
+        _size = 0;
+    }
+
+    protected:
+    std::ostream& _output;
+    std::vector<char> _buffer;
+    std::size_t _size;
+};
+
+/// format_block returns the rows of a block of events.
+template <typename Event>
+std::vector<char> format_block(std::vector<Event> events) {
+    std::size_t size = 0;
+    for (const auto& event : events) {
+        size += maximum_row_size(event);
+    }
+    std::vector<char> rows(size);
+    auto output = rows.data();
+    for (const auto& event : events) {
+        output = write_row(output, event);
+    }
+    rows.resize(static_cast<std::size_t>(output - rows.data()));
+    return rows;
+}
+
+/// es_to_csv writes the rows of every event in an Event Stream.
+/// With more than one thread, blocks of decoded events are formatted in parallel, and written in order.
+template <sepia::type event_stream_type>
+void es_to_csv(std::unique_ptr<std::istream> input, std::ostream& output, std::size_t threads) {
+    if (threads < 2) {
+        formatter csv_formatter(output);
+        sepia::join_observable<event_stream_type>(
+            std::move(input), [&](sepia::event<event_stream_type> event) { csv_formatter(event); });
+        csv_formatter.flush();
+        return;
+    }
+    std::deque<std::future<std::vector<char>>> blocks;
+    std::vector<sepia::event<event_stream_type>> events;
+    events.reserve(pipeline::block_size);
+    const auto send = [&]() {
+        if (blocks.size() >= 2 * threads) {
+            const auto rows = blocks.front().get();
+            output.write(rows.data(), static_cast<std::streamsize>(rows.size()));
+            blocks.pop_front();
+        }
+        blocks.push_back(
+            std::async(std::launch::async, format_block<sepia::event<event_stream_type>>, std::move(events)));
+        events = std::vector<sepia::event<event_stream_type>>();
+        events.reserve(pipeline::block_size);
+    };
+    sepia::join_observable<event_stream_type>(std::move(input), [&](sepia::event<event_stream_type> event) {
+        events.push_back(std::move(event));
+        if (events.size() == pipeline::block_size) {
+            send();
+        }
+    });
+    if (!events.empty()) {
+        send();
+    }
+    for (; !blocks.empty(); blocks.pop_front()) {
+        const auto rows = blocks.front().get();
+        output.write(rows.data(), static_cast<std::streamsize>(rows.size()));
+    }
+}
 
 int main(int argc, char* argv[]) {
     return pontella::main(
         {"es_to_csv converts an Event Stream file into a csv file (compatible with Excel and Matlab)\n"
          "Syntax: ./es_to_csv [options] /path/to/input.es /path/to/output.csv\n",
          "Available options:",
+         "    -t threads, --threads threads",
+         "                  sets the number of formatting threads",
+         "                      0 uses one thread per hardware core",
+         "                      defaults to 1",
          "    -h, --help    shows this help message"},
         argc,
         argv,
         2,
-        {},
+        {{"threads", {"t"}}},
         {},
         [](pontella::command command) {
+            std::size_t threads = 1;
+            {
+                const auto name_and_argument = command.options.find("threads");
+                if (name_and_argument != command.options.end()) {
+                    threads = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (threads == 0) {
+                        threads = std::max(1u, std::thread::hardware_concurrency());
+                    }
+                }
+            }
             const auto header = sepia::read_header(sepia::filename_to_ifstream(command.arguments[0]));
             auto input = sepia::filename_to_ifstream(command.arguments[0]);
             auto output = sepia::filename_to_ofstream(command.arguments[1]);
             switch (header.event_stream_type) {
                 case sepia::type::generic:
                     *output << "t,bytes\n";
-                    sepia::join_observable<sepia::type::generic>(
-                        std::move(input), [&](sepia::generic_event generic_event) {
-                            *output << generic_event.t << ",";
-                            *output << std::hex;
-                            for (std::size_t index = 0; index < generic_event.bytes.size(); ++index) {
-                                *output << static_cast<uint32_t>(generic_event.bytes[index]);
-                                if (index == generic_event.bytes.size() - 1) {
-                                    *output << "\n";
-                                } else {
-                                    *output << " ";
-                                }
-                            }
-                            *output << std::dec;
-                        });
+                    es_to_csv<sepia::type::generic>(std::move(input), *output, threads);
                     break;
                 case sepia::type::dvs:
                     *output << "t,x,y,is_increase\n";
-                    sepia::join_observable<sepia::type::dvs>(std::move(input), [&](sepia::dvs_event dvs_event) {
-                        *output << dvs_event.t << "," << dvs_event.x << "," << dvs_event.y << ","
-                                << dvs_event.is_increase << "\n";
-                    });
+                    es_to_csv<sepia::type::dvs>(std::move(input), *output, threads);
                     break;
                 case sepia::type::atis:
                     *output << "t,x,y,is_threshold_crossing,polarity\n";
-                    sepia::join_observable<sepia::type::atis>(std::move(input), [&](sepia::atis_event atis_event) {
-                        *output << atis_event.t << "," << atis_event.x << "," << atis_event.y << ","
-                                << atis_event.is_threshold_crossing << "," << atis_event.polarity << "\n";
-                    });
+                    es_to_csv<sepia::type::atis>(std::move(input), *output, threads);
                     break;
                 case sepia::type::color:
                     *output << "t,x,y,r,g,b\n";
-                    sepia::join_observable<sepia::type::color>(std::move(input), [&](sepia::color_event color_event) {
-                        *output << color_event.t << "," << color_event.x << "," << color_event.y << ","
-                                << static_cast<uint32_t>(color_event.r) << "," << static_cast<uint32_t>(color_event.g)
-                                << "," << static_cast<uint32_t>(color_event.b) << "\n";
-                    });
+                    es_to_csv<sepia::type::color>(std::move(input), *output, threads);
                     break;
             }
         });
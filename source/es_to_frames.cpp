@@ -1,14 +1,20 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
-#define STB_TRUETYPE_IMPLEMENTATION
-#include "../third_party/stb_truetype.hpp"
 #include "../third_party/tarsier/source/replicate.hpp"
 #include "../third_party/tarsier/source/stitch.hpp"
-#include "font.hpp"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "frames.hpp"
+#include "pipeline.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
-#include <tuple>
+#include <type_traits>
 
 #ifdef _WIN32
 #include <fcntl.h>
@@ -26,374 +32,581 @@ constexpr uint16_t font_left = 20;
 constexpr uint16_t font_top = 20;
 constexpr uint16_t font_size = 30;
 
-enum class style { exponential, linear, window, cumulative, cumulative_shared };
-
-struct state {
-    std::vector<std::pair<uint64_t, bool>> ts_and_ons;
-    std::vector<std::tuple<uint64_t, double, bool>> ts_and_activities_and_ons;
-    std::vector<std::pair<uint64_t, double>> on_ts_and_activities;
-    std::vector<std::pair<uint64_t, double>> off_ts_and_activities;
-};
-
-struct color {
-    uint8_t r;
-    uint8_t g;
-    uint8_t b;
-    color(uint8_t default_r, uint8_t default_g, uint8_t default_b) : r(default_r), g(default_g), b(default_b) {}
-    color(const std::string& hexadecimal_string) {
-        if (hexadecimal_string.size() != 7 || hexadecimal_string.front() != '#'
-            || std::any_of(std::next(hexadecimal_string.begin()), hexadecimal_string.end(), [](char character) {
-                   return !std::isxdigit(character);
-               })) {
-            throw std::runtime_error("color must be formatted as #hhhhhh, where h is an hexadecimal digit");
+/// write_frame writes rgb24 bytes to the standard output, or to a P6 Netpbm file if the output is a directory.
+inline void write_frame(
+    const std::vector<uint8_t>& bytes,
+    uint16_t width,
+    uint16_t height,
+    const std::string& output_directory,
+    uint8_t digits,
+    uint64_t frame_index) {
+    if (output_directory.empty()) {
+        std::cout.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    } else {
+        std::stringstream name;
+        name << std::setfill('0') << std::setw(digits) << frame_index << ".ppm";
+        const auto filename = sepia::join({output_directory, name.str()});
+        std::ofstream output(filename);
+        if (!output.good()) {
+            throw sepia::unwritable_file(filename);
         }
-        r = static_cast<uint8_t>(std::stoul(hexadecimal_string.substr(1, 2), nullptr, 16));
-        g = static_cast<uint8_t>(std::stoul(hexadecimal_string.substr(3, 2), nullptr, 16));
-        b = static_cast<uint8_t>(std::stoul(hexadecimal_string.substr(5, 2), nullptr, 16));
+        output << "P6\n" << width << " " << height << "\n255\n";
+        output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
     }
-    uint8_t mix_r(color other, float lambda) {
-        return static_cast<uint8_t>((1.0f - lambda) * r + lambda * other.r);
+}
+
+/// segment_output writes the frames of a time-partitioned rendering task to the standard output.
+/// The frames are written directly once the segment is the first pending one (see promote),
+/// and are stored in a temporary file until then.
+class segment_output {
+    public:
+    segment_output() : _file(std::tmpfile()) {
+        if (!_file) {
+            throw std::runtime_error("creating a temporary file failed");
+        }
     }
-    uint8_t mix_g(color other, float lambda) {
-        return static_cast<uint8_t>((1.0f - lambda) * g + lambda * other.g);
+    segment_output(const segment_output&) = delete;
+    segment_output(segment_output&& other) = delete;
+    segment_output& operator=(const segment_output&) = delete;
+    segment_output& operator=(segment_output&& other) = delete;
+    virtual ~segment_output() {
+        if (_file) {
+            std::fclose(_file);
+        }
     }
-    uint8_t mix_b(color other, float lambda) {
-        return static_cast<uint8_t>((1.0f - lambda) * b + lambda * other.b);
+
+    /// write outputs the bytes of a frame.
+    virtual void write(const std::vector<uint8_t>& bytes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_file) {
+            if (std::fwrite(bytes.data(), 1, bytes.size(), _file) != bytes.size()) {
+                throw std::runtime_error("writing to a temporary file failed");
+            }
+        } else {
+            std::cout.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
     }
-    std::string hex() {
-        std::stringstream stream;
-        stream << "#" << std::setw(2) << std::setfill('0') << std::hex << static_cast<int32_t>(r) << std::setw(2)
-               << std::setfill('0') << std::hex << static_cast<int32_t>(g) << std::setw(2) << std::setfill('0')
-               << std::hex << static_cast<int32_t>(b);
-        const auto result = stream.str();
-        return result;
+
+    /// promote copies the frames written so far to the standard output, and writes the next frames directly.
+    virtual void promote() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::rewind(_file);
+        std::vector<char> bytes(1 << 20);
+        for (;;) {
+            const auto size = std::fread(bytes.data(), 1, bytes.size(), _file);
+            if (size == 0) {
+                break;
+            }
+            std::cout.write(bytes.data(), static_cast<std::streamsize>(size));
+        }
+        if (std::ferror(_file)) {
+            throw std::runtime_error("reading from a temporary file failed");
+        }
+        std::fclose(_file);
+        _file = nullptr;
     }
+
+    protected:
+    std::mutex _mutex;
+    std::FILE* _file;
 };
 
-class frame {
-    public:
-    frame(uint16_t width, uint16_t height, uint16_t scale) :
-        _width(width * scale), _height(height * scale), _scale(scale), _bytes((width * scale) * (height * scale) * 3) {}
-    frame(const frame&) = delete;
-    frame(frame&& other) = delete;
-    frame& operator=(const frame&) = delete;
-    frame& operator=(frame&& other) = delete;
-    virtual ~frame() {}
+/// pending_segment holds the output and the number of frames of a time-partitioned rendering task.
+/// output is null if the frames are written to a directory.
+struct pending_segment {
+    std::unique_ptr<segment_output> output;
+    std::future<uint64_t> frames;
+};
+
+/// snapshot is a copy of the pixels' state at a frame boundary.
+struct snapshot {
+    state style_state;
+    std::vector<uint64_t> delta_ts;
+    uint64_t frame_t;
+};
 
-    virtual void paste_state(
-        uint16_t width,
-        uint16_t height,
+/// renderer paints snapshots and writes the resulting frames on two dedicated threads.
+/// At most depth snapshots and depth frames are buffered, and their memory is reused,
+/// hence a slow output throttles the state update instead of accumulating frames.
+/// close must be called once all the snapshots have been sent, it rethrows the threads' exception (if any).
+class renderer {
+    public:
+    renderer(
+        frame& output_frame,
         const state& style_state,
-        uint16_t x_offset,
-        uint16_t y_offset,
-        style decay_style,
-        uint64_t tau,
-        color on_color,
-        color off_color,
-        color idle_color,
-        uint64_t frame_t,
-        float cumulative_ratio,
-        float lambda_maximum,
-        bool lambda_maximum_auto) {
-        if (decay_style == style::cumulative || decay_style == style::cumulative_shared) {
-            std::vector<std::pair<float, bool>> lambdas_and_ons(width * height);
-            for (std::size_t index = 0; index < width * height; ++index) {
-                switch (decay_style) {
-                    case style::cumulative: {
-                        const auto on_lambda =
-                            style_state.on_ts_and_activities[index].second
-                            * std::exp(
-                                -static_cast<float>(frame_t - 1 - style_state.on_ts_and_activities[index].first)
-                                / static_cast<float>(tau));
-                        const auto off_lambda =
-                            style_state.off_ts_and_activities[index].second
-                            * std::exp(
-                                -static_cast<float>(frame_t - 1 - style_state.off_ts_and_activities[index].first)
-                                / static_cast<float>(tau));
-                        if (off_lambda > on_lambda) {
-                            lambdas_and_ons[index].first = off_lambda;
-                            lambdas_and_ons[index].second = false;
-                        } else {
-                            lambdas_and_ons[index].first = on_lambda;
-                            lambdas_and_ons[index].second = true;
-                        }
-                        break;
+        const std::vector<uint64_t>& delta_ts,
+        std::size_t depth,
+        const std::string& output_directory,
+        uint8_t digits,
+        std::function<void(frame&, const snapshot&)> paste) :
+        _output_frame(output_frame),
+        _paste(std::move(paste)),
+        _snapshots(depth, {snapshot{style_state, delta_ts, 0}}),
+        _frames(depth, std::vector<uint8_t>(output_frame.width() * output_frame.height() * 3)),
+        _closed(false),
+        _render([this]() {
+            try {
+                std::vector<snapshot> snapshots;
+                std::vector<uint8_t> bytes;
+                while (_snapshots.pop(snapshots)) {
+                    _paste(_output_frame, snapshots.front());
+                    if (!_snapshots.release(std::move(snapshots)) || !_frames.acquire(bytes)) {
+                        return;
                     }
-                    case style::cumulative_shared: {
-                        lambdas_and_ons[index].first =
-                            std::get<1>(style_state.ts_and_activities_and_ons[index])
-                            * std::exp(
-                                -static_cast<float>(
-                                    frame_t - 1 - std::get<0>(style_state.ts_and_activities_and_ons[index]))
-                                / static_cast<float>(tau));
-                        lambdas_and_ons[index].second = std::get<2>(style_state.ts_and_activities_and_ons[index]);
-                        break;
+                    _output_frame.swap_bytes(bytes);
+                    if (!_frames.push(std::move(bytes))) {
+                        return;
                     }
-                    default:
-                        break;
                 }
+                _frames.close();
+            } catch (...) {
+                _snapshots.cancel();
+                _frames.cancel();
+                throw;
             }
-            if (lambda_maximum_auto) {
-                std::vector<float> sorted_lambdas(lambdas_and_ons.size());
-                std::transform(
-                    lambdas_and_ons.begin(),
-                    lambdas_and_ons.end(),
-                    sorted_lambdas.begin(),
-                    [](const std::pair<float, bool> lambda_and_on) { return lambda_and_on.first; });
-                std::sort(sorted_lambdas.begin(), sorted_lambdas.end());
-                lambda_maximum = std::max(
-                    1.0f,
-                    sorted_lambdas[static_cast<std::size_t>((sorted_lambdas.size() - 1) * (1.0f - cumulative_ratio))]);
-            }
-            for (uint16_t y = 0; y < height; ++y) {
-                for (uint16_t x = 0; x < width; ++x) {
-                    const auto lambda_and_on = lambdas_and_ons[x + y * width];
-                    const auto scaled_lambda =
-                        lambda_and_on.first > lambda_maximum ? 1.0 : lambda_and_on.first / lambda_maximum;
-                    const auto r = idle_color.mix_r(lambda_and_on.second ? on_color : off_color, scaled_lambda);
-                    const auto g = idle_color.mix_g(lambda_and_on.second ? on_color : off_color, scaled_lambda);
-                    const auto b = idle_color.mix_b(lambda_and_on.second ? on_color : off_color, scaled_lambda);
-                    for (uint16_t y_scale = 0; y_scale < _scale; ++y_scale) {
-                        for (uint16_t x_scale = 0; x_scale < _scale; ++x_scale) {
-                            const auto index = ((x + x_offset) * _scale + x_scale
-                                                + (_height - _scale - (y + y_offset) * _scale + y_scale) * _width)
-                                               * 3;
-                            _bytes[index] = r;
-                            _bytes[index + 1] = g;
-                            _bytes[index + 2] = b;
-                        }
-                    }
-                }
-            }
-        } else {
-            for (uint16_t y = 0; y < height; ++y) {
-                for (uint16_t x = 0; x < width; ++x) {
-                    const auto& t_and_on = style_state.ts_and_ons[x + y * width];
-                    auto lambda = 0.0f;
-                    if (t_and_on.first < std::numeric_limits<uint64_t>::max()) {
-                        switch (decay_style) {
-                            case style::exponential:
-                                lambda = std::exp(
-                                    -static_cast<float>(frame_t - 1 - t_and_on.first) / static_cast<float>(tau));
-                                break;
-                            case style::linear:
-                                lambda = t_and_on.first + 2 * tau > frame_t - 1 ?
-                                             static_cast<float>(t_and_on.first + 2 * tau - (frame_t - 1))
-                                                 / static_cast<float>(2 * tau) :
-                                             0.0f;
-                                break;
-                            case style::window:
-                                lambda = t_and_on.first + tau > frame_t - 1 ? 1.0f : 0.0f;
-                                break;
-                            default:
-                                break;
-                        }
-                    }
-                    const auto r = idle_color.mix_r(t_and_on.second ? on_color : off_color, lambda);
-                    const auto g = idle_color.mix_g(t_and_on.second ? on_color : off_color, lambda);
-                    const auto b = idle_color.mix_b(t_and_on.second ? on_color : off_color, lambda);
-                    for (uint16_t y_scale = 0; y_scale < _scale; ++y_scale) {
-                        for (uint16_t x_scale = 0; x_scale < _scale; ++x_scale) {
-                            const auto index = ((x + x_offset) * _scale + x_scale
-                                                + (_height - _scale - (y + y_offset) * _scale + y_scale) * _width)
-                                               * 3;
-                            _bytes[index] = r;
-                            _bytes[index + 1] = g;
-                            _bytes[index + 2] = b;
-                        }
+        }),
+        _write([this, output_directory, digits]() {
+            try {
+                std::vector<uint8_t> bytes;
+                for (uint64_t frame_index = 0; _frames.pop(bytes); ++frame_index) {
+                    write_frame(
+                        bytes, _output_frame.width(), _output_frame.height(), output_directory, digits, frame_index);
+                    if (!_frames.release(std::move(bytes))) {
+                        return;
                     }
                 }
+            } catch (...) {
+                _snapshots.cancel();
+                _frames.cancel();
+                throw;
             }
+        }) {}
+    renderer(const renderer&) = delete;
+    renderer(renderer&& other) = delete;
+    renderer& operator=(const renderer&) = delete;
+    renderer& operator=(renderer&& other) = delete;
+    virtual ~renderer() {
+        if (!_closed) {
+            _snapshots.cancel();
+            _frames.cancel();
         }
     }
 
-    virtual void paste_delta_ts(
-        uint16_t width,
-        uint16_t height,
-        const std::vector<uint64_t>& delta_ts,
-        uint16_t x_offset,
-        uint16_t y_offset,
-        uint64_t black,
-        bool black_auto,
-        uint64_t white,
-        bool white_auto,
-        float discard_ratio,
-        color atis_color) {
-        auto minimum = 0.5f;
-        auto maximum = 0.5f;
-        if (white_auto || black_auto) {
-            std::vector<uint64_t> sorted_delta_ts(delta_ts.size());
-            const auto end =
-                std::copy_if(delta_ts.begin(), delta_ts.end(), sorted_delta_ts.begin(), [](uint64_t delta_t) {
-                    return delta_t < std::numeric_limits<uint64_t>::max() && delta_t > 0;
-                });
-            const auto size = static_cast<std::size_t>(std::distance(sorted_delta_ts.begin(), end));
-            if (size > 0) {
-                std::sort(sorted_delta_ts.begin(), end);
-                auto black_candidate = sorted_delta_ts[static_cast<std::size_t>((size - 1) * (1.0f - discard_ratio))];
-                auto white_candidate = sorted_delta_ts[static_cast<std::size_t>((size - 1) * discard_ratio + 0.5f)];
-                if (black_candidate > white_candidate) {
-                    minimum = 1.0f / static_cast<float>(black_candidate);
-                    maximum = 1.0f / static_cast<float>(white_candidate);
-                } else {
-                    black_candidate = *std::prev(end);
-                    white_candidate = sorted_delta_ts.front();
-                    if (black_candidate > white_candidate) {
-                        minimum = 1.0f / static_cast<float>(black_candidate);
-                        maximum = 1.0f / static_cast<float>(white_candidate);
-                    }
-                }
-            }
-        } else {
-            minimum = 1.0f / static_cast<float>(black);
-            maximum = 1.0f / static_cast<float>(white);
+    /// send copies the state into a recycled snapshot, and passes it to the render thread.
+    virtual void send(const state& style_state, const std::vector<uint64_t>& delta_ts, uint64_t frame_t) {
+        std::vector<snapshot> snapshots;
+        if (!_snapshots.acquire(snapshots)) {
+            stopped();
         }
-        auto slope = 0.0f;
-        auto intercept = 0.5f;
-        if (maximum > minimum) {
-            slope = 1.0f / (maximum - minimum);
-            intercept = -slope * minimum;
+        snapshots.front().style_state = style_state;
+        snapshots.front().delta_ts = delta_ts;
+        snapshots.front().frame_t = frame_t;
+        if (!_snapshots.push(std::move(snapshots))) {
+            stopped();
         }
-        for (uint16_t y = 0; y < height; ++y) {
-            for (uint16_t x = 0; x < width; ++x) {
-                const auto delta_t = delta_ts[x + y * width];
-                if (delta_t == std::numeric_limits<uint64_t>::max()) {
-                    for (uint16_t y_scale = 0; y_scale < _scale; ++y_scale) {
-                        for (uint16_t x_scale = 0; x_scale < _scale; ++x_scale) {
-                            const auto index = ((x + x_offset) * _scale + x_scale
-                                                + (_height - _scale - (y + y_offset) * _scale + y_scale) * _width)
-                                               * 3;
-                            _bytes[index] = atis_color.r;
-                            _bytes[index + 1] = atis_color.g;
-                            _bytes[index + 2] = atis_color.b;
-                        }
-                    }
-                } else {
-                    uint8_t value = 0;
-                    if (delta_t > 0) {
-                        const auto luminance = 1.0f / static_cast<float>(delta_t);
-                        if (luminance >= maximum) {
-                            value = 255;
-                        } else if (luminance > minimum) {
-                            value = static_cast<uint8_t>((slope * luminance + intercept) * 255.0f);
-                        }
-                    }
-                    for (uint16_t y_scale = 0; y_scale < _scale; ++y_scale) {
-                        for (uint16_t x_scale = 0; x_scale < _scale; ++x_scale) {
-                            const auto index = ((x + x_offset) * _scale + x_scale
-                                                + (_height - _scale - (y + y_offset) * _scale + y_scale) * _width)
-                                               * 3;
-                            _bytes[index] = value;
-                            _bytes[index + 1] = value;
-                            _bytes[index + 2] = value;
+    }
+
+    /// close waits for the pending frames to be rendered and written.
+    virtual void close() {
+        _snapshots.close();
+        _closed = true;
+        _render.join();
+        _write.join();
+    }
+
+    /// snapshots_statistics returns the back-pressure statistics of the snapshots queue.
+    virtual pipeline::statistics snapshots_statistics() const {
+        return _snapshots.ring_statistics();
+    }
+
+    /// frames_statistics returns the back-pressure statistics of the frames queue.
+    virtual pipeline::statistics frames_statistics() const {
+        return _frames.ring_statistics();
+    }
+
+    protected:
+    /// stopped rethrows the exception that stopped the render or write thread.
+    void stopped() {
+        _closed = true;
+        _render.join();
+        _write.join();
+        throw std::runtime_error("the renderer stopped");
+    }
+
+    frame& _output_frame;
+    std::function<void(frame&, const snapshot&)> _paste;
+    pipeline::exchange<snapshot> _snapshots;
+    pipeline::exchange<uint8_t> _frames;
+    bool _closed;
+    pipeline::stage _render;
+    pipeline::stage _write;
+};
+
+/// join_pipelined_observable decodes an Event Stream on a dedicated thread, and dispatches the events in blocks
+/// on the calling thread. handle_event may throw sepia::end_of_file to stop the decoding.
+/// It returns the back-pressure statistics of the events queue.
+template <sepia::type event_stream_type, typename HandleEvent>
+pipeline::statistics join_pipelined_observable(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    std::size_t depth,
+    HandleEvent&& handle_event) {
+    pipeline::exchange<sepia::event<event_stream_type>> events(depth, {});
+    pipeline::stage decode([&]() {
+        try {
+            std::vector<sepia::event<event_stream_type>> block;
+            if (!events.acquire(block)) {
+                return;
+            }
+            sepia::join_observable<event_stream_type>(
+                std::move(input), header, [&](sepia::event<event_stream_type> event) {
+                    block.push_back(event);
+                    if (block.size() == pipeline::block_size) {
+                        if (!events.push(std::move(block)) || !events.acquire(block)) {
+                            throw sepia::end_of_file();
                         }
+                        block.clear();
                     }
-                }
+                });
+            if (!block.empty()) {
+                events.push(std::move(block));
+            }
+            events.close();
+        } catch (...) {
+            events.cancel();
+            throw;
+        }
+    });
+    try {
+        std::vector<sepia::event<event_stream_type>> block;
+        while (events.pop(block)) {
+            for (const auto& event : block) {
+                handle_event(event);
+            }
+            block.clear();
+            if (!events.release(std::move(block))) {
+                break;
             }
         }
+    } catch (const sepia::end_of_file&) {
+        events.cancel();
+    } catch (...) {
+        events.cancel();
+        throw;
     }
+    decode.join();
+    return events.ring_statistics();
+}
+
+/// settings holds the rendering parameters shared by the DVS and ATIS streams.
+struct settings {
+    uint64_t begin_t;
+    uint64_t end_t;
+    uint64_t frametime;
+    uint16_t scale;
+    std::size_t threads;
+    std::size_t depth;
+    bool back_pressure;
+    uint64_t tau;
+    color on_color;
+    color off_color;
+    color idle_color;
+    float cumulative_ratio;
+    float lambda_maximum;
+    bool lambda_maximum_auto;
+    bool add_timecode;
+    std::string output_directory;
+    uint8_t digits;
+    uint64_t segment_frames;
+    uint64_t warm_up;
+};
 
-    virtual void paste_timecode(uint16_t left, uint16_t top, uint16_t font_size, uint64_t frame_t) {
-        if (!_fontinfo) {
-            _fontinfo = std::unique_ptr<stbtt_fontinfo>(new stbtt_fontinfo);
-            if (stbtt_InitFont(_fontinfo.get(), monaco_bytes.data(), 0) == 0) {
-                throw std::runtime_error("loading the font failed");
+/// tone_mapping holds the parameters of the ATIS exposure measurements panel.
+struct tone_mapping {
+    uint64_t black;
+    bool black_auto;
+    uint64_t white;
+    bool white_auto;
+    float discard_ratio;
+    color atis_color;
+};
+
+/// print_back_pressure prints the statistics of the rendering queues to the standard error.
+inline void print_back_pressure(const pipeline::statistics& events_statistics, const renderer& frames_renderer) {
+    std::cerr << "decode: " << events_statistics << std::endl;
+    std::cerr << "render: " << frames_renderer.snapshots_statistics() << std::endl;
+    std::cerr << "write: " << frames_renderer.frames_statistics() << std::endl;
+}
+
+/// dvs_to_frames renders the frames of a DVS stream.
+template <style decay_style>
+void dvs_to_frames(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    uint64_t base_t,
+    const settings& frames_settings) {
+    state style_state;
+    kernel<decay_style>::resize(style_state, header.width * header.height, frames_settings.tau);
+    uint64_t frame_index = 0;
+    auto first_t = frames_settings.begin_t;
+    frame output_frame(header.width, header.height, frames_settings.scale, frames_settings.threads);
+    renderer frames_renderer(
+        output_frame,
+        style_state,
+        {},
+        frames_settings.depth,
+        frames_settings.output_directory,
+        frames_settings.digits,
+        [&](frame& render_frame, const snapshot& frame_snapshot) {
+            render_frame.paste_state<decay_style>(
+                header.width,
+                header.height,
+                frame_snapshot.style_state,
+                0,
+                0,
+                frames_settings.tau,
+                frames_settings.on_color,
+                frames_settings.off_color,
+                frames_settings.idle_color,
+                frame_snapshot.frame_t,
+                frames_settings.cumulative_ratio,
+                frames_settings.lambda_maximum,
+                frames_settings.lambda_maximum_auto);
+            if (frames_settings.add_timecode) {
+                render_frame.paste_timecode(font_left, font_top, font_size, frame_snapshot.frame_t);
             }
-        }
-        int32_t ascent = 0;
-        int32_t descent = 0;
-        int32_t line_gap = 0;
-        stbtt_GetFontVMetrics(_fontinfo.get(), &ascent, &descent, &line_gap);
-        const auto scale = stbtt_ScaleForPixelHeight(_fontinfo.get(), font_size);
-        const auto timecode_string = timecode(frame_t).to_timecode_string();
-        int32_t width = 0;
-        int32_t height = 0;
-        for (std::size_t index = 0; index < timecode_string.size(); ++index) {
-            int32_t advance_width = 0;
-            int32_t left_side_bearing = 0;
-            stbtt_GetCodepointHMetrics(_fontinfo.get(), timecode_string[index], &advance_width, &left_side_bearing);
-            int32_t top = 0;
-            int32_t left = 0;
-            int32_t bottom = 0;
-            int32_t right = 0;
-            stbtt_GetCodepointBitmapBox(
-                _fontinfo.get(), timecode_string[index], scale, scale, &left, &top, &right, &bottom);
-            height = std::max(height, static_cast<int32_t>(std::roundf(ascent * scale)) + bottom);
-            width += static_cast<int32_t>(std::roundf(advance_width * scale));
-            if (index < timecode_string.size() - 1) {
-                width += static_cast<int32_t>(std::roundf(
-                    stbtt_GetCodepointKernAdvance(_fontinfo.get(), timecode_string[index], timecode_string[index + 1])
-                    * scale));
+        });
+    const auto events_statistics = join_pipelined_observable<sepia::type::dvs>(
+        std::move(input), header, frames_settings.depth, [&](sepia::dvs_event event) {
+            event.t += base_t;
+            if (frames_settings.begin_t != std::numeric_limits<uint64_t>::max() && event.t < frames_settings.begin_t) {
+                return;
+            }
+            if (event.t >= frames_settings.end_t) {
+                throw sepia::end_of_file();
+            }
+            if (first_t == std::numeric_limits<uint64_t>::max()) {
+                first_t = event.t;
+            }
+            auto frame_t = first_t + frame_index * frames_settings.frametime;
+            while (event.t >= frame_t) {
+                frames_renderer.send(style_state, {}, frame_t);
+                ++frame_index;
+                frame_t = first_t + frame_index * frames_settings.frametime;
+            }
+            kernel<decay_style>::update(
+                style_state, event.x + event.y * header.width, event.t, event.is_increase, frames_settings.tau);
+        });
+    frames_renderer.close();
+    if (frames_settings.back_pressure) {
+        print_back_pressure(events_statistics, frames_renderer);
+    }
+}
+
+/// dvs_segments_to_frames renders the frames of a DVS file in time segments, processed in parallel.
+/// Each segment replays the events of a warm-up interval before its first frame, and the segments are written in
+/// order. At most threads segments are rendered at once, and the first one that renders fewer frames than its length
+/// ends the loop. If the file has no valid index, one is built in memory before rendering, so that each segment only
+/// decodes its warm-up interval and its frames.
+template <style decay_style>
+void dvs_segments_to_frames(const std::string& filename, const sepia::header& header, const settings& frames_settings) {
+    const auto entries = time_index::read_or_build<sepia::type::dvs>(filename, time_index::default_period);
+    auto first_t = frames_settings.begin_t;
+    if (first_t == std::numeric_limits<uint64_t>::max()) {
+        time_index::join_observable<sepia::type::dvs>(filename, 0, [&](sepia::dvs_event event) {
+            first_t = event.t;
+            throw sepia::end_of_file();
+        });
+    }
+    const auto render_segment = [&](uint64_t segment_index, segment_output* output) {
+        uint64_t frames = 0;
+        state segment_state;
+        kernel<decay_style>::resize(segment_state, header.width * header.height, frames_settings.tau);
+        frame segment_frame(header.width, header.height, frames_settings.scale, 1);
+        const auto first_frame_index = segment_index * frames_settings.segment_frames;
+        const auto segment_offset = first_frame_index * frames_settings.frametime;
+        const auto warm_up_t =
+            first_t + (segment_offset > frames_settings.warm_up ? segment_offset - frames_settings.warm_up : 0);
+        auto frame_index = first_frame_index;
+        time_index::join_observable<sepia::type::dvs>(filename, entries, warm_up_t, [&](sepia::dvs_event event) {
+            if (event.t < warm_up_t) {
+                return;
+            }
+            if (event.t >= frames_settings.end_t) {
+                throw sepia::end_of_file();
+            }
+            auto frame_t = first_t + frame_index * frames_settings.frametime;
+            while (event.t >= frame_t) {
+                if (frames == frames_settings.segment_frames) {
+                    throw sepia::end_of_file();
+                }
+                segment_frame.paste_state<decay_style>(
+                    header.width,
+                    header.height,
+                    segment_state,
+                    0,
+                    0,
+                    frames_settings.tau,
+                    frames_settings.on_color,
+                    frames_settings.off_color,
+                    frames_settings.idle_color,
+                    frame_t,
+                    frames_settings.cumulative_ratio,
+                    frames_settings.lambda_maximum,
+                    frames_settings.lambda_maximum_auto);
+                if (frames_settings.add_timecode) {
+                    segment_frame.paste_timecode(font_left, font_top, font_size, frame_t);
+                }
+                if (output) {
+                    output->write(segment_frame.bytes());
+                } else {
+                    write_frame(
+                        segment_frame.bytes(),
+                        segment_frame.width(),
+                        segment_frame.height(),
+                        frames_settings.output_directory,
+                        frames_settings.digits,
+                        frame_index);
+                }
+                ++frames;
+                ++frame_index;
+                frame_t = first_t + frame_index * frames_settings.frametime;
+            }
+            kernel<decay_style>::update(
+                segment_state, event.x + event.y * header.width, event.t, event.is_increase, frames_settings.tau);
+        });
+        return frames;
+    };
+    std::deque<pending_segment> segments;
+    auto ended = false;
+    const auto consume = [&]() {
+        const auto frames = segments.front().frames.get();
+        segments.pop_front();
+        if (!ended) {
+            ended = frames < frames_settings.segment_frames;
+            if (!ended && !segments.empty() && segments.front().output) {
+                segments.front().output->promote();
             }
         }
-        std::vector<uint8_t> bitmap(width * height);
-        int32_t x = 0;
-        for (std::size_t index = 0; index < timecode_string.size(); ++index) {
-            int32_t advance_width = 0;
-            int32_t left_side_bearing = 0;
-            stbtt_GetCodepointHMetrics(_fontinfo.get(), timecode_string[index], &advance_width, &left_side_bearing);
-            int32_t top = 0;
-            int32_t left = 0;
-            int32_t bottom = 0;
-            int32_t right = 0;
-            stbtt_GetCodepointBitmapBox(
-                _fontinfo.get(), timecode_string[index], scale, scale, &left, &top, &right, &bottom);
-            stbtt_MakeCodepointBitmap(
-                _fontinfo.get(),
-                bitmap.data() + x + static_cast<int32_t>(std::roundf(left_side_bearing * scale))
-                    + (static_cast<int32_t>(std::roundf(ascent * scale)) + top) * width,
-                right - left,
-                bottom - top,
-                width,
-                scale,
-                scale,
-                timecode_string[index]);
-            if (index < timecode_string.size() - 1) {
-                x += static_cast<int32_t>(std::roundf(advance_width * scale))
-                     + static_cast<int32_t>(std::roundf(
-                         stbtt_GetCodepointKernAdvance(
-                             _fontinfo.get(), timecode_string[index], timecode_string[index + 1])
-                         * scale));
+    };
+    for (uint64_t segment_index = 0; !ended; ++segment_index) {
+        if (segments.size() >= frames_settings.threads) {
+            consume();
+            if (ended) {
+                break;
             }
         }
-        for (int32_t y = 0; y < height; ++y) {
-            for (int32_t x = 0; x < width; ++x) {
-                const auto frame_x = x + left;
-                const auto frame_y = y + top;
-                if (frame_x >= 0 && frame_x < _width && frame_y >= 0 && frame_y < _height) {
-                    const auto index = (frame_x + frame_y * _width) * 3;
-                    const auto alpha = bitmap[x + y * width];
-                    _bytes[index] = _bytes[index] * (255 - alpha) / 255 + alpha;
-                    _bytes[index + 1] = _bytes[index + 1] * (255 - alpha) / 255 + alpha;
-                    _bytes[index + 2] = _bytes[index + 2] * (255 - alpha) / 255 + alpha;
-                }
+        std::unique_ptr<segment_output> output;
+        if (frames_settings.output_directory.empty()) {
+            output.reset(new segment_output());
+            if (segments.empty()) {
+                output->promote();
             }
         }
+        const auto output_pointer = output.get();
+        segments.push_back(
+            {std::move(output), std::async(std::launch::async, render_segment, segment_index, output_pointer)});
     }
-
-    virtual void write(const std::string& output_directory, uint8_t digits, uint64_t frame_index) const {
-        if (output_directory.empty()) {
-            std::cout.write(reinterpret_cast<const char*>(_bytes.data()), _bytes.size());
-        } else {
-            std::stringstream name;
-            name << std::setfill('0') << std::setw(digits) << frame_index << ".ppm";
-            const auto filename = sepia::join({output_directory, name.str()});
-            std::ofstream output(filename);
-            if (!output.good()) {
-                throw sepia::unwritable_file(filename);
-            }
-            output << "P6\n" << _width << " " << _height << "\n255\n";
-            output.write(reinterpret_cast<const char*>(_bytes.data()), _bytes.size());
-        }
+    while (!segments.empty()) {
+        consume();
     }
+}
 
-    protected:
-    const uint16_t _width;
-    const uint16_t _height;
-    const uint16_t _scale;
-    std::vector<uint8_t> _bytes;
-    std::unique_ptr<stbtt_fontinfo> _fontinfo;
-};
+/// atis_to_frames renders the frames of an ATIS stream, with the exposure measurements on the right.
+template <style decay_style>
+void atis_to_frames(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    uint64_t base_t,
+    const settings& frames_settings,
+    const tone_mapping& atis_tone_mapping) {
+    state style_state;
+    kernel<decay_style>::resize(style_state, header.width * header.height, frames_settings.tau);
+    std::vector<uint64_t> delta_ts(header.width * header.height, std::numeric_limits<uint64_t>::max());
+    uint64_t frame_index = 0;
+    auto first_t = std::numeric_limits<uint64_t>::max();
+    frame output_frame(header.width * 2, header.height, frames_settings.scale, frames_settings.threads);
+    renderer frames_renderer(
+        output_frame,
+        style_state,
+        delta_ts,
+        frames_settings.depth,
+        frames_settings.output_directory,
+        frames_settings.digits,
+        [&](frame& render_frame, const snapshot& frame_snapshot) {
+            render_frame.paste_state<decay_style>(
+                header.width,
+                header.height,
+                frame_snapshot.style_state,
+                0,
+                0,
+                frames_settings.tau,
+                frames_settings.on_color,
+                frames_settings.off_color,
+                frames_settings.idle_color,
+                frame_snapshot.frame_t,
+                frames_settings.cumulative_ratio,
+                frames_settings.lambda_maximum,
+                frames_settings.lambda_maximum_auto);
+            render_frame.paste_delta_ts(
+                header.width,
+                header.height,
+                frame_snapshot.delta_ts,
+                header.width,
+                0,
+                atis_tone_mapping.black,
+                atis_tone_mapping.black_auto,
+                atis_tone_mapping.white,
+                atis_tone_mapping.white_auto,
+                atis_tone_mapping.discard_ratio,
+                atis_tone_mapping.atis_color);
+            if (frames_settings.add_timecode) {
+                render_frame.paste_timecode(font_left, font_top, font_size, frame_snapshot.frame_t);
+            }
+        });
+    const auto events_statistics = join_pipelined_observable<sepia::type::atis>(
+        std::move(input),
+        header,
+        frames_settings.depth,
+        tarsier::make_replicate<sepia::atis_event>(
+            [&](sepia::atis_event event) {
+                event.t += base_t;
+                if (frames_settings.begin_t != std::numeric_limits<uint64_t>::max()
+                    && event.t < frames_settings.begin_t) {
+                    return;
+                }
+                if (event.t >= frames_settings.end_t) {
+                    throw sepia::end_of_file();
+                }
+                if (first_t == std::numeric_limits<uint64_t>::max()) {
+                    first_t = event.t;
+                }
+                auto frame_t = first_t + frame_index * frames_settings.frametime;
+                while (event.t >= frame_t) {
+                    frames_renderer.send(style_state, delta_ts, frame_t);
+                    ++frame_index;
+                    frame_t = first_t + frame_index * frames_settings.frametime;
+                }
+            },
+            sepia::make_split<sepia::type::atis>(
+                [&](sepia::dvs_event event) {
+                    kernel<decay_style>::update(
+                        style_state, event.x + event.y * header.width, event.t, event.is_increase, frames_settings.tau);
+                },
+                tarsier::make_stitch<sepia::threshold_crossing, exposure_measurement>(
+                    header.width,
+                    header.height,
+                    [](sepia::threshold_crossing threshold_crossing, uint64_t delta_t) -> exposure_measurement {
+                        return {delta_t, threshold_crossing.x, threshold_crossing.y};
+                    },
+                    [&](exposure_measurement event) {
+                        delta_ts[event.x + event.y * header.width] = event.delta_t;
+                    }))));
+    frames_renderer.close();
+    if (frames_settings.back_pressure) {
+        print_back_pressure(events_statistics, frames_renderer);
+    }
+}
 
 int main(int argc, char* argv[]) {
     return pontella::main(
@@ -460,6 +673,26 @@ int main(int argc, char* argv[]) {
          "                                               color must be formatted as #hhhhhh,",
          "                                               where h is an hexadecimal digit",
          "                                               defaults to #000000",
+         "    -p threads, --threads threads          sets the number of threads used to render frames",
+         "                                               0 uses all the available cores",
+         "                                               defaults to 1",
+         "    -q depth, --queue-depth depth          sets the number of event blocks, snapshots and frames",
+         "                                               buffered between the decode, update, render",
+         "                                               and write threads",
+         "                                               defaults to 4",
+         "    -u, --back-pressure                    prints the queues statistics to the standard error",
+         "    -g duration, --segment duration        renders segments of this duration in parallel (timecode)",
+         "                                               requires an input file, a DVS stream",
+         "                                               and the exponential, linear or window style",
+         "                                               --threads sets the number of concurrent segments",
+         "                                               use es_index on long recordings",
+         "    -z ratio, --warm-up ratio              sets the replay before each segment, as a multiple of tau",
+         "                                               smaller ratios than the default may change",
+         "                                               the frames of pixels whose last event",
+         "                                               precedes the replay",
+         "                                               defaults to 1 (window), 2 (linear)",
+         "                                               or 128 (exponential), which give frames",
+         "                                               identical to a serial rendering",
          "    -h, --help                 shows this help message"},
         argc,
         argv,
@@ -483,9 +716,14 @@ int main(int argc, char* argv[]) {
             {"black", {"v"}},
             {"white", {"w"}},
             {"atiscolor", {"x"}},
+            {"threads", {"p"}},
+            {"queue-depth", {"q"}},
+            {"segment", {"g"}},
+            {"warm-up", {"z"}},
         },
         {
             {"add-timecode", {"a"}},
+            {"back-pressure", {"u"}},
         },
         [](pontella::command command) {
             uint64_t begin_t = std::numeric_limits<uint64_t>::max();
@@ -526,6 +764,27 @@ int main(int argc, char* argv[]) {
                     scale = static_cast<uint16_t>(scale_candidate);
                 }
             }
+            std::size_t threads = 1;
+            {
+                const auto name_and_argument = command.options.find("threads");
+                if (name_and_argument != command.options.end()) {
+                    threads = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (threads == 0) {
+                        threads = std::max(1u, std::thread::hardware_concurrency());
+                    }
+                }
+            }
+            auto depth = pipeline::default_depth;
+            {
+                const auto name_and_argument = command.options.find("queue-depth");
+                if (name_and_argument != command.options.end()) {
+                    depth = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (depth == 0) {
+                        throw std::runtime_error("the queue depth must be larger than 0");
+                    }
+                }
+            }
+            const auto back_pressure = command.flags.find("back-pressure") != command.flags.end();
             color on_color(0xf4, 0xc2, 0x0d);
             {
                 const auto name_and_argument = command.options.find("oncolor");
@@ -597,6 +856,43 @@ int main(int argc, char* argv[]) {
                     }
                 }
             }
+            uint64_t segment_frames = 0;
+            uint64_t warm_up = 0;
+            {
+                const auto name_and_argument = command.options.find("segment");
+                if (name_and_argument != command.options.end()) {
+                    if (command.options.find("input") == command.options.end()) {
+                        throw std::runtime_error("segment requires an input file");
+                    }
+                    if (decay_style != style::exponential && decay_style != style::linear
+                        && decay_style != style::window) {
+                        throw std::runtime_error("segment requires the exponential, linear or window style");
+                    }
+                    segment_frames = timecode(name_and_argument->second).value() / frametime;
+                    if (segment_frames == 0) {
+                        throw std::runtime_error("segment must be larger than or equal to the frametime");
+                    }
+                    const auto exact_warm_up_ratio =
+                        decay_style == style::window ?
+                            1.0f :
+                            (decay_style == style::linear ? 2.0f : static_cast<float>(exponential_span_ratio));
+                    auto warm_up_ratio = exact_warm_up_ratio;
+                    {
+                        const auto name_and_argument = command.options.find("warm-up");
+                        if (name_and_argument != command.options.end()) {
+                            warm_up_ratio = std::stof(name_and_argument->second);
+                            if (warm_up_ratio < 0.0f) {
+                                throw std::runtime_error("warm-up must be larger than or equal to 0");
+                            }
+                            if (warm_up_ratio < exact_warm_up_ratio) {
+                                std::cerr << "warning: warm-up is smaller than " << exact_warm_up_ratio
+                                          << ", the frames may differ from a serial rendering" << std::endl;
+                            }
+                        }
+                    }
+                    warm_up = static_cast<uint64_t>(warm_up_ratio * static_cast<float>(tau));
+                }
+            }
             std::string output_directory;
             {
                 const auto name_and_argument = command.options.find("output");
@@ -617,6 +913,13 @@ int main(int argc, char* argv[]) {
                 }
             }
             const auto header = sepia::read_header(*input);
+            uint64_t base_t = 0;
+            {
+                const auto name_and_argument = command.options.find("input");
+                if (name_and_argument != command.options.end() && begin_t != std::numeric_limits<uint64_t>::max()) {
+                    base_t = time_index::seek(*input, name_and_argument->second, begin_t);
+                }
+            }
             uint8_t digits = 6;
             {
                 const auto name_and_argument = command.options.find("digits");
@@ -628,104 +931,70 @@ int main(int argc, char* argv[]) {
                     digits = static_cast<uint8_t>(digits_candidate);
                 }
             }
+            const settings frames_settings{
+                begin_t,
+                end_t,
+                frametime,
+                scale,
+                threads,
+                depth,
+                back_pressure,
+                tau,
+                on_color,
+                off_color,
+                idle_color,
+                cumulative_ratio,
+                lambda_maximum,
+                lambda_maximum_auto,
+                add_timecode,
+                output_directory,
+                digits,
+                segment_frames,
+                warm_up};
             switch (header.event_stream_type) {
                 case sepia::type::generic:
                     throw std::runtime_error("unsupported event stream type 'generic'");
-                case sepia::type::dvs: {
-                    state style_state;
-                    switch (decay_style) {
-                        case style::cumulative:
-                            style_state.on_ts_and_activities.resize(header.width * header.height, {0, 0.0});
-                            style_state.off_ts_and_activities.resize(header.width * header.height, {0, 0.0});
-                            break;
-                        case style::cumulative_shared:
-                            style_state.ts_and_activities_and_ons.resize(header.width * header.height, {0, 0.0, false});
-                            break;
-                        default:
-                            style_state.ts_and_ons.resize(
-                                header.width * header.height, {std::numeric_limits<uint64_t>::max(), false});
-                            break;
-                    }
-                    uint64_t frame_index = 0;
-                    auto first_t = begin_t;
-                    frame output_frame(header.width, header.height, scale);
-                    sepia::join_observable<sepia::type::dvs>(std::move(input), header, [&](sepia::dvs_event event) {
-                        if (begin_t != std::numeric_limits<uint64_t>::max() && event.t < begin_t) {
-                            return;
-                        }
-                        if (event.t >= end_t) {
-                            throw sepia::end_of_file();
-                        }
-                        if (first_t == std::numeric_limits<uint64_t>::max()) {
-                            first_t = event.t;
-                        }
-                        auto frame_t = first_t + frame_index * frametime;
-                        while (event.t >= frame_t) {
-                            output_frame.paste_state(
-                                header.width,
-                                header.height,
-                                style_state,
-                                0,
-                                0,
-                                decay_style,
-                                tau,
-                                on_color,
-                                off_color,
-                                idle_color,
-                                frame_t,
-                                cumulative_ratio,
-                                lambda_maximum,
-                                lambda_maximum_auto);
-                            if (add_timecode) {
-                                output_frame.paste_timecode(font_left, font_top, font_size, frame_t);
-                            }
-                            output_frame.write(output_directory, digits, frame_index);
-                            ++frame_index;
-                            frame_t = first_t + frame_index * frametime;
+                case sepia::type::dvs:
+                    if (segment_frames > 0) {
+                        const auto filename = command.options.find("input")->second;
+                        switch (decay_style) {
+                            case style::exponential:
+                                dvs_segments_to_frames<style::exponential>(filename, header, frames_settings);
+                                break;
+                            case style::linear:
+                                dvs_segments_to_frames<style::linear>(filename, header, frames_settings);
+                                break;
+                            case style::window:
+                                dvs_segments_to_frames<style::window>(filename, header, frames_settings);
+                                break;
+                            default:
+                                break;
                         }
-                        const auto index = event.x + event.y * header.width;
+                    } else {
                         switch (decay_style) {
+                            case style::exponential:
+                                dvs_to_frames<style::exponential>(std::move(input), header, base_t, frames_settings);
+                                break;
+                            case style::linear:
+                                dvs_to_frames<style::linear>(std::move(input), header, base_t, frames_settings);
+                                break;
+                            case style::window:
+                                dvs_to_frames<style::window>(std::move(input), header, base_t, frames_settings);
+                                break;
                             case style::cumulative:
-                                if (event.is_increase) {
-                                    style_state.on_ts_and_activities[index].second =
-                                        style_state.on_ts_and_activities[index].second
-                                            * std::exp(
-                                                -static_cast<float>(
-                                                    event.t - style_state.on_ts_and_activities[index].first)
-                                                / static_cast<float>(tau))
-                                        + 1.0;
-                                    style_state.on_ts_and_activities[index].first = event.t;
-                                } else {
-                                    style_state.off_ts_and_activities[index].second =
-                                        style_state.off_ts_and_activities[index].second
-                                            * std::exp(
-                                                -static_cast<float>(
-                                                    event.t - style_state.off_ts_and_activities[index].first)
-                                                / static_cast<float>(tau))
-                                        + 1.0;
-                                    style_state.off_ts_and_activities[index].first = event.t;
-                                }
+                                dvs_to_frames<style::cumulative>(std::move(input), header, base_t, frames_settings);
                                 break;
                             case style::cumulative_shared:
-                                std::get<1>(style_state.ts_and_activities_and_ons[index]) =
-                                    std::get<1>(style_state.ts_and_activities_and_ons[index])
-                                        * std::exp(
-                                            -static_cast<float>(
-                                                event.t - std::get<0>(style_state.ts_and_activities_and_ons[index]))
-                                            / static_cast<float>(tau))
-                                    + 1.0;
-                                std::get<0>(style_state.ts_and_activities_and_ons[index]) = event.t;
-                                std::get<2>(style_state.ts_and_activities_and_ons[index]) = event.is_increase;
-                                break;
-                            default:
-                                style_state.ts_and_ons[index].first = event.t;
-                                style_state.ts_and_ons[index].second = event.is_increase;
+                                dvs_to_frames<style::cumulative_shared>(
+                                    std::move(input), header, base_t, frames_settings);
                                 break;
                         }
-                    });
+                    }
                     break;
-                }
                 case sepia::type::atis: {
+                    if (segment_frames > 0) {
+                        throw std::runtime_error("segment requires a DVS stream");
+                    }
                     uint64_t black = 0;
                     auto black_auto = true;
                     {
@@ -770,130 +1039,30 @@ int main(int argc, char* argv[]) {
                             atis_color = color(name_and_argument->second);
                         }
                     }
-                    state style_state;
+                    const tone_mapping atis_tone_mapping{
+                        black, black_auto, white, white_auto, discard_ratio, atis_color};
                     switch (decay_style) {
+                        case style::exponential:
+                            atis_to_frames<style::exponential>(
+                                std::move(input), header, base_t, frames_settings, atis_tone_mapping);
+                            break;
+                        case style::linear:
+                            atis_to_frames<style::linear>(
+                                std::move(input), header, base_t, frames_settings, atis_tone_mapping);
+                            break;
+                        case style::window:
+                            atis_to_frames<style::window>(
+                                std::move(input), header, base_t, frames_settings, atis_tone_mapping);
+                            break;
                         case style::cumulative:
-                            style_state.on_ts_and_activities.resize(header.width * header.height, {0, 0.0});
-                            style_state.off_ts_and_activities.resize(header.width * header.height, {0, 0.0});
+                            atis_to_frames<style::cumulative>(
+                                std::move(input), header, base_t, frames_settings, atis_tone_mapping);
                             break;
                         case style::cumulative_shared:
-                            style_state.ts_and_activities_and_ons.resize(header.width * header.height, {0, 0.0, false});
-                            break;
-                        default:
-                            style_state.ts_and_ons.resize(
-                                header.width * header.height, {std::numeric_limits<uint64_t>::max(), false});
+                            atis_to_frames<style::cumulative_shared>(
+                                std::move(input), header, base_t, frames_settings, atis_tone_mapping);
                             break;
                     }
-                    std::vector<uint64_t> delta_ts(header.width * header.height, std::numeric_limits<uint64_t>::max());
-                    uint64_t frame_index = 0;
-                    auto first_t = std::numeric_limits<uint64_t>::max();
-                    frame output_frame(header.width * 2, header.height, scale);
-                    sepia::join_observable<sepia::type::atis>(
-                        std::move(input),
-                        header,
-                        tarsier::make_replicate<sepia::atis_event>(
-                            [&](sepia::atis_event event) {
-                                if (begin_t != std::numeric_limits<uint64_t>::max() && event.t < begin_t) {
-                                    return;
-                                }
-                                if (event.t >= end_t) {
-                                    throw sepia::end_of_file();
-                                }
-                                if (first_t == std::numeric_limits<uint64_t>::max()) {
-                                    first_t = event.t;
-                                }
-                                auto frame_t = first_t + frame_index * frametime;
-                                while (event.t >= frame_t) {
-                                    output_frame.paste_state(
-                                        header.width,
-                                        header.height,
-                                        style_state,
-                                        0,
-                                        0,
-                                        decay_style,
-                                        tau,
-                                        on_color,
-                                        off_color,
-                                        idle_color,
-                                        frame_t,
-                                        cumulative_ratio,
-                                        lambda_maximum,
-                                        lambda_maximum_auto);
-                                    output_frame.paste_delta_ts(
-                                        header.width,
-                                        header.height,
-                                        delta_ts,
-                                        header.width,
-                                        0,
-                                        black,
-                                        black_auto,
-                                        white,
-                                        white_auto,
-                                        discard_ratio,
-                                        atis_color);
-                                    if (add_timecode) {
-                                        output_frame.paste_timecode(font_left, font_top, font_size, frame_t);
-                                    }
-                                    output_frame.write(output_directory, digits, frame_index);
-                                    ++frame_index;
-                                    frame_t = first_t + frame_index * frametime;
-                                }
-                            },
-                            sepia::make_split<sepia::type::atis>(
-                                [&](sepia::dvs_event event) {
-                                    const auto index = event.x + event.y * header.width;
-                                    switch (decay_style) {
-                                        case style::cumulative:
-                                            if (event.is_increase) {
-                                                style_state.on_ts_and_activities[index].second =
-                                                    style_state.on_ts_and_activities[index].second
-                                                        * std::exp(
-                                                            -static_cast<float>(
-                                                                event.t - style_state.on_ts_and_activities[index].first)
-                                                            / static_cast<float>(tau))
-                                                    + 1.0;
-                                                style_state.on_ts_and_activities[index].first = event.t;
-                                            } else {
-                                                style_state.off_ts_and_activities[index].second =
-                                                    style_state.off_ts_and_activities[index].second
-                                                        * std::exp(
-                                                            -static_cast<float>(
-                                                                event.t
-                                                                - style_state.off_ts_and_activities[index].first)
-                                                            / static_cast<float>(tau))
-                                                    + 1.0;
-                                                style_state.off_ts_and_activities[index].first = event.t;
-                                            }
-                                            break;
-                                        case style::cumulative_shared:
-                                            std::get<1>(style_state.ts_and_activities_and_ons[index]) =
-                                                std::get<1>(style_state.ts_and_activities_and_ons[index])
-                                                    * std::exp(
-                                                        -static_cast<float>(
-                                                            event.t
-                                                            - std::get<0>(style_state.ts_and_activities_and_ons[index]))
-                                                        / static_cast<float>(tau))
-                                                + 1.0;
-                                            std::get<0>(style_state.ts_and_activities_and_ons[index]) = event.t;
-                                            std::get<2>(style_state.ts_and_activities_and_ons[index]) =
-                                                event.is_increase;
-                                            break;
-                                        default:
-                                            style_state.ts_and_ons[index].first = event.t;
-                                            style_state.ts_and_ons[index].second = event.is_increase;
-                                            break;
-                                    }
-                                },
-                                tarsier::make_stitch<sepia::threshold_crossing, exposure_measurement>(
-                                    header.width,
-                                    header.height,
-                                    [](sepia::threshold_crossing threshold_crossing,
-                                       uint64_t delta_t) -> exposure_measurement {
-                                        return {delta_t, threshold_crossing.x, threshold_crossing.y};
-                                    },
-                                    [&](exposure_measurement event) {
-                                        delta_ts[event.x + event.y * header.width] = event.delta_t;
-                                    }))));
                     break;
                 }
                 case sepia::type::color:
@@ -0,0 +1,143 @@
+#include "../third_party/pontella/source/pontella.hpp"
+#include "../third_party/sepia/source/sepia.hpp"
+#include "npy.hpp"
+
+/// buffer_size is the number of bytes accumulated per output before writing.
+constexpr std::size_t buffer_size = 1 << 22;
+
+/// event_fields returns the NumPy fields of an event type.
+inline std::vector<npy::field> event_fields(sepia::type event_stream_type) {
+    switch (event_stream_type) {
+        case sepia::type::generic:
+            break;
+        case sepia::type::dvs:
+            return {
+                npy::make_field<uint64_t>("t"),
+                npy::make_field<uint16_t>("x"),
+                npy::make_field<uint16_t>("y"),
+                npy::make_field<bool>("is_increase"),
+            };
+        case sepia::type::atis:
+            return {
+                npy::make_field<uint64_t>("t"),
+                npy::make_field<uint16_t>("x"),
+                npy::make_field<uint16_t>("y"),
+                npy::make_field<bool>("is_threshold_crossing"),
+                npy::make_field<bool>("polarity"),
+            };
+        case sepia::type::color:
+            return {
+                npy::make_field<uint64_t>("t"),
+                npy::make_field<uint16_t>("x"),
+                npy::make_field<uint16_t>("y"),
+                npy::make_field<uint8_t>("r"),
+                npy::make_field<uint8_t>("g"),
+                npy::make_field<uint8_t>("b"),
+            };
+    }
+    throw std::runtime_error("Unsupported event type: generic");
+}
+
+/// append_event copies the fields of an event to their buffers.
+/// In structured mode, buffers has a single element which receives every field.
+inline void append_event(std::vector<std::vector<uint8_t>>& buffers, const sepia::dvs_event& dvs_event) {
+    const auto structured = buffers.size() == 1;
+    npy::append(buffers[0], dvs_event.t);
+    npy::append(buffers[structured ? 0 : 1], dvs_event.x);
+    npy::append(buffers[structured ? 0 : 2], dvs_event.y);
+    npy::append(buffers[structured ? 0 : 3], static_cast<uint8_t>(dvs_event.is_increase ? 1 : 0));
+}
+inline void append_event(std::vector<std::vector<uint8_t>>& buffers, const sepia::atis_event& atis_event) {
+    const auto structured = buffers.size() == 1;
+    npy::append(buffers[0], atis_event.t);
+    npy::append(buffers[structured ? 0 : 1], atis_event.x);
+    npy::append(buffers[structured ? 0 : 2], atis_event.y);
+    npy::append(buffers[structured ? 0 : 3], static_cast<uint8_t>(atis_event.is_threshold_crossing ? 1 : 0));
+    npy::append(buffers[structured ? 0 : 4], static_cast<uint8_t>(atis_event.polarity ? 1 : 0));
+}
+inline void append_event(std::vector<std::vector<uint8_t>>& buffers, const sepia::color_event& color_event) {
+    const auto structured = buffers.size() == 1;
+    npy::append(buffers[0], color_event.t);
+    npy::append(buffers[structured ? 0 : 1], color_event.x);
+    npy::append(buffers[structured ? 0 : 2], color_event.y);
+    npy::append(buffers[structured ? 0 : 3], color_event.r);
+    npy::append(buffers[structured ? 0 : 4], color_event.g);
+    npy::append(buffers[structured ? 0 : 5], color_event.b);
+}
+
+/// es_to_npy writes the events of an Event Stream to one npy file per field, or to a single structured npy file.
+/// The npy headers are rewritten once the number of events is known, hence the input is read only once.
+template <sepia::type event_stream_type>
+void es_to_npy(std::unique_ptr<std::istream> input, const std::string& output, bool structured) {
+    const auto fields = event_fields(event_stream_type);
+    std::vector<std::unique_ptr<npy::writer>> writers;
+    if (structured) {
+        writers.push_back(sepia::make_unique<npy::writer>(output, fields, true));
+    } else {
+        auto prefix = output;
+        if (prefix.size() > 4 && prefix.compare(prefix.size() - 4, 4, ".npy") == 0) {
+            prefix.resize(prefix.size() - 4);
+        }
+        for (const auto& event_field : fields) {
+            writers.push_back(sepia::make_unique<npy::writer>(
+                prefix + "_" + event_field.name + ".npy", std::vector<npy::field>{event_field}, false));
+        }
+    }
+    std::vector<std::vector<uint8_t>> buffers(writers.size());
+    for (auto& buffer : buffers) {
+        buffer.reserve(buffer_size + 64);
+    }
+    const auto flush = [&]() {
+        for (std::size_t index = 0; index < buffers.size(); ++index) {
+            writers[index]->write(buffers[index]);
+            buffers[index].clear();
+        }
+    };
+    sepia::join_observable<event_stream_type>(std::move(input), [&](sepia::event<event_stream_type> event) {
+        append_event(buffers, event);
+        if (buffers.front().size() >= buffer_size) {
+            flush();
+        }
+    });
+    flush();
+    for (auto& writer : writers) {
+        writer->close();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {"es_to_npy converts an Event Stream file into NumPy arrays",
+         "    Each field is written to its own file by default, named after the output prefix",
+         "    (for example, /path/to/output_t.npy, /path/to/output_x.npy...)",
+         "Syntax: ./es_to_npy [options] /path/to/input.es /path/to/output",
+         "Available options:",
+         "    -s, --structured    writes a single structured array to /path/to/output instead",
+         "    -h, --help          shows this help message"},
+        argc,
+        argv,
+        2,
+        {},
+        {{"structured", {"s"}}},
+        [](pontella::command command) {
+            if (command.arguments[0] == command.arguments[1]) {
+                throw std::runtime_error("The Event Stream input and the npy output must be different files");
+            }
+            const auto header = sepia::read_header(sepia::filename_to_ifstream(command.arguments[0]));
+            const auto structured = command.flags.find("structured") != command.flags.end();
+            auto input = sepia::filename_to_ifstream(command.arguments[0]);
+            switch (header.event_stream_type) {
+                case sepia::type::generic:
+                    throw std::runtime_error("Unsupported event type: generic");
+                case sepia::type::dvs:
+                    es_to_npy<sepia::type::dvs>(std::move(input), command.arguments[1], structured);
+                    break;
+                case sepia::type::atis:
+                    es_to_npy<sepia::type::atis>(std::move(input), command.arguments[1], structured);
+                    break;
+                case sepia::type::color:
+                    es_to_npy<sepia::type::color>(std::move(input), command.arguments[1], structured);
+                    break;
+            }
+        });
+}
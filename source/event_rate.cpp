@@ -1,5 +1,6 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
 #include <deque>
 
@@ -58,7 +59,7 @@ std::pair<uint64_t, uint64_t> t_range(const sepia::header& header, std::unique_p
 /// compute_event_rate calculates the event rate.
 template <sepia::type event_stream_type, typename HandleEventRate>
 void typed_compute_event_rate(
-    std::unique_ptr<std::istream> stream,
+    const std::string& filename,
     uint64_t begin_t,
     uint64_t end_t,
     uint64_t tau,
@@ -67,7 +68,7 @@ void typed_compute_event_rate(
     std::deque<uint64_t> ts;
     uint64_t previous_t = 0;
     auto first_t = std::numeric_limits<uint64_t>::max();
-    sepia::join_observable<event_stream_type>(std::move(stream), [&](sepia::event<event_stream_type> event) {
+    time_index::join_observable<event_stream_type>(filename, begin_t, [&](sepia::event<event_stream_type> event) {
         if (event.t < begin_t) {
             return;
         }
@@ -103,7 +104,7 @@ void typed_compute_event_rate(
 template <typename HandleEventRate>
 void compute_event_rate(
     const sepia::header& header,
-    std::unique_ptr<std::istream> stream,
+    const std::string& filename,
     uint64_t begin_t,
     uint64_t end_t,
     uint64_t tau,
@@ -111,22 +112,22 @@ void compute_event_rate(
     switch (header.event_stream_type) {
         case sepia::type::generic: {
             typed_compute_event_rate<sepia::type::generic>(
-                std::move(stream), begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
+                filename, begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
             break;
         }
         case sepia::type::dvs: {
             typed_compute_event_rate<sepia::type::dvs>(
-                std::move(stream), begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
+                filename, begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
             break;
         }
         case sepia::type::atis: {
             typed_compute_event_rate<sepia::type::atis>(
-                std::move(stream), begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
+                filename, begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
             break;
         }
         case sepia::type::color: {
             typed_compute_event_rate<sepia::type::color>(
-                std::move(stream), begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
+                filename, begin_t, end_t, tau, std::forward<HandleEventRate>(handle_event_rate));
             break;
         }
     }
@@ -339,7 +340,7 @@ int main(int argc, char* argv[]) {
                     static_cast<double>(first_and_last_t.second - first_and_last_t.first) / (width - 1 - x_offset)));
                 compute_event_rate(
                     header,
-                    sepia::filename_to_ifstream(command.arguments[0]),
+                    command.arguments[0],
                     begin_t,
                     end_t,
                     tau,
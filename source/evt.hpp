@@ -1,10 +1,18 @@
 #pragma once
 
 #include "../third_party/sepia/source/sepia.hpp"
+#include "mapped_file.hpp"
 #include <algorithm>
+#include <array>
+#include <deque>
+#include <future>
 #include <iostream>
 #include <limits>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace evt {
     /// header bundles a .dat file header's information.
     struct header {
@@ -77,204 +85,694 @@ namespace evt {
         return default_header;
     }
 
-    /// observable dispatches DVS events from a stream.
+    /// state_2 holds the EVT2 decoder's state between two buffers.
+    struct state_2 {
+        uint64_t offset;
+        uint64_t t_without_offset;
+        uint64_t reference_t;
+        uint64_t first_t;
+        uint64_t previous_t;
+
+        state_2(bool normalize) :
+            offset(0),
+            t_without_offset(0),
+            reference_t(0),
+            first_t(normalize ? std::numeric_limits<uint64_t>::max() : 0),
+            previous_t(0) {}
+    };
+
+    /// load_2 reads a little-endian EVT2 word.
+    inline uint32_t load_2(const uint8_t* bytes) {
+        return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8)
+               | (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    /// dispatch_2 normalizes and clamps the timestamp of a CD word, and dispatches the resulting event.
+    /// t is the word's absolute timestamp (reference plus the word's low bits).
+    template <typename HandleEvent>
+    inline void dispatch_2(
+        uint64_t t,
+        uint16_t x,
+        uint16_t y,
+        bool is_increase,
+        header stream_header,
+        state_2& state,
+        HandleEvent& handle_event) {
+        sepia::dvs_event event = {};
+        event.t = t;
+        if (state.first_t == std::numeric_limits<uint64_t>::max()) {
+            state.first_t = event.t;
+        }
+        event.t -= state.first_t;
+        if (event.t < state.previous_t) {
+            event.t = state.previous_t;
+        } else {
+            state.previous_t = event.t;
+        }
+        event.x = x;
+        event.y = y;
+        event.is_increase = is_increase;
+        if (event.x < stream_header.width && event.y < stream_header.height) {
+            event.y = stream_header.height - 1 - event.y;
+            handle_event(event);
+        } else {
+            std::cerr << "out of bounds event (t=" << event.t << ", x=" << event.x << ", y=" << event.y
+                      << ", on=" << (event.is_increase ? "true" : "false") << ")" << std::endl;
+        }
+    }
+
+    /// handle_time_high_2 updates the reference timestamp with an EVT_TIME_HIGH word.
+    inline void handle_time_high_2(uint32_t time_high, state_2& state) {
+        const auto new_t_without_offset = time_high << 6;
+        if (new_t_without_offset < state.t_without_offset) {
+            state.offset += (1ull << 34);
+        }
+        state.t_without_offset = new_t_without_offset;
+        state.reference_t = state.t_without_offset + state.offset;
+    }
+
+    /// decode_word_2 applies an EVT2 word of any type.
+    template <typename HandleCd>
+    inline void decode_word_2(uint32_t word, state_2& state, HandleCd& handle_cd) {
+        switch (word >> 28) {
+            case 0b0000:   // CD_OFF
+            case 0b0001: { // CD_ON
+                handle_cd(
+                    state.reference_t + ((word >> 22) & 0b111111),
+                    static_cast<uint16_t>((word >> 11) & 0b11111111111),
+                    static_cast<uint16_t>(word & 0b11111111111),
+                    (word >> 28) == 0b0001);
+                break;
+            }
+            case 0b1000: // EVT_TIME_HIGH
+                handle_time_high_2(word & 0b1111111111111111111111111111, state);
+                break;
+            case 0b1010: // EXT_TRIGGER
+                break;
+            case 0b1110: // OTHERS
+                break;
+            case 0b1111: // CONTINUED
+                break;
+        }
+    }
+
+    /// decode_words_2 calls handle_cd with the absolute timestamp, x, y and polarity of each CD word in a buffer.
+    /// Words are decoded one at a time: classifying blocks of words first (with or without vector instructions)
+    /// was measured slower, since the per-event normalization and writing dominate.
+    /// Trailing bytes that do not form a complete word are ignored.
+    template <typename HandleCd>
+    inline void decode_words_2(const uint8_t* bytes, std::size_t size, state_2& state, HandleCd& handle_cd) {
+        for (std::size_t index = 0; index < (size / 4) * 4; index += 4) {
+            decode_word_2(load_2(bytes + index), state, handle_cd);
+        }
+    }
+
+    /// decode_2 dispatches the DVS events encoded in a buffer of EVT2 words.
+    template <typename HandleEvent>
+    inline void decode_2(
+        const uint8_t* bytes,
+        std::size_t size,
+        header stream_header,
+        state_2& state,
+        HandleEvent& handle_event) {
+        auto handle_cd = [&](uint64_t t, uint16_t x, uint16_t y, bool is_increase) {
+            dispatch_2(t, x, y, is_increase, stream_header, state, handle_event);
+        };
+        decode_words_2(bytes, size, state, handle_cd);
+    }
+
+    /// observable_2 dispatches DVS events from a stream.
     /// The header must be read from the stream before calling this function.
     template <typename HandleEvent>
     inline void observable_2(std::istream& stream, header stream_header, bool normalize, HandleEvent handle_event) {
-        uint64_t offset = 0;
-        uint64_t t_without_offset = 0;
-        uint64_t reference_t = 0;
-        uint64_t first_t = normalize ? std::numeric_limits<uint64_t>::max() : 0;
-        uint64_t previous_t = 0;
+        state_2 state(normalize);
         std::vector<uint8_t> bytes(1 << 16);
         for (;;) {
             stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-            for (std::size_t index = 0; index < (stream.gcount() / 4) * 4; index += 4) {
-                switch (bytes[index + 3] >> 4) {
-                    case 0b0000:   // CD_OFF
-                    case 0b0001: { // CD_ON
-                        sepia::dvs_event event = {};
-                        event.t = reference_t
-                                  + ((static_cast<uint64_t>(bytes[index + 2]) >> 6)
-                                     | (static_cast<uint64_t>(bytes[index + 3] & 0b1111) << 2));
-                        if (first_t == std::numeric_limits<uint64_t>::max()) {
-                            first_t = event.t;
-                        }
-                        event.t -= first_t;
-                        if (event.t < previous_t) {
-                            event.t = previous_t;
-                        } else {
-                            previous_t = event.t;
-                        }
-                        event.x = static_cast<uint16_t>(bytes[index + 1] >> 3)
-                                  | (static_cast<uint16_t>(bytes[index + 2] & 0b111111) << 5);
-                        event.y = static_cast<uint16_t>(bytes[index])
-                                  | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8);
-                        event.is_increase = (bytes[index + 3] >> 4) == 0b0001;
-                        if (event.x < stream_header.width && event.y < stream_header.height) {
-                            event.y = stream_header.height - 1 - event.y;
-                            handle_event(event);
-                        } else {
-                            std::cerr << "out of bounds event (t=" << event.t << ", x=" << event.x << ", y=" << event.y
-                                      << ", on=" << (event.is_increase ? "true" : "false") << ")" << std::endl;
-                        }
-                        break;
+            decode_2(bytes.data(), static_cast<std::size_t>(stream.gcount()), stream_header, state, handle_event);
+            if (stream.eof()) {
+                break;
+            }
+        }
+    }
+
+    /// observable_2 dispatches DVS events from a memory-mapped file.
+    /// begin must point to the first byte after the header.
+    template <typename HandleEvent>
+    inline void observable_2(
+        const mapped_file& file,
+        std::size_t begin,
+        header stream_header,
+        bool normalize,
+        HandleEvent handle_event) {
+        state_2 state(normalize);
+        file.read(begin, file.size(), [&](const uint8_t* bytes, std::size_t size) {
+            decode_2(bytes, size, stream_header, state, handle_event);
+        });
+    }
+
+    /// cd_2 is a CD word decoded by a worker thread, before normalization and clamping.
+    struct cd_2 {
+        uint64_t t;
+        uint16_t x;
+        uint16_t y;
+        bool is_increase;
+    };
+
+    /// chunk_2 holds the result of decoding a part of an EVT2 file independently from the rest.
+    /// Every chunk but the first begins with an EVT_TIME_HIGH word, hence its timestamps are known
+    /// up to the overflow offset accumulated by the previous chunks.
+    struct chunk_2 {
+        std::vector<cd_2> cds;
+        bool has_time_high;
+        uint32_t first_t_without_offset;
+        state_2 state;
+
+        chunk_2() : has_time_high(false), first_t_without_offset(0), state(false) {}
+    };
+
+    /// chunk_size_2 is the nominal number of bytes decoded by a worker thread.
+    constexpr std::size_t chunk_size_2 = 1 << 20;
+
+    /// find_time_high_2 returns the offset of the first EVT_TIME_HIGH word in [begin, end), or end.
+    /// begin and end must be aligned on words.
+    inline std::size_t find_time_high_2(const uint8_t* bytes, std::size_t begin, std::size_t end) {
+        for (; begin < end; begin += 4) {
+            if ((bytes[begin + 3] >> 4) == 0b1000) {
+                return begin;
+            }
+        }
+        return end;
+    }
+
+    /// decode_chunk_2 decodes the words in [begin, end) with a fresh state.
+    inline chunk_2 decode_chunk_2(const uint8_t* bytes, std::size_t begin, std::size_t end) {
+        chunk_2 chunk;
+        if (begin < end && (bytes[begin + 3] >> 4) == 0b1000) {
+            chunk.has_time_high = true;
+            chunk.first_t_without_offset =
+                (static_cast<uint32_t>(bytes[begin]) | (static_cast<uint32_t>(bytes[begin + 1]) << 8)
+                 | (static_cast<uint32_t>(bytes[begin + 2]) << 16)
+                 | (static_cast<uint32_t>(bytes[begin + 3] & 0b1111) << 24))
+                << 6;
+        }
+        chunk.cds.reserve((end - begin) / 4);
+        auto handle_cd = [&](uint64_t t, uint16_t x, uint16_t y, bool is_increase) {
+            chunk.cds.push_back({t, x, y, is_increase});
+        };
+        decode_words_2(bytes + begin, end - begin, chunk.state, handle_cd);
+        return chunk;
+    }
+
+    /// parallel_observable_2 dispatches DVS events from a memory-mapped file, using several threads.
+    /// The file is cut into chunks that begin with an EVT_TIME_HIGH word, since such a word resets the
+    /// reference timestamp. Chunks are decoded concurrently, then stitched in order on the calling thread:
+    /// the overflow offset is carried from one chunk to the next, and the normalization and monotonic
+    /// clamping are applied sequentially. The dispatched events are identical to those of observable_2.
+    /// begin must point to the first byte after the header.
+    template <typename HandleEvent>
+    inline void parallel_observable_2(
+        const mapped_file& file,
+        std::size_t begin,
+        header stream_header,
+        bool normalize,
+        std::size_t threads,
+        HandleEvent handle_event) {
+        if (threads < 2) {
+            observable_2(file, begin, stream_header, normalize, std::move(handle_event));
+            return;
+        }
+        const auto bytes = file.data();
+        const auto end = begin + ((file.size() - begin) / 4) * 4;
+        std::deque<std::future<chunk_2>> chunks;
+        auto nominal_begin = begin;
+        const auto launch = [&]() {
+            const auto nominal_end = std::min(end, nominal_begin + chunk_size_2);
+            chunks.push_back(std::async(std::launch::async, [=]() {
+                const auto chunk_begin = nominal_begin == begin ? begin : find_time_high_2(bytes, nominal_begin, end);
+                const auto chunk_end = find_time_high_2(bytes, nominal_end, end);
+                return decode_chunk_2(bytes, chunk_begin, std::max(chunk_begin, chunk_end));
+            }));
+            nominal_begin = nominal_end;
+        };
+        state_2 state(normalize);
+        for (std::size_t index = 0;; ++index) {
+            while (nominal_begin < end && chunks.size() < threads * 2) {
+                launch();
+            }
+            if (chunks.empty()) {
+                break;
+            }
+            const auto chunk = chunks.front().get();
+            chunks.pop_front();
+            if (index == 0 || chunk.has_time_high) {
+                if (index > 0 && chunk.first_t_without_offset < state.t_without_offset) {
+                    state.offset += (1ull << 34);
+                }
+                for (const auto& cd : chunk.cds) {
+                    dispatch_2(cd.t + state.offset, cd.x, cd.y, cd.is_increase, stream_header, state, handle_event);
+                }
+                state.offset += chunk.state.offset;
+                state.t_without_offset = chunk.state.t_without_offset;
+            }
+        }
+    }
+
+    /// state_3 holds the EVT3 decoder's state between two buffers.
+    struct state_3 {
+        uint32_t previous_msb_t;
+        uint32_t previous_lsb_t;
+        uint32_t overflows;
+        uint64_t first_t;
+        sepia::dvs_event event;
+
+        state_3(bool normalize) :
+            previous_msb_t(0),
+            previous_lsb_t(0),
+            overflows(0),
+            first_t(normalize ? std::numeric_limits<uint64_t>::max() : 0),
+            event() {}
+    };
+
+    /// trailing_zeros returns the number of trailing zero bits in a non-zero mask.
+    inline uint32_t trailing_zeros(uint32_t mask) {
+#if defined(__GNUC__)
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#elif defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return static_cast<uint32_t>(index);
+#else
+        uint32_t index = 0;
+        for (; (mask & 1) == 0; mask >>= 1) {
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    /// handle_vector_3 dispatches the events encoded in a VECT_12 or VECT_8 mask, and moves the base x forward.
+    /// The set bits are expanded into a batch of x coordinates with trailing_zeros, and the bounds are
+    /// checked once per word by clipping the mask to the sensor width.
+    template <typename HandleEvent>
+    inline void handle_vector_3(
+        uint32_t mask,
+        uint16_t bits,
+        header stream_header,
+        state_3& state,
+        HandleEvent& handle_event) {
+        const auto base_x = state.event.x;
+        if (base_x + bits > std::numeric_limits<uint16_t>::max() + 1) {
+            // x wraps around within this word (only possible after thousands of vectors without a base),
+            // the bit-by-bit loop reproduces the wrapping
+            for (uint16_t bit = 0; bit < bits; ++bit) {
+                if (((mask >> bit) & 1) == 1 && state.event.x < stream_header.width
+                    && state.event.y < stream_header.height) {
+                    handle_event(state.event);
+                }
+                ++state.event.x;
+            }
+            return;
+        }
+        if (mask != 0 && base_x < stream_header.width && state.event.y < stream_header.height) {
+            if (stream_header.width - base_x < bits) {
+                mask &= (1u << (stream_header.width - base_x)) - 1;
+            }
+            std::array<uint16_t, 12> xs;
+            std::size_t size = 0;
+            for (; mask != 0; mask &= mask - 1) {
+                xs[size] = static_cast<uint16_t>(base_x + trailing_zeros(mask));
+                ++size;
+            }
+            for (std::size_t index = 0; index < size; ++index) {
+                state.event.x = xs[index];
+                handle_event(state.event);
+            }
+        }
+        state.event.x = static_cast<uint16_t>(base_x + bits);
+    }
+
+    /// update_t_3 normalizes a timestamp computed from EVT_TIME_HIGH and EVT_TIME_LOW words,
+    /// and moves the current timestamp forward if it is not smaller.
+    inline void update_t_3(uint64_t t, state_3& state) {
+        if (state.first_t == std::numeric_limits<uint64_t>::max()) {
+            state.first_t = t;
+        }
+        t -= state.first_t;
+        if (t >= state.event.t) {
+            state.event.t = t;
+        }
+    }
+
+    /// decode_words_3 walks a buffer of EVT3 words.
+    /// handle_t is called with the raw timestamp (overflows included) whenever it changes,
+    /// handle_unchecked_event with every EVT_ADDR_X event (without bounds check),
+    /// and handle_event with every in-bounds vector event.
+    /// Trailing bytes that do not form a complete word are ignored.
+    template <typename HandleT, typename HandleUncheckedEvent, typename HandleEvent>
+    inline void decode_words_3(
+        const uint8_t* bytes,
+        std::size_t size,
+        header stream_header,
+        state_3& state,
+        HandleT& handle_t,
+        HandleUncheckedEvent& handle_unchecked_event,
+        HandleEvent& handle_event) {
+        for (std::size_t index = 0; index < (size / 2) * 2; index += 2) {
+            switch (bytes[index + 1] >> 4) {
+                case 0b0000: // EVT_ADDR_Y
+                    state.event.y = static_cast<uint16_t>(
+                        stream_header.height - 1
+                        - (bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8)));
+                    break;
+                case 0b0001:
+                    break;
+                case 0b0010: // EVT_ADDR_X
+                    state.event.x = static_cast<uint16_t>(
+                        bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8));
+                    state.event.is_increase = ((bytes[index + 1] >> 3) & 1) == 1;
+                    handle_unchecked_event(state.event);
+                    break;
+                case 0b0011: // VECT_BASE_X
+                    state.event.x = static_cast<uint16_t>(
+                        bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8));
+                    state.event.is_increase = ((bytes[index + 1] >> 3) & 1) == 1;
+                    break;
+                case 0b0100: // VECT_12
+                    handle_vector_3(
+                        static_cast<uint32_t>(bytes[index]) | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8),
+                        12,
+                        stream_header,
+                        state,
+                        handle_event);
+                    break;
+                case 0b0101: // VECT_8
+                    handle_vector_3(static_cast<uint32_t>(bytes[index]), 8, stream_header, state, handle_event);
+                    break;
+                case 0b0110: { // EVT_TIME_LOW
+                    const auto lsb_t = static_cast<uint32_t>(
+                        bytes[index] | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8));
+                    if (lsb_t != state.previous_lsb_t) {
+                        state.previous_lsb_t = lsb_t;
+                        handle_t(
+                            static_cast<uint64_t>(state.previous_lsb_t | (state.previous_msb_t << 12))
+                            + (static_cast<uint64_t>(state.overflows) << 24));
                     }
-                    case 0b1000: { // EVT_TIME_HIGH
-                        const auto new_t_without_offset =
-                            ((static_cast<uint32_t>(bytes[index]) | (static_cast<uint32_t>(bytes[index + 1]) << 8)
-                              | (static_cast<uint32_t>(bytes[index + 2]) << 16)
-                              | (static_cast<uint32_t>(bytes[index + 3] & 0b1111) << 24)))
-                            << 6;
-                        if (new_t_without_offset < t_without_offset) {
-                            offset += (1ull << 34);
+                    break;
+                }
+                case 0b0111:
+                    break;
+                case 0b1000: { // EVT_TIME_HIGH
+                    const auto msb_t = static_cast<uint32_t>(
+                        bytes[index] | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8));
+                    if (msb_t != state.previous_msb_t) {
+                        if (msb_t > state.previous_msb_t) {
+                            if (msb_t - state.previous_msb_t < static_cast<uint32_t>((1 << 12) - 2)) {
+                                state.previous_lsb_t = 0;
+                                state.previous_msb_t = msb_t;
+                            }
+                        } else {
+                            if (state.previous_msb_t - msb_t > static_cast<uint32_t>((1 << 12) - 2)) {
+                                ++state.overflows;
+                                state.previous_lsb_t = 0;
+                                state.previous_msb_t = msb_t;
+                            }
                         }
-                        t_without_offset = new_t_without_offset;
-                        reference_t = t_without_offset + offset;
-                        break;
+                        handle_t(
+                            static_cast<uint64_t>(state.previous_lsb_t | (state.previous_msb_t << 12))
+                            + (static_cast<uint64_t>(state.overflows) << 24));
                     }
-                    case 0b1010: // EXT_TRIGGER
-                        break;
-                    case 0b1110: // OTHERS
-                        break;
-                    case 0b1111: // CONTINUED
-                        break;
                 }
-            }
-            if (stream.eof()) {
-                break;
+                case 0b1001:
+                    break;
+                case 0b1010: // EXT_TRIGGER
+                    break;
+                case 0b1011:
+                case 0b1100:
+                case 0b1101:
+                case 0b1110:
+                case 0b1111:
+                    break;
+                default:
+                    break;
             }
         }
     }
 
-    /// observable dispatches DVS events from a stream.
+    /// decode_3 dispatches the DVS events encoded in a buffer of EVT3 words.
+    /// Trailing bytes that do not form a complete word are ignored.
+    template <typename HandleEvent>
+    inline void decode_3(
+        const uint8_t* bytes,
+        std::size_t size,
+        header stream_header,
+        state_3& state,
+        HandleEvent& handle_event) {
+        auto handle_t = [&](uint64_t t) {
+            update_t_3(t, state);
+        };
+        auto handle_unchecked_event = [&](const sepia::dvs_event& event) {
+            if (event.x < stream_header.width && event.y < stream_header.height) {
+                handle_event(event);
+            } else {
+                std::cerr << "out of bounds event (t=" << event.t << ", x=" << event.x << ", y=" << event.y
+                          << ", on=" << (event.is_increase ? "true" : "false") << ")" << std::endl;
+            }
+        };
+        decode_words_3(bytes, size, stream_header, state, handle_t, handle_unchecked_event, handle_event);
+    }
+
+    /// observable_3 dispatches DVS events from a stream.
     /// The header must be read from the stream before calling this function.
     template <typename HandleEvent>
     inline void observable_3(std::istream& stream, header stream_header, bool normalize, HandleEvent handle_event) {
-        uint32_t previous_msb_t = 0;
-        uint32_t previous_lsb_t = 0;
-        uint32_t overflows = 0;
-        uint64_t first_t = normalize ? std::numeric_limits<uint64_t>::max() : 0;
-        sepia::dvs_event event = {};
+        state_3 state(normalize);
         std::vector<uint8_t> bytes(1 << 16);
         for (;;) {
             stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-            for (std::size_t index = 0; index < (stream.gcount() / 2) * 2; index += 2) {
-                switch (bytes[index + 1] >> 4) {
+            decode_3(bytes.data(), static_cast<std::size_t>(stream.gcount()), stream_header, state, handle_event);
+            if (stream.eof()) {
+                break;
+            }
+        }
+    }
+
+    /// observable_3 dispatches DVS events from a memory-mapped file.
+    /// begin must point to the first byte after the header.
+    template <typename HandleEvent>
+    inline void observable_3(
+        const mapped_file& file,
+        std::size_t begin,
+        header stream_header,
+        bool normalize,
+        HandleEvent handle_event) {
+        state_3 state(normalize);
+        file.read(begin, file.size(), [&](const uint8_t* bytes, std::size_t size) {
+            decode_3(bytes, size, stream_header, state, handle_event);
+        });
+    }
+
+    /// operation_3 is a timestamp update or an event decoded by a worker thread.
+    /// Timestamps are raw (before normalization and clamping), and overflows are counted from the chunk's beginning.
+    struct operation_3 {
+        enum class type : uint8_t {
+            t,
+            off,
+            on,
+        };
+        uint64_t t;
+        uint16_t x;
+        uint16_t y;
+        type kind;
+    };
+
+    /// chunk_3 holds the result of decoding a part of an EVT3 file independently from the rest.
+    /// Every chunk but the first begins with an EVT_TIME_HIGH word, and is decoded under the assumption
+    /// that this word is accepted by the carried state. A chunk whose events depend on the y or base x
+    /// of the previous chunk (an event before the first EVT_ADDR_Y, or a vector before the first base x)
+    /// cannot be decoded speculatively, sequential is then true and the chunk is decoded again on the calling thread.
+    struct chunk_3 {
+        std::size_t begin;
+        std::size_t end;
+        bool sequential;
+        bool defines_x;
+        bool defines_y;
+        uint32_t first_msb_t;
+        std::vector<operation_3> operations;
+        state_3 state;
+
+        chunk_3(std::size_t chunk_begin, std::size_t chunk_end) :
+            begin(chunk_begin),
+            end(chunk_end),
+            sequential(false),
+            defines_x(false),
+            defines_y(false),
+            first_msb_t(0),
+            state(false) {}
+    };
+
+    /// chunk_size_3 is the nominal number of bytes decoded by a worker thread.
+    constexpr std::size_t chunk_size_3 = 1 << 20;
+
+    /// find_time_high_3 returns the offset of the first EVT_TIME_HIGH word in [begin, end), or end.
+    /// begin and end must be aligned on words.
+    inline std::size_t find_time_high_3(const uint8_t* bytes, std::size_t begin, std::size_t end) {
+        for (; begin < end; begin += 2) {
+            if ((bytes[begin + 1] >> 4) == 0b1000) {
+                return begin;
+            }
+        }
+        return end;
+    }
+
+    /// decode_chunk_3 decodes the words in [begin, end).
+    /// The first chunk is decoded with the initial state, the others with a state derived from their first word.
+    inline chunk_3 decode_chunk_3(
+        const uint8_t* bytes,
+        std::size_t begin,
+        std::size_t end,
+        bool first,
+        header stream_header) {
+        chunk_3 chunk(begin, end);
+        auto index = begin;
+        if (first) {
+            chunk.defines_x = true;
+            chunk.defines_y = true;
+        } else if (begin < end) {
+            for (auto word = begin + 2; word < end && !(chunk.defines_x && chunk.defines_y); word += 2) {
+                switch (bytes[word + 1] >> 4) {
                     case 0b0000: // EVT_ADDR_Y
-                        event.y = static_cast<uint16_t>(
-                            stream_header.height - 1
-                            - (bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8)));
-                        break;
-                    case 0b0001:
+                        chunk.defines_y = true;
                         break;
                     case 0b0010: // EVT_ADDR_X
-                        event.x = static_cast<uint16_t>(
-                            bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8));
-                        event.is_increase = ((bytes[index + 1] >> 3) & 1) == 1;
-                        if (event.x < stream_header.width && event.y < stream_header.height) {
-                            handle_event(event);
-                        } else {
-                            std::cerr << "out of bounds event (t=" << event.t << ", x=" << event.x << ", y=" << event.y
-                                      << ", on=" << (event.is_increase ? "true" : "false") << ")" << std::endl;
+                        if (!chunk.defines_y) {
+                            chunk.sequential = true;
+                            return chunk;
                         }
+                        chunk.defines_x = true;
                         break;
                     case 0b0011: // VECT_BASE_X
-                        event.x = static_cast<uint16_t>(
-                            bytes[index] | (static_cast<uint16_t>(bytes[index + 1] & 0b111) << 8));
-                        event.is_increase = ((bytes[index + 1] >> 3) & 1) == 1;
+                        chunk.defines_x = true;
                         break;
                     case 0b0100: // VECT_12
-                        for (uint8_t bit = 0; bit < 8; ++bit) {
-                            if (((bytes[index] >> bit) & 1) == 1) {
-                                if (event.x < stream_header.width && event.y < stream_header.height) {
-                                    handle_event(event);
-                                }
-                            }
-                            ++event.x;
-                        }
-                        for (uint8_t bit = 0; bit < 4; ++bit) {
-                            if (((bytes[index + 1] >> bit) & 1) == 1) {
-                                if (event.x < stream_header.width && event.y < stream_header.height) {
-                                    handle_event(event);
-                                }
-                            }
-                            ++event.x;
-                        }
-                        break;
                     case 0b0101: // VECT_8
-                        for (uint8_t bit = 0; bit < 8; ++bit) {
-                            if (((bytes[index] >> bit) & 1) == 1) {
-                                if (event.x < stream_header.width && event.y < stream_header.height) {
-                                    handle_event(event);
-                                }
-                            }
-                            ++event.x;
-                        }
-                        break;
-                    case 0b0110: { // EVT_TIME_LOW
-                        const auto lsb_t = static_cast<uint32_t>(
-                            bytes[index] | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8));
-                        if (lsb_t != previous_lsb_t) {
-                            previous_lsb_t = lsb_t;
-                            auto t = static_cast<uint64_t>(previous_lsb_t | (previous_msb_t << 12))
-                                     + (static_cast<uint64_t>(overflows) << 24);
-                            if (first_t == std::numeric_limits<uint64_t>::max()) {
-                                first_t = t;
-                            }
-                            t -= first_t;
-                            if (t >= event.t) {
-                                event.t = t;
-                            }
-                        }
-                        break;
-                    }
-                    case 0b0111:
-                        break;
-                    case 0b1000: { // EVT_TIME_HIGH
-                        const auto msb_t = static_cast<uint32_t>(
-                            bytes[index] | (static_cast<uint32_t>(bytes[index + 1] & 0b1111) << 8));
-                        if (msb_t != previous_msb_t) {
-                            if (msb_t > previous_msb_t) {
-                                if (msb_t - previous_msb_t < static_cast<uint32_t>((1 << 12) - 2)) {
-                                    previous_lsb_t = 0;
-                                    previous_msb_t = msb_t;
-                                }
-                            } else {
-                                if (previous_msb_t - msb_t > static_cast<uint32_t>((1 << 12) - 2)) {
-                                    ++overflows;
-                                    previous_lsb_t = 0;
-                                    previous_msb_t = msb_t;
-                                }
-                            }
-                            auto t = static_cast<uint64_t>(previous_lsb_t | (previous_msb_t << 12))
-                                     + (static_cast<uint64_t>(overflows) << 24);
-                            if (first_t == std::numeric_limits<uint64_t>::max()) {
-                                first_t = t;
-                            }
-                            t -= first_t;
-                            if (t >= event.t) {
-                                event.t = t;
-                            }
+                        if (!chunk.defines_x || !chunk.defines_y) {
+                            chunk.sequential = true;
+                            return chunk;
                         }
-                    }
-                    case 0b1001:
-                        break;
-                    case 0b1010: // EXT_TRIGGER
-                        break;
-                    case 0b1011:
-                    case 0b1100:
-                    case 0b1101:
-                    case 0b1110:
-                    case 0b1111:
                         break;
                     default:
                         break;
                 }
             }
-            if (stream.eof()) {
+            chunk.first_msb_t =
+                static_cast<uint32_t>(bytes[begin] | (static_cast<uint32_t>(bytes[begin + 1] & 0b1111) << 8));
+            chunk.state.previous_msb_t = chunk.first_msb_t;
+            chunk.operations.push_back(
+                {static_cast<uint64_t>(chunk.first_msb_t << 12), 0, 0, operation_3::type::t});
+            index += 2;
+        }
+        chunk.operations.reserve((end - begin) / 2);
+        auto handle_t = [&](uint64_t t) {
+            chunk.operations.push_back({t, 0, 0, operation_3::type::t});
+        };
+        auto handle_event = [&](const sepia::dvs_event& event) {
+            chunk.operations.push_back(
+                {0, event.x, event.y, event.is_increase ? operation_3::type::on : operation_3::type::off});
+        };
+        decode_words_3(bytes + index, end - index, stream_header, chunk.state, handle_t, handle_event, handle_event);
+        return chunk;
+    }
+
+    /// parallel_observable_3 dispatches DVS events from a memory-mapped file, using several threads.
+    /// The file is cut into chunks that begin with an EVT_TIME_HIGH word, which resynchronises the timestamp,
+    /// and whose first events follow an EVT_ADDR_Y word (and a base x for vectors). Chunks are decoded concurrently,
+    /// then stitched in order on the calling thread: the overflow count, y and base x are carried from one chunk
+    /// to the next, and the normalization and monotonic clamping are applied sequentially. Chunks whose first
+    /// EVT_TIME_HIGH word would be ignored by the carried state, or whose events depend on the previous chunk,
+    /// are decoded again sequentially. The dispatched events are identical to those of observable_3.
+    /// begin must point to the first byte after the header.
+    template <typename HandleEvent>
+    inline void parallel_observable_3(
+        const mapped_file& file,
+        std::size_t begin,
+        header stream_header,
+        bool normalize,
+        std::size_t threads,
+        HandleEvent handle_event) {
+        if (threads < 2) {
+            observable_3(file, begin, stream_header, normalize, std::move(handle_event));
+            return;
+        }
+        const auto bytes = file.data();
+        const auto end = begin + ((file.size() - begin) / 2) * 2;
+        std::deque<std::future<chunk_3>> chunks;
+        auto nominal_begin = begin;
+        const auto launch = [&]() {
+            const auto nominal_end = std::min(end, nominal_begin + chunk_size_3);
+            chunks.push_back(std::async(std::launch::async, [=]() {
+                const auto first = nominal_begin == begin;
+                const auto chunk_begin = first ? begin : find_time_high_3(bytes, nominal_begin, end);
+                const auto chunk_end = find_time_high_3(bytes, nominal_end, end);
+                return decode_chunk_3(bytes, chunk_begin, std::max(chunk_begin, chunk_end), first, stream_header);
+            }));
+            nominal_begin = nominal_end;
+        };
+        state_3 state(normalize);
+        for (std::size_t index = 0;; ++index) {
+            while (nominal_begin < end && chunks.size() < threads * 2) {
+                launch();
+            }
+            if (chunks.empty()) {
                 break;
             }
+            const auto chunk = chunks.front().get();
+            chunks.pop_front();
+            if (chunk.begin == chunk.end) {
+                continue;
+            }
+            auto overflows = state.overflows;
+            auto sequential = chunk.sequential;
+            if (index > 0 && !sequential) {
+                if (chunk.first_msb_t < state.previous_msb_t
+                    && state.previous_msb_t - chunk.first_msb_t > static_cast<uint32_t>((1 << 12) - 2)) {
+                    ++overflows;
+                } else if (
+                    chunk.first_msb_t <= state.previous_msb_t
+                    || chunk.first_msb_t - state.previous_msb_t >= static_cast<uint32_t>((1 << 12) - 2)) {
+                    sequential = true;
+                }
+            }
+            if (sequential) {
+                decode_3(bytes + chunk.begin, chunk.end - chunk.begin, stream_header, state, handle_event);
+                continue;
+            }
+            for (const auto& operation : chunk.operations) {
+                if (operation.kind == operation_3::type::t) {
+                    update_t_3(operation.t + (static_cast<uint64_t>(overflows) << 24), state);
+                } else {
+                    state.event.x = operation.x;
+                    state.event.y = operation.y;
+                    state.event.is_increase = operation.kind == operation_3::type::on;
+                    if (state.event.x < stream_header.width && state.event.y < stream_header.height) {
+                        handle_event(state.event);
+                    } else {
+                        std::cerr << "out of bounds event (t=" << state.event.t << ", x=" << state.event.x
+                                  << ", y=" << state.event.y << ", on=" << (state.event.is_increase ? "true" : "false")
+                                  << ")" << std::endl;
+                    }
+                }
+            }
+            state.previous_msb_t = chunk.state.previous_msb_t;
+            state.previous_lsb_t = chunk.state.previous_lsb_t;
+            state.overflows = overflows + chunk.state.overflows;
+            if (chunk.defines_y) {
+                state.event.y = chunk.state.event.y;
+            }
+            if (chunk.defines_x) {
+                state.event.x = chunk.state.event.x;
+                state.event.is_increase = chunk.state.event.is_increase;
+            }
         }
     }
 }
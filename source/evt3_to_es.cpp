@@ -1,5 +1,7 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "evt.hpp"
+#include "pipeline.hpp"
+#include <thread>
 
 int main(int argc, char* argv[]) {
     return pontella::main(
@@ -11,6 +13,16 @@ int main(int argc, char* argv[]) {
          "    -y size, --height size    sets the sensor height in pixels if not specified in the header",
          "                                  defaults to 720",
          "    -n, --normalize           offsets the timestamps so that the first one is zero",
+         "    -t threads, --threads threads",
+         "                              sets the number of decoding threads",
+         "                                  0 uses one thread per hardware core",
+         "                                  only regular input files are decoded in parallel",
+         "                                  defaults to 1",
+         "    -q depth, --queue-depth depth",
+         "                              sets the number of event blocks buffered for the writer thread",
+         "                                  defaults to 4",
+         "                                  the writer thread is only used with two or more hardware cores",
+         "    -b, --back-pressure       prints the writer queue statistics to the standard error",
          "    -h, --help                shows this help message"},
         argc,
         argv,
@@ -18,9 +30,12 @@ int main(int argc, char* argv[]) {
         {
             {"width", {"x"}},
             {"height", {"y"}},
+            {"threads", {"t"}},
+            {"queue-depth", {"q"}},
         },
         {
             {"normalize", {"n"}},
+            {"back-pressure", {"b"}},
         },
         [](pontella::command command) {
             if (command.arguments[0] == command.arguments[1]) {
@@ -42,13 +57,47 @@ int main(int argc, char* argv[]) {
                     default_header.height = static_cast<uint16_t>(std::stoull(name_and_argument->second));
                 }
             }
+            std::size_t threads = 1;
+            {
+                const auto name_and_argument = command.options.find("threads");
+                if (name_and_argument != command.options.end()) {
+                    threads = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (threads == 0) {
+                        threads = std::max(1u, std::thread::hardware_concurrency());
+                    }
+                }
+            }
+            auto depth = pipeline::default_depth;
+            {
+                const auto name_and_argument = command.options.find("queue-depth");
+                if (name_and_argument != command.options.end()) {
+                    depth = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (depth == 0) {
+                        throw std::runtime_error("the queue depth must be larger than 0");
+                    }
+                }
+            }
             auto stream = sepia::filename_to_ifstream(command.arguments[0]);
             const auto header = evt::read_header(*stream, std::move(default_header));
-            evt::observable_3(
-                *stream,
-                header,
-                command.flags.find("normalize") != command.flags.end(),
+            const auto normalize = command.flags.find("normalize") != command.flags.end();
+            pipeline::writer<sepia::dvs_event, sepia::write<sepia::type::dvs>> writer(
                 sepia::write<sepia::type::dvs>(
-                    sepia::filename_to_ofstream(command.arguments[1]), header.width, header.height));
+                    sepia::filename_to_ofstream(command.arguments[1]), header.width, header.height),
+                depth);
+            auto handle_event = [&](sepia::dvs_event event) {
+                writer(event);
+            };
+            const auto position = stream->tellg();
+            const auto file = filename_to_mapped_file(command.arguments[0]);
+            if (file && position >= 0) {
+                evt::parallel_observable_3(
+                    *file, static_cast<std::size_t>(position), header, normalize, threads, handle_event);
+            } else {
+                evt::observable_3(*stream, header, normalize, handle_event);
+            }
+            writer.close();
+            if (command.flags.find("back-pressure") != command.flags.end()) {
+                std::cerr << "writer: " << writer.ring_statistics() << std::endl;
+            }
         });
 }
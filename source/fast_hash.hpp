@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/// fast_hash implements a 128 bits non-cryptographic hash with the structure of XXH3
+/// (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md): the input is consumed in 64 bytes stripes
+/// by eight independent accumulators, which compilers turn into SIMD instructions.
+/// The secret and the finalization differ from XXH3's, hence the values are not compatible with xxHash.
+/// The benchmark's hash suite checks its avalanche and collisions.
+namespace fast_hash {
+    /// stripe_size is the number of bytes consumed by the accumulators in one step.
+    constexpr std::size_t stripe_size = 64;
+
+    /// lanes is the number of 64 bits accumulators.
+    constexpr std::size_t lanes = 8;
+
+    /// stripes_per_block is the number of stripes between two scrambles of the accumulators.
+    constexpr std::size_t stripes_per_block = 16;
+
+    /// block_size is the number of bytes between two scrambles of the accumulators.
+    constexpr std::size_t block_size = stripe_size * stripes_per_block;
+
+    /// secret_size is the number of 64 bits words in the secret.
+    /// Stripe n of a block uses the words [n, n + lanes), the scramble and the finalization use the last words.
+    constexpr std::size_t secret_size = stripes_per_block + 3 * lanes;
+
+    /// prime32_1 to prime64_5 are the primes used by XXH3.
+    constexpr uint64_t prime32_1 = 0x9e3779b1ull;
+    constexpr uint64_t prime32_2 = 0x85ebca77ull;
+    constexpr uint64_t prime32_3 = 0xc2b2ae3dull;
+    constexpr uint64_t prime64_1 = 0x9e3779b185ebca87ull;
+    constexpr uint64_t prime64_2 = 0xc2b2ae3d27d4eb4full;
+    constexpr uint64_t prime64_3 = 0x165667b19e3779f9ull;
+    constexpr uint64_t prime64_4 = 0x85ebca77c2b2ae63ull;
+    constexpr uint64_t prime64_5 = 0x27d4eb2f165667c5ull;
+
+    /// is_little_endian returns true if the host stores integers in little endian.
+    inline bool is_little_endian() {
+        const uint16_t probe = 1;
+        uint8_t first_byte;
+        std::memcpy(&first_byte, &probe, 1);
+        return first_byte == 1;
+    }
+
+    /// read_uint64 reads a little endian integer. Compilers reduce it to a single load on little endian hosts.
+    inline uint64_t read_uint64(const uint8_t* bytes) {
+        return static_cast<uint64_t>(bytes[0]) | (static_cast<uint64_t>(bytes[1]) << 8)
+               | (static_cast<uint64_t>(bytes[2]) << 16) | (static_cast<uint64_t>(bytes[3]) << 24)
+               | (static_cast<uint64_t>(bytes[4]) << 32) | (static_cast<uint64_t>(bytes[5]) << 40)
+               | (static_cast<uint64_t>(bytes[6]) << 48) | (static_cast<uint64_t>(bytes[7]) << 56);
+    }
+
+    /// multiply_fold returns the exclusive or of the high and low halves of the 128 bits product of two integers.
+    inline uint64_t multiply_fold(uint64_t first, uint64_t second) {
+#if defined(__SIZEOF_INT128__)
+        const auto product = static_cast<unsigned __int128>(first) * second;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        const auto low_low = (first & 0xffffffff) * (second & 0xffffffff);
+        const auto high_low = (first >> 32) * (second & 0xffffffff);
+        const auto low_high = (first & 0xffffffff) * (second >> 32);
+        const auto high_high = (first >> 32) * (second >> 32);
+        const auto cross = (low_low >> 32) + (high_low & 0xffffffff) + low_high;
+        const auto high = (high_low >> 32) + (cross >> 32) + high_high;
+        const auto low = (cross << 32) | (low_low & 0xffffffff);
+        return low ^ high;
+#endif
+    }
+
+    /// avalanche spreads the bits of an integer.
+    inline uint64_t avalanche(uint64_t value) {
+        value ^= value >> 37;
+        value *= 0x165667919e3779f9ull;
+        value ^= value >> 32;
+        return value;
+    }
+
+    /// default_secret returns the words mixed with the input, generated with splitmix64.
+    inline const std::array<uint64_t, secret_size>& default_secret() {
+        static const std::array<uint64_t, secret_size> secret = []() {
+            std::array<uint64_t, secret_size> words;
+            uint64_t state = prime64_1;
+            for (auto& word : words) {
+                state += 0x9e3779b97f4a7c15ull;
+                auto value = state;
+                value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+                value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+                word = value ^ (value >> 31);
+            }
+            return words;
+        }();
+        return secret;
+    }
+
+    /// hash calculates the hash of a sequence of bytes passed in pieces of any size.
+    class hash {
+        public:
+        hash() :
+            _secret(default_secret().data()),
+            _accumulators{{prime32_3, prime64_1, prime64_2, prime64_3, prime64_4, prime32_2, prime64_5, prime32_1}},
+            _buffer_size(0),
+            _length(0) {}
+        hash(const hash&) = default;
+        hash(hash&&) = default;
+        hash& operator=(const hash&) = default;
+        hash& operator=(hash&&) = default;
+        virtual ~hash() {}
+
+        /// update consumes bytes.
+        virtual void update(const uint8_t* bytes, std::size_t size) {
+            _length += size;
+            if (_buffer_size > 0) {
+                const auto copied = std::min(size, block_size - _buffer_size);
+                std::memcpy(_buffer.data() + _buffer_size, bytes, copied);
+                _buffer_size += copied;
+                bytes += copied;
+                size -= copied;
+                if (_buffer_size < block_size) {
+                    return;
+                }
+                consume_block(_buffer.data());
+                _buffer_size = 0;
+            }
+            for (; size >= block_size; bytes += block_size, size -= block_size) {
+                consume_block(bytes);
+            }
+            std::memcpy(_buffer.data(), bytes, size);
+            _buffer_size = size;
+        }
+
+        /// update_values consumes the little endian representation of integers.
+        template <typename Integer>
+        void update_values(const Integer* values, std::size_t size) {
+            if (is_little_endian()) {
+                update(reinterpret_cast<const uint8_t*>(values), size * sizeof(Integer));
+            } else {
+                std::array<uint8_t, sizeof(Integer)> bytes;
+                for (std::size_t value_index = 0; value_index < size; ++value_index) {
+                    for (std::size_t index = 0; index < sizeof(Integer); ++index) {
+                        bytes[index] =
+                            static_cast<uint8_t>((static_cast<uint64_t>(values[value_index]) >> (8 * index)) & 0xff);
+                    }
+                    update(bytes.data(), bytes.size());
+                }
+            }
+        }
+
+        /// digest returns the hash of the bytes consumed so far, as a pair (low, high).
+        virtual std::pair<uint64_t, uint64_t> digest() const {
+            auto accumulators = _accumulators;
+            const auto stripes = _buffer_size / stripe_size;
+            for (std::size_t stripe = 0; stripe < stripes; ++stripe) {
+                accumulate(accumulators, _buffer.data() + stripe * stripe_size, stripe);
+            }
+            if (_buffer_size % stripe_size > 0 || _length == 0) {
+                std::array<uint8_t, stripe_size> last_stripe{};
+                std::memcpy(
+                    last_stripe.data(), _buffer.data() + stripes * stripe_size, _buffer_size % stripe_size);
+                accumulate(accumulators, last_stripe.data(), stripes);
+            }
+            return {
+                merge(accumulators, stripes_per_block + lanes, _length * prime64_1),
+                merge(accumulators, stripes_per_block + 2 * lanes, ~(_length * prime64_2)),
+            };
+        }
+
+        protected:
+        /// accumulate mixes a stripe into the accumulators.
+        void accumulate(std::array<uint64_t, lanes>& accumulators, const uint8_t* stripe, std::size_t index) const {
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                const auto value = read_uint64(stripe + lane * 8);
+                const auto key = value ^ _secret[index + lane];
+                accumulators[lane ^ 1] += value;
+                accumulators[lane] += (key & 0xffffffff) * (key >> 32);
+            }
+        }
+
+        /// consume_block accumulates a full block and scrambles the accumulators.
+        void consume_block(const uint8_t* block) {
+            for (std::size_t stripe = 0; stripe < stripes_per_block; ++stripe) {
+                accumulate(_accumulators, block + stripe * stripe_size, stripe);
+            }
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                auto accumulator = _accumulators[lane];
+                accumulator ^= accumulator >> 47;
+                accumulator ^= _secret[stripes_per_block + lane];
+                _accumulators[lane] = accumulator * prime32_1;
+            }
+        }
+
+        /// merge combines the accumulators into a 64 bits integer.
+        uint64_t merge(const std::array<uint64_t, lanes>& accumulators, std::size_t offset, uint64_t start) const {
+            auto result = start;
+            for (std::size_t lane = 0; lane < lanes; lane += 2) {
+                result += multiply_fold(
+                    accumulators[lane] ^ _secret[offset + lane], accumulators[lane + 1] ^ _secret[offset + lane + 1]);
+            }
+            return avalanche(result);
+        }
+
+        const uint64_t* _secret;
+        std::array<uint64_t, lanes> _accumulators;
+        std::array<uint8_t, block_size> _buffer;
+        std::size_t _buffer_size;
+        uint64_t _length;
+    };
+}
@@ -0,0 +1,487 @@
+#include "../third_party/pontella/source/pontella.hpp"
+#include "../third_party/sepia/source/sepia.hpp"
+#include "time_index.hpp"
+#include "timecode.hpp"
+#include <sstream>
+
+/// specification holds the parameters of the filter stages.
+struct specification {
+    uint64_t begin_t;
+    uint64_t end_t;
+    bool has_region;
+    uint16_t left;
+    uint16_t bottom;
+    uint16_t width;
+    uint16_t height;
+    bool preserve_offset;
+    bool has_polarity;
+    bool is_increase;
+    std::vector<bool> mask;
+    uint16_t spatial_factor;
+    uint64_t temporal_period;
+};
+
+/// mask_stage removes the events of masked pixels.
+class mask_stage {
+    public:
+    mask_stage(const std::vector<bool>& mask, uint16_t width) : _mask(mask), _width(width) {}
+
+    template <typename Event>
+    bool operator()(Event& event) const {
+        return !_mask[event.x + event.y * _width];
+    }
+
+    protected:
+    const std::vector<bool>& _mask;
+    const uint16_t _width;
+};
+
+/// region_stage removes the events outside a rectangle, and optionally normalizes the coordinates of the others.
+class region_stage {
+    public:
+    region_stage(uint16_t left, uint16_t bottom, uint16_t width, uint16_t height, bool normalize) :
+        _left(left), _bottom(bottom), _right(left + width), _top(bottom + height), _normalize(normalize) {}
+
+    template <typename Event>
+    bool operator()(Event& event) const {
+        if (event.x < _left || event.x >= _right || event.y < _bottom || event.y >= _top) {
+            return false;
+        }
+        if (_normalize) {
+            event.x -= _left;
+            event.y -= _bottom;
+        }
+        return true;
+    }
+
+    protected:
+    const uint16_t _left;
+    const uint16_t _bottom;
+    const uint16_t _right;
+    const uint16_t _top;
+    const bool _normalize;
+};
+
+/// polarity_stage removes the events with the other polarity.
+template <sepia::type event_stream_type>
+class polarity_stage;
+
+template <>
+class polarity_stage<sepia::type::dvs> {
+    public:
+    polarity_stage(bool is_increase) : _is_increase(is_increase) {}
+
+    bool operator()(sepia::dvs_event& event) const {
+        return event.is_increase == _is_increase;
+    }
+
+    protected:
+    const bool _is_increase;
+};
+
+/// ATIS threshold crossings are kept, since they encode exposure measurements rather than changes.
+template <>
+class polarity_stage<sepia::type::atis> {
+    public:
+    polarity_stage(bool is_increase) : _is_increase(is_increase) {}
+
+    bool operator()(sepia::atis_event& event) const {
+        return event.is_threshold_crossing || event.polarity == _is_increase;
+    }
+
+    protected:
+    const bool _is_increase;
+};
+
+/// Color events have no polarity, the option is rejected before a chain is built.
+template <>
+class polarity_stage<sepia::type::color> {
+    public:
+    polarity_stage(bool) {
+        throw std::runtime_error("polarity is not compatible with color events");
+    }
+
+    bool operator()(sepia::color_event&) const {
+        return true;
+    }
+};
+
+/// spatial_decimation_stage divides the coordinates by a factor, merging factor x factor pixel blocks.
+class spatial_decimation_stage {
+    public:
+    spatial_decimation_stage(uint16_t factor) : _factor(factor) {}
+
+    template <typename Event>
+    bool operator()(Event& event) const {
+        event.x /= _factor;
+        event.y /= _factor;
+        return true;
+    }
+
+    protected:
+    const uint16_t _factor;
+};
+
+/// temporal_decimation_stage removes the events that follow the previous event of the same pixel by less than period.
+class temporal_decimation_stage {
+    public:
+    temporal_decimation_stage(uint64_t period, uint16_t width, uint16_t height) :
+        _period(period), _width(width), _next_ts(static_cast<std::size_t>(width) * height, 0) {}
+
+    template <typename Event>
+    bool operator()(Event& event) {
+        auto& next_t = _next_ts[event.x + event.y * _width];
+        if (event.t < next_t) {
+            return false;
+        }
+        next_t = event.t + _period;
+        return true;
+    }
+
+    protected:
+    const uint64_t _period;
+    const uint16_t _width;
+    std::vector<uint64_t> _next_ts;
+};
+
+/// chain applies stages in order, and stops at the first stage that rejects the event.
+/// Chains are assembled at compile time, hence disabled stages cost nothing and enabled stages can be inlined.
+template <typename... Stages>
+class chain;
+
+template <>
+class chain<> {
+    public:
+    template <typename Event>
+    bool operator()(Event&) {
+        return true;
+    }
+};
+
+template <typename Stage, typename... Stages>
+class chain<Stage, Stages...> {
+    public:
+    chain(Stage stage, chain<Stages...> stages) : _stage(std::move(stage)), _stages(std::move(stages)) {}
+
+    template <typename Event>
+    bool operator()(Event& event) {
+        return _stage(event) && _stages(event);
+    }
+
+    protected:
+    Stage _stage;
+    chain<Stages...> _stages;
+};
+
+/// output_width returns the width of the filtered stream.
+inline uint16_t output_width(const sepia::header& header, const specification& filter_specification) {
+    const auto width =
+        filter_specification.has_region && !filter_specification.preserve_offset ? filter_specification.width :
+                                                                                   header.width;
+    return static_cast<uint16_t>(
+        (width + filter_specification.spatial_factor - 1) / filter_specification.spatial_factor);
+}
+
+/// output_height returns the height of the filtered stream.
+inline uint16_t output_height(const sepia::header& header, const specification& filter_specification) {
+    const auto height =
+        filter_specification.has_region && !filter_specification.preserve_offset ? filter_specification.height :
+                                                                                   header.height;
+    return static_cast<uint16_t>(
+        (height + filter_specification.spatial_factor - 1) / filter_specification.spatial_factor);
+}
+
+/// filter decodes the input, applies a chain to every event in the time range, and encodes the remaining events.
+template <sepia::type event_stream_type>
+class filter {
+    public:
+    filter(
+        const sepia::header& header,
+        const specification& filter_specification,
+        const std::string& input_filename,
+        const std::string& output_filename) :
+        _header(header),
+        _filter_specification(filter_specification),
+        _input_filename(input_filename),
+        _output_filename(output_filename) {}
+
+    /// operator() runs the filter with the given chain.
+    template <typename Chain>
+    void operator()(Chain filter_chain) const {
+        const auto begin_t = _filter_specification.begin_t;
+        const auto end_t = _filter_specification.end_t;
+        sepia::write<event_stream_type> write(
+            sepia::filename_to_ofstream(_output_filename),
+            output_width(_header, _filter_specification),
+            output_height(_header, _filter_specification));
+        time_index::join_observable<event_stream_type>(
+            _input_filename, begin_t, [&](sepia::event<event_stream_type> event) {
+                if (event.t < begin_t) {
+                    return;
+                }
+                if (event.t >= end_t) {
+                    throw sepia::end_of_file();
+                }
+                if (filter_chain(event)) {
+                    write(event);
+                }
+            });
+    }
+
+    /// header returns the input header.
+    const sepia::header& header() const {
+        return _header;
+    }
+
+    /// filter_specification returns the stages parameters.
+    const specification& filter_specification() const {
+        return _filter_specification;
+    }
+
+    protected:
+    const sepia::header& _header;
+    const specification& _filter_specification;
+    const std::string& _input_filename;
+    const std::string& _output_filename;
+};
+
+/// with_mask, with_region, with_polarity, with_spatial_decimation and with_temporal_decimation
+/// prepend their stage to the chain if it is enabled, and pass the chain to the previous stage's function.
+/// Each function doubles the number of instantiated chains, one per combination of enabled stages.
+template <sepia::type event_stream_type, typename... Stages>
+void with_mask(const filter<event_stream_type>& run, chain<Stages...> stages) {
+    if (run.filter_specification().mask.empty()) {
+        run(std::move(stages));
+    } else {
+        run(chain<mask_stage, Stages...>(
+            mask_stage(run.filter_specification().mask, run.header().width), std::move(stages)));
+    }
+}
+
+template <sepia::type event_stream_type, typename... Stages>
+void with_region(const filter<event_stream_type>& run, chain<Stages...> stages) {
+    const auto& filter_specification = run.filter_specification();
+    if (filter_specification.has_region) {
+        with_mask<event_stream_type>(
+            run,
+            chain<region_stage, Stages...>(
+                region_stage(
+                    filter_specification.left,
+                    filter_specification.bottom,
+                    filter_specification.width,
+                    filter_specification.height,
+                    !filter_specification.preserve_offset),
+                std::move(stages)));
+    } else {
+        with_mask<event_stream_type>(run, std::move(stages));
+    }
+}
+
+template <sepia::type event_stream_type, typename... Stages>
+void with_polarity(const filter<event_stream_type>& run, chain<Stages...> stages) {
+    if (run.filter_specification().has_polarity) {
+        with_region<event_stream_type>(
+            run,
+            chain<polarity_stage<event_stream_type>, Stages...>(
+                polarity_stage<event_stream_type>(run.filter_specification().is_increase), std::move(stages)));
+    } else {
+        with_region<event_stream_type>(run, std::move(stages));
+    }
+}
+
+template <sepia::type event_stream_type, typename... Stages>
+void with_spatial_decimation(const filter<event_stream_type>& run, chain<Stages...> stages) {
+    if (run.filter_specification().spatial_factor > 1) {
+        with_polarity<event_stream_type>(
+            run,
+            chain<spatial_decimation_stage, Stages...>(
+                spatial_decimation_stage(run.filter_specification().spatial_factor), std::move(stages)));
+    } else {
+        with_polarity<event_stream_type>(run, std::move(stages));
+    }
+}
+
+template <sepia::type event_stream_type>
+void with_temporal_decimation(const filter<event_stream_type>& run) {
+    if (run.filter_specification().temporal_period > 0) {
+        with_spatial_decimation<event_stream_type>(
+            run,
+            chain<temporal_decimation_stage>(
+                temporal_decimation_stage(
+                    run.filter_specification().temporal_period,
+                    output_width(run.header(), run.filter_specification()),
+                    output_height(run.header(), run.filter_specification())),
+                chain<>()));
+    } else {
+        with_spatial_decimation<event_stream_type>(run, chain<>());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {
+            "filter applies a sequence of filters to an Event Stream file, in a single pass.",
+            "    The enabled stages are applied in the following order: time range, mask, region, polarity,",
+            "    spatial decimation, temporal decimation.",
+            "Syntax: ./filter [options] /path/to/input.es /path/to/output.es",
+            "Available options:",
+            "    -b [timecode], --begin [timecode]            ignores events before this timestamp (timecode)",
+            "                                                     defaults to 00:00:00",
+            "    -e [timecode], --end [timecode]              ignores events after this timestamp (timecode)",
+            "                                                     defaults to the end of the recording",
+            "    -m [path], --mask [path]                     removes the events of the pixels listed in a file",
+            "                                                     the file contains one 'x y' pair per line",
+            "    -r [region], --region [region]               removes the events outside a region,",
+            "                                                     given as left,bottom,width,height",
+            "    -p, --preserve-offset                        prevents the coordinates of the region",
+            "                                                     from being normalized",
+            "    -o [polarity], --polarity [polarity]         keeps only the events with the given polarity",
+            "                                                     one of on, off",
+            "                                                     ATIS threshold crossings are always kept",
+            "    -s [factor], --spatial-decimation [factor]   divides the coordinates by an integer factor",
+            "    -d [duration], --temporal-decimation [duration]",
+            "                                                 removes the events that follow the previous event",
+            "                                                     of the same (decimated) pixel by less than",
+            "                                                     duration microseconds",
+            "    -h, --help                                   shows this help message",
+        },
+        argc,
+        argv,
+        2,
+        {
+            {"begin", {"b"}},
+            {"end", {"e"}},
+            {"mask", {"m"}},
+            {"region", {"r"}},
+            {"polarity", {"o"}},
+            {"spatial-decimation", {"s"}},
+            {"temporal-decimation", {"d"}},
+        },
+        {{"preserve-offset", {"p"}}},
+        [](pontella::command command) {
+            if (command.arguments[0] == command.arguments[1]) {
+                throw std::runtime_error("The Event Stream input and output must be different files");
+            }
+            const auto header = sepia::read_header(sepia::filename_to_ifstream(command.arguments[0]));
+            specification filter_specification{
+                0,
+                std::numeric_limits<uint64_t>::max(),
+                false,
+                0,
+                0,
+                header.width,
+                header.height,
+                command.flags.find("preserve-offset") != command.flags.end(),
+                false,
+                true,
+                {},
+                1,
+                0,
+            };
+            {
+                const auto name_and_argument = command.options.find("begin");
+                if (name_and_argument != command.options.end()) {
+                    filter_specification.begin_t = timecode(name_and_argument->second).value();
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("end");
+                if (name_and_argument != command.options.end()) {
+                    filter_specification.end_t = timecode(name_and_argument->second).value();
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("mask");
+                if (name_and_argument != command.options.end()) {
+                    filter_specification.mask.resize(static_cast<std::size_t>(header.width) * header.height, false);
+                    auto stream = sepia::filename_to_ifstream(name_and_argument->second);
+                    uint64_t x = 0;
+                    uint64_t y = 0;
+                    while (*stream >> x >> y) {
+                        if (x >= header.width || y >= header.height) {
+                            throw std::runtime_error("The mask contains pixels out of scope");
+                        }
+                        filter_specification.mask[x + y * header.width] = true;
+                    }
+                    if (!stream->eof()) {
+                        throw std::runtime_error("The mask must contain one 'x y' pair per line");
+                    }
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("region");
+                if (name_and_argument != command.options.end()) {
+                    std::vector<uint64_t> values;
+                    std::stringstream stream(name_and_argument->second);
+                    for (std::string value; std::getline(stream, value, ',');) {
+                        values.push_back(std::stoull(value));
+                    }
+                    if (values.size() != 4) {
+                        throw std::runtime_error("region must have the format left,bottom,width,height");
+                    }
+                    if (values[0] + values[2] > header.width || values[1] + values[3] > header.height) {
+                        throw std::runtime_error("The selected region is out of scope");
+                    }
+                    filter_specification.has_region = true;
+                    filter_specification.left = static_cast<uint16_t>(values[0]);
+                    filter_specification.bottom = static_cast<uint16_t>(values[1]);
+                    filter_specification.width = static_cast<uint16_t>(values[2]);
+                    filter_specification.height = static_cast<uint16_t>(values[3]);
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("polarity");
+                if (name_and_argument != command.options.end()) {
+                    if (name_and_argument->second == "on") {
+                        filter_specification.is_increase = true;
+                    } else if (name_and_argument->second == "off") {
+                        filter_specification.is_increase = false;
+                    } else {
+                        throw std::runtime_error("polarity must be one of {on, off}");
+                    }
+                    if (header.event_stream_type == sepia::type::color) {
+                        throw std::runtime_error("polarity is not compatible with color events");
+                    }
+                    filter_specification.has_polarity = true;
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("spatial-decimation");
+                if (name_and_argument != command.options.end()) {
+                    const auto factor = std::stoull(name_and_argument->second);
+                    if (factor == 0 || factor > std::numeric_limits<uint16_t>::max()) {
+                        throw std::runtime_error("spatial-decimation must be in the range [1, 65535]");
+                    }
+                    filter_specification.spatial_factor = static_cast<uint16_t>(factor);
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("temporal-decimation");
+                if (name_and_argument != command.options.end()) {
+                    filter_specification.temporal_period = timecode(name_and_argument->second).value();
+                }
+            }
+            switch (header.event_stream_type) {
+                case sepia::type::generic: {
+                    throw std::runtime_error("Unsupported event type: generic");
+                    break;
+                }
+                case sepia::type::dvs: {
+                    with_temporal_decimation<sepia::type::dvs>(filter<sepia::type::dvs>(
+                        header, filter_specification, command.arguments[0], command.arguments[1]));
+                    break;
+                }
+                case sepia::type::atis: {
+                    with_temporal_decimation<sepia::type::atis>(filter<sepia::type::atis>(
+                        header, filter_specification, command.arguments[0], command.arguments[1]));
+                    break;
+                }
+                case sepia::type::color: {
+                    with_temporal_decimation<sepia::type::color>(filter<sepia::type::color>(
+                        header, filter_specification, command.arguments[0], command.arguments[1]));
+                    break;
+                }
+            }
+        });
+    return 0;
+}
@@ -0,0 +1,608 @@
+#pragma once
+
+#include "../third_party/stb_truetype.hpp"
+#include "font.hpp"
+#include "pipeline.hpp"
+#include "timecode.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+enum class style { exponential, linear, window, cumulative, cumulative_shared };
+
+/// no_t marks the pixels without a recent event in the 32 bits timestamps of a state.
+constexpr uint32_t no_t = std::numeric_limits<uint32_t>::max();
+
+/// no_wide_t marks the pixels without events in the 64 bits timestamps of a state.
+constexpr uint64_t no_wide_t = std::numeric_limits<uint64_t>::max();
+
+/// maximum_span is the largest time kept between a state's epoch and its latest event when the epoch moves forward.
+/// It leaves at least 2^31 us between two moves of the epoch.
+constexpr uint64_t maximum_span = static_cast<uint64_t>(1) << 31;
+
+/// exponential_span_ratio is the multiple of tau after which an exponential activity is exactly zero,
+/// since exp(-128) is smaller than the smallest single precision denormal.
+constexpr uint64_t exponential_span_ratio = 128;
+
+/// state holds the pixels' activities as a structure of arrays.
+/// Timestamps are stored on 32 bits, relative to an epoch that moves forward with the events, and polarities are
+/// packed 64 per word. For the cumulative style, ts and activities track the ON events and off_ts and off_activities
+/// the OFF events. The styles that only depend on the last event use absolute 64 bits timestamps (wide_ts) instead
+/// if the span of their activity is larger than maximum_span.
+struct state {
+    uint64_t epoch = 0;
+    uint64_t span = maximum_span;
+    std::vector<uint32_t> ts;
+    std::vector<uint64_t> wide_ts;
+    std::vector<float> activities;
+    std::vector<uint32_t> off_ts;
+    std::vector<float> off_activities;
+    std::vector<uint64_t> ons;
+
+    /// is_on returns the polarity of the last event of a pixel.
+    bool is_on(std::size_t index) const {
+        return (ons[index >> 6] >> (index & 63)) & 1;
+    }
+
+    /// set_on updates the polarity of the last event of a pixel.
+    void set_on(std::size_t index, bool on) {
+        const auto mask = static_cast<uint64_t>(1) << (index & 63);
+        ons[index >> 6] = on ? (ons[index >> 6] | mask) : (ons[index >> 6] & ~mask);
+    }
+
+    /// last_t returns the absolute timestamp of the last event of a pixel, or no_wide_t if it has none.
+    uint64_t last_t(std::size_t index) const {
+        if (wide_ts.empty()) {
+            return ts[index] == no_t ? no_wide_t : epoch + ts[index];
+        }
+        return wide_ts[index];
+    }
+};
+
+/// is_cumulative returns true if the activity of a pixel accumulates its events,
+/// and false if it only depends on the pixel's last event.
+constexpr bool is_cumulative(style decay_style) {
+    return decay_style == style::cumulative || decay_style == style::cumulative_shared;
+}
+
+/// rebase_ts shifts last event timestamps to an epoch shift microseconds later,
+/// and marks the pixels whose last event precedes it as without events.
+inline void rebase_ts(std::vector<uint32_t>& ts, uint64_t shift) {
+    for (auto& t : ts) {
+        t = t < shift ? no_t : (t == no_t ? no_t : t - static_cast<uint32_t>(shift));
+    }
+}
+
+/// rebase_activities shifts timestamps paired with activities to an epoch shift microseconds later.
+/// The activities of the pixels whose last event precedes it are decayed to the new epoch.
+inline void rebase_activities(std::vector<uint32_t>& ts, std::vector<float>& activities, uint64_t shift, uint64_t tau) {
+    for (std::size_t index = 0; index < ts.size(); ++index) {
+        if (ts[index] < shift) {
+            activities[index] *= std::exp(-static_cast<float>(shift - ts[index]) / static_cast<float>(tau));
+            ts[index] = 0;
+        } else {
+            ts[index] -= static_cast<uint32_t>(shift);
+        }
+    }
+}
+
+/// kernel implements the state update and the activity of a decay style.
+/// Each style is a specialization, hence the per-event and per-pixel loops do not branch on the style.
+template <style decay_style>
+struct kernel;
+
+/// last_event_kernel implements the state of the styles that only depend on the last event of each pixel.
+/// When the epoch moves forward, it is set span microseconds before the latest event, and the pixels whose last event
+/// precedes it are marked as without events. Their activity is zero in every later frame.
+template <style decay_style>
+struct last_event_kernel {
+    /// resize allocates the state of every pixel.
+    static void resize(state& style_state, std::size_t pixels, uint64_t tau) {
+        style_state.span = kernel<decay_style>::span(tau);
+        if (style_state.span > maximum_span) {
+            style_state.wide_ts.resize(pixels, no_wide_t);
+        } else {
+            style_state.ts.resize(pixels, no_t);
+        }
+        style_state.ons.resize((pixels + 63) / 64, 0);
+    }
+
+    /// update applies an event to the state of its pixel.
+    static void update(state& style_state, std::size_t index, uint64_t t, bool is_increase, uint64_t) {
+        if (style_state.wide_ts.empty()) {
+            if (t - style_state.epoch >= no_t) {
+                const auto shift = t - style_state.span - style_state.epoch;
+                rebase_ts(style_state.ts, shift);
+                style_state.epoch += shift;
+            }
+            style_state.ts[index] = static_cast<uint32_t>(t - style_state.epoch);
+        } else {
+            style_state.wide_ts[index] = t;
+        }
+        style_state.set_on(index, is_increase);
+    }
+};
+
+template <>
+struct kernel<style::exponential> : public last_event_kernel<style::exponential> {
+    /// span returns the time after which the activity of a pixel is zero.
+    static uint64_t span(uint64_t tau) {
+        return tau > maximum_span / exponential_span_ratio ? no_wide_t : tau * exponential_span_ratio;
+    }
+
+    /// lambda returns the activity of a pixel whose last event happened at t.
+    static float lambda(uint64_t t, uint64_t frame_t, uint64_t tau) {
+        return std::exp(-static_cast<float>(frame_t - 1 - t) / static_cast<float>(tau));
+    }
+};
+
+template <>
+struct kernel<style::linear> : public last_event_kernel<style::linear> {
+    /// span returns the time after which the activity of a pixel is zero.
+    static uint64_t span(uint64_t tau) {
+        return tau > maximum_span / 2 ? no_wide_t : 2 * tau;
+    }
+
+    /// lambda returns the activity of a pixel whose last event happened at t.
+    static float lambda(uint64_t t, uint64_t frame_t, uint64_t tau) {
+        return t + 2 * tau > frame_t - 1 ?
+                   static_cast<float>(t + 2 * tau - (frame_t - 1)) / static_cast<float>(2 * tau) :
+                   0.0f;
+    }
+};
+
+template <>
+struct kernel<style::window> : public last_event_kernel<style::window> {
+    /// span returns the time after which the activity of a pixel is zero.
+    static uint64_t span(uint64_t tau) {
+        return tau;
+    }
+
+    /// lambda returns the activity of a pixel whose last event happened at t.
+    static float lambda(uint64_t t, uint64_t frame_t, uint64_t tau) {
+        return t + tau > frame_t - 1 ? 1.0f : 0.0f;
+    }
+};
+
+template <>
+struct kernel<style::cumulative> {
+    /// resize allocates the state of every pixel.
+    static void resize(state& style_state, std::size_t pixels, uint64_t) {
+        style_state.ts.resize(pixels, 0);
+        style_state.activities.resize(pixels, 0.0f);
+        style_state.off_ts.resize(pixels, 0);
+        style_state.off_activities.resize(pixels, 0.0f);
+    }
+
+    /// update applies an event to the state of its pixel.
+    static void update(state& style_state, std::size_t index, uint64_t t, bool is_increase, uint64_t tau) {
+        if (t - style_state.epoch >= no_t) {
+            const auto shift = t - style_state.span - style_state.epoch;
+            rebase_activities(style_state.ts, style_state.activities, shift, tau);
+            rebase_activities(style_state.off_ts, style_state.off_activities, shift, tau);
+            style_state.epoch += shift;
+        }
+        auto& relative_t = is_increase ? style_state.ts[index] : style_state.off_ts[index];
+        auto& activity = is_increase ? style_state.activities[index] : style_state.off_activities[index];
+        activity = activity
+                       * std::exp(
+                           -static_cast<float>(t - style_state.epoch - relative_t) / static_cast<float>(tau))
+                   + 1.0f;
+        relative_t = static_cast<uint32_t>(t - style_state.epoch);
+    }
+
+    /// lambda_and_on returns the largest of the ON and OFF activities of a pixel, and whether it is the ON one.
+    static std::pair<float, bool>
+    lambda_and_on(const state& style_state, std::size_t index, uint64_t frame_t, uint64_t tau) {
+        const auto relative_frame_t = frame_t - 1 - style_state.epoch;
+        const auto on_lambda =
+            style_state.activities[index]
+            * std::exp(-static_cast<float>(relative_frame_t - style_state.ts[index]) / static_cast<float>(tau));
+        const auto off_lambda =
+            style_state.off_activities[index]
+            * std::exp(-static_cast<float>(relative_frame_t - style_state.off_ts[index]) / static_cast<float>(tau));
+        if (off_lambda > on_lambda) {
+            return {off_lambda, false};
+        }
+        return {on_lambda, true};
+    }
+};
+
+template <>
+struct kernel<style::cumulative_shared> {
+    /// resize allocates the state of every pixel.
+    static void resize(state& style_state, std::size_t pixels, uint64_t) {
+        style_state.ts.resize(pixels, 0);
+        style_state.activities.resize(pixels, 0.0f);
+        style_state.ons.resize((pixels + 63) / 64, 0);
+    }
+
+    /// update applies an event to the state of its pixel.
+    static void update(state& style_state, std::size_t index, uint64_t t, bool is_increase, uint64_t tau) {
+        if (t - style_state.epoch >= no_t) {
+            const auto shift = t - style_state.span - style_state.epoch;
+            rebase_activities(style_state.ts, style_state.activities, shift, tau);
+            style_state.epoch += shift;
+        }
+        style_state.activities[index] =
+            style_state.activities[index]
+                * std::exp(
+                    -static_cast<float>(t - style_state.epoch - style_state.ts[index]) / static_cast<float>(tau))
+            + 1.0f;
+        style_state.ts[index] = static_cast<uint32_t>(t - style_state.epoch);
+        style_state.set_on(index, is_increase);
+    }
+
+    /// lambda_and_on returns the activity of a pixel, and the polarity of its last event.
+    static std::pair<float, bool>
+    lambda_and_on(const state& style_state, std::size_t index, uint64_t frame_t, uint64_t tau) {
+        return {
+            style_state.activities[index]
+                * std::exp(
+                    -static_cast<float>(frame_t - 1 - style_state.epoch - style_state.ts[index])
+                    / static_cast<float>(tau)),
+            style_state.is_on(index)};
+    }
+};
+
+struct color {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    color(uint8_t default_r, uint8_t default_g, uint8_t default_b) : r(default_r), g(default_g), b(default_b) {}
+    color(const std::string& hexadecimal_string) {
+        if (hexadecimal_string.size() != 7 || hexadecimal_string.front() != '#'
+            || std::any_of(std::next(hexadecimal_string.begin()), hexadecimal_string.end(), [](char character) {
+                   return !std::isxdigit(character);
+               })) {
+            throw std::runtime_error("color must be formatted as #hhhhhh, where h is an hexadecimal digit");
+        }
+        r = static_cast<uint8_t>(std::stoul(hexadecimal_string.substr(1, 2), nullptr, 16));
+        g = static_cast<uint8_t>(std::stoul(hexadecimal_string.substr(3, 2), nullptr, 16));
+        b = static_cast<uint8_t>(std::stoul(hexadecimal_string.substr(5, 2), nullptr, 16));
+    }
+    uint8_t mix_r(color other, float lambda) {
+        return static_cast<uint8_t>((1.0f - lambda) * r + lambda * other.r);
+    }
+    uint8_t mix_g(color other, float lambda) {
+        return static_cast<uint8_t>((1.0f - lambda) * g + lambda * other.g);
+    }
+    uint8_t mix_b(color other, float lambda) {
+        return static_cast<uint8_t>((1.0f - lambda) * b + lambda * other.b);
+    }
+    std::string hex() {
+        std::stringstream stream;
+        stream << "#" << std::setw(2) << std::setfill('0') << std::hex << static_cast<int32_t>(r) << std::setw(2)
+               << std::setfill('0') << std::hex << static_cast<int32_t>(g) << std::setw(2) << std::setfill('0')
+               << std::hex << static_cast<int32_t>(b);
+        const auto result = stream.str();
+        return result;
+    }
+};
+
+class frame {
+    public:
+    frame(uint16_t width, uint16_t height, uint16_t scale, std::size_t threads) :
+        _width(width * scale),
+        _height(height * scale),
+        _scale(scale),
+        _bytes((width * scale) * (height * scale) * 3),
+        _pool(threads) {}
+    frame(const frame&) = delete;
+    frame(frame&& other) = delete;
+    frame& operator=(const frame&) = delete;
+    frame& operator=(frame&& other) = delete;
+    virtual ~frame() {}
+
+    template <style decay_style>
+    void paste_state(
+        uint16_t width,
+        uint16_t height,
+        const state& style_state,
+        uint16_t x_offset,
+        uint16_t y_offset,
+        uint64_t tau,
+        color on_color,
+        color off_color,
+        color idle_color,
+        uint64_t frame_t,
+        float cumulative_ratio,
+        float lambda_maximum,
+        bool lambda_maximum_auto) {
+        paste_state<decay_style>(
+            width,
+            height,
+            style_state,
+            x_offset,
+            y_offset,
+            tau,
+            on_color,
+            off_color,
+            idle_color,
+            frame_t,
+            cumulative_ratio,
+            lambda_maximum,
+            lambda_maximum_auto,
+            std::integral_constant<bool, is_cumulative(decay_style)>());
+    }
+
+    virtual void paste_delta_ts(
+        uint16_t width,
+        uint16_t height,
+        const std::vector<uint64_t>& delta_ts,
+        uint16_t x_offset,
+        uint16_t y_offset,
+        uint64_t black,
+        bool black_auto,
+        uint64_t white,
+        bool white_auto,
+        float discard_ratio,
+        color atis_color) {
+        auto minimum = 0.5f;
+        auto maximum = 0.5f;
+        if (white_auto || black_auto) {
+            std::vector<uint64_t> sorted_delta_ts(delta_ts.size());
+            const auto end =
+                std::copy_if(delta_ts.begin(), delta_ts.end(), sorted_delta_ts.begin(), [](uint64_t delta_t) {
+                    return delta_t < std::numeric_limits<uint64_t>::max() && delta_t > 0;
+                });
+            const auto size = static_cast<std::size_t>(std::distance(sorted_delta_ts.begin(), end));
+            if (size > 0) {
+                std::sort(sorted_delta_ts.begin(), end);
+                auto black_candidate = sorted_delta_ts[static_cast<std::size_t>((size - 1) * (1.0f - discard_ratio))];
+                auto white_candidate = sorted_delta_ts[static_cast<std::size_t>((size - 1) * discard_ratio + 0.5f)];
+                if (black_candidate > white_candidate) {
+                    minimum = 1.0f / static_cast<float>(black_candidate);
+                    maximum = 1.0f / static_cast<float>(white_candidate);
+                } else {
+                    black_candidate = *std::prev(end);
+                    white_candidate = sorted_delta_ts.front();
+                    if (black_candidate > white_candidate) {
+                        minimum = 1.0f / static_cast<float>(black_candidate);
+                        maximum = 1.0f / static_cast<float>(white_candidate);
+                    }
+                }
+            }
+        } else {
+            minimum = 1.0f / static_cast<float>(black);
+            maximum = 1.0f / static_cast<float>(white);
+        }
+        auto slope = 0.0f;
+        auto intercept = 0.5f;
+        if (maximum > minimum) {
+            slope = 1.0f / (maximum - minimum);
+            intercept = -slope * minimum;
+        }
+        _pool.run(height, [&](std::size_t begin, std::size_t end) {
+            for (auto y = static_cast<uint16_t>(begin); y < end; ++y) {
+                paste_row(width, y, x_offset, y_offset, [&](uint16_t x) {
+                    const auto delta_t = delta_ts[x + y * width];
+                    if (delta_t == std::numeric_limits<uint64_t>::max()) {
+                        return atis_color;
+                    }
+                    uint8_t value = 0;
+                    if (delta_t > 0) {
+                        const auto luminance = 1.0f / static_cast<float>(delta_t);
+                        if (luminance >= maximum) {
+                            value = 255;
+                        } else if (luminance > minimum) {
+                            value = static_cast<uint8_t>((slope * luminance + intercept) * 255.0f);
+                        }
+                    }
+                    return color(value, value, value);
+                });
+            }
+        });
+    }
+
+    virtual void paste_timecode(uint16_t left, uint16_t top, uint16_t font_size, uint64_t frame_t) {
+        if (!_fontinfo) {
+            _fontinfo = std::unique_ptr<stbtt_fontinfo>(new stbtt_fontinfo);
+            if (stbtt_InitFont(_fontinfo.get(), monaco_bytes.data(), 0) == 0) {
+                throw std::runtime_error("loading the font failed");
+            }
+        }
+        int32_t ascent = 0;
+        int32_t descent = 0;
+        int32_t line_gap = 0;
+        stbtt_GetFontVMetrics(_fontinfo.get(), &ascent, &descent, &line_gap);
+        const auto scale = stbtt_ScaleForPixelHeight(_fontinfo.get(), font_size);
+        const auto timecode_string = timecode(frame_t).to_timecode_string();
+        int32_t width = 0;
+        int32_t height = 0;
+        for (std::size_t index = 0; index < timecode_string.size(); ++index) {
+            int32_t advance_width = 0;
+            int32_t left_side_bearing = 0;
+            stbtt_GetCodepointHMetrics(_fontinfo.get(), timecode_string[index], &advance_width, &left_side_bearing);
+            int32_t top = 0;
+            int32_t left = 0;
+            int32_t bottom = 0;
+            int32_t right = 0;
+            stbtt_GetCodepointBitmapBox(
+                _fontinfo.get(), timecode_string[index], scale, scale, &left, &top, &right, &bottom);
+            height = std::max(height, static_cast<int32_t>(std::roundf(ascent * scale)) + bottom);
+            width += static_cast<int32_t>(std::roundf(advance_width * scale));
+            if (index < timecode_string.size() - 1) {
+                width += static_cast<int32_t>(std::roundf(
+                    stbtt_GetCodepointKernAdvance(_fontinfo.get(), timecode_string[index], timecode_string[index + 1])
+                    * scale));
+            }
+        }
+        std::vector<uint8_t> bitmap(width * height);
+        int32_t x = 0;
+        for (std::size_t index = 0; index < timecode_string.size(); ++index) {
+            int32_t advance_width = 0;
+            int32_t left_side_bearing = 0;
+            stbtt_GetCodepointHMetrics(_fontinfo.get(), timecode_string[index], &advance_width, &left_side_bearing);
+            int32_t top = 0;
+            int32_t left = 0;
+            int32_t bottom = 0;
+            int32_t right = 0;
+            stbtt_GetCodepointBitmapBox(
+                _fontinfo.get(), timecode_string[index], scale, scale, &left, &top, &right, &bottom);
+            stbtt_MakeCodepointBitmap(
+                _fontinfo.get(),
+                bitmap.data() + x + static_cast<int32_t>(std::roundf(left_side_bearing * scale))
+                    + (static_cast<int32_t>(std::roundf(ascent * scale)) + top) * width,
+                right - left,
+                bottom - top,
+                width,
+                scale,
+                scale,
+                timecode_string[index]);
+            if (index < timecode_string.size() - 1) {
+                x += static_cast<int32_t>(std::roundf(advance_width * scale))
+                     + static_cast<int32_t>(std::roundf(
+                         stbtt_GetCodepointKernAdvance(
+                             _fontinfo.get(), timecode_string[index], timecode_string[index + 1])
+                         * scale));
+            }
+        }
+        for (int32_t y = 0; y < height; ++y) {
+            for (int32_t x = 0; x < width; ++x) {
+                const auto frame_x = x + left;
+                const auto frame_y = y + top;
+                if (frame_x >= 0 && frame_x < _width && frame_y >= 0 && frame_y < _height) {
+                    const auto index = (frame_x + frame_y * _width) * 3;
+                    const auto alpha = bitmap[x + y * width];
+                    _bytes[index] = _bytes[index] * (255 - alpha) / 255 + alpha;
+                    _bytes[index + 1] = _bytes[index + 1] * (255 - alpha) / 255 + alpha;
+                    _bytes[index + 2] = _bytes[index + 2] * (255 - alpha) / 255 + alpha;
+                }
+            }
+        }
+    }
+
+    virtual uint16_t width() const {
+        return _width;
+    }
+
+    virtual uint16_t height() const {
+        return _height;
+    }
+
+    virtual const std::vector<uint8_t>& bytes() const {
+        return _bytes;
+    }
+
+    virtual void swap_bytes(std::vector<uint8_t>& bytes) {
+        _bytes.swap(bytes);
+    }
+
+    protected:
+    /// paste_state paints the state of a cumulative style.
+    template <style decay_style>
+    void paste_state(
+        uint16_t width,
+        uint16_t height,
+        const state& style_state,
+        uint16_t x_offset,
+        uint16_t y_offset,
+        uint64_t tau,
+        color on_color,
+        color off_color,
+        color idle_color,
+        uint64_t frame_t,
+        float cumulative_ratio,
+        float lambda_maximum,
+        bool lambda_maximum_auto,
+        std::true_type) {
+        std::vector<std::pair<float, bool>> lambdas_and_ons(width * height);
+        _pool.run(height, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t index = begin * width; index < end * width; ++index) {
+                lambdas_and_ons[index] = kernel<decay_style>::lambda_and_on(style_state, index, frame_t, tau);
+            }
+        });
+        if (lambda_maximum_auto) {
+            std::vector<float> sorted_lambdas(lambdas_and_ons.size());
+            std::transform(
+                lambdas_and_ons.begin(),
+                lambdas_and_ons.end(),
+                sorted_lambdas.begin(),
+                [](const std::pair<float, bool> lambda_and_on) { return lambda_and_on.first; });
+            std::sort(sorted_lambdas.begin(), sorted_lambdas.end());
+            lambda_maximum = std::max(
+                1.0f,
+                sorted_lambdas[static_cast<std::size_t>((sorted_lambdas.size() - 1) * (1.0f - cumulative_ratio))]);
+        }
+        _pool.run(height, [&](std::size_t begin, std::size_t end) {
+            for (auto y = static_cast<uint16_t>(begin); y < end; ++y) {
+                paste_row(width, y, x_offset, y_offset, [&](uint16_t x) {
+                    const auto lambda_and_on = lambdas_and_ons[x + y * width];
+                    const auto scaled_lambda =
+                        lambda_and_on.first > lambda_maximum ? 1.0 : lambda_and_on.first / lambda_maximum;
+                    return color(
+                        idle_color.mix_r(lambda_and_on.second ? on_color : off_color, scaled_lambda),
+                        idle_color.mix_g(lambda_and_on.second ? on_color : off_color, scaled_lambda),
+                        idle_color.mix_b(lambda_and_on.second ? on_color : off_color, scaled_lambda));
+                });
+            }
+        });
+    }
+
+    /// paste_state paints the state of a style that depends on the last event of each pixel.
+    template <style decay_style>
+    void paste_state(
+        uint16_t width,
+        uint16_t height,
+        const state& style_state,
+        uint16_t x_offset,
+        uint16_t y_offset,
+        uint64_t tau,
+        color on_color,
+        color off_color,
+        color idle_color,
+        uint64_t frame_t,
+        float,
+        float,
+        bool,
+        std::false_type) {
+        _pool.run(height, [&](std::size_t begin, std::size_t end) {
+            for (auto y = static_cast<uint16_t>(begin); y < end; ++y) {
+                paste_row(width, y, x_offset, y_offset, [&](uint16_t x) {
+                    const auto index = x + y * width;
+                    const auto t = style_state.last_t(index);
+                    const auto lambda = t < no_wide_t ? kernel<decay_style>::lambda(t, frame_t, tau) : 0.0f;
+                    const auto on = style_state.is_on(index);
+                    return color(
+                        idle_color.mix_r(on ? on_color : off_color, lambda),
+                        idle_color.mix_g(on ? on_color : off_color, lambda),
+                        idle_color.mix_b(on ? on_color : off_color, lambda));
+                });
+            }
+        });
+    }
+
+    /// paste_row writes the colors of a row of pixels to the frame, scaled up.
+    /// The first output row is calculated, and copied to the scale - 1 rows below it.
+    template <typename XToColor>
+    void paste_row(uint16_t width, uint16_t y, uint16_t x_offset, uint16_t y_offset, XToColor x_to_color) {
+        const auto first_row = static_cast<std::size_t>(_height - _scale - (y + y_offset) * _scale);
+        const auto row_begin = std::next(_bytes.begin(), (first_row * _width + x_offset * _scale) * 3);
+        auto output = row_begin;
+        for (uint16_t x = 0; x < width; ++x) {
+            const auto pixel_color = x_to_color(x);
+            for (uint16_t x_scale = 0; x_scale < _scale; ++x_scale) {
+                *output = pixel_color.r;
+                *std::next(output) = pixel_color.g;
+                *std::next(output, 2) = pixel_color.b;
+                std::advance(output, 3);
+            }
+        }
+        for (uint16_t y_scale = 1; y_scale < _scale; ++y_scale) {
+            std::copy(row_begin, output, std::next(row_begin, y_scale * _width * 3));
+        }
+    }
+
+    const uint16_t _width;
+    const uint16_t _height;
+    const uint16_t _scale;
+    std::vector<uint8_t> _bytes;
+    std::unique_ptr<stbtt_fontinfo> _fontinfo;
+    pipeline::pool _pool;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/// indexed_filename inserts a zero-padded index before the extension of a filename.
+/// The index is padded to the width of count - 1, so that the generated filenames sort in index order.
+inline std::string indexed_filename(const std::string& filename, std::size_t index, std::size_t count) {
+    const auto digits = std::to_string(count > 0 ? count - 1 : 0).size();
+    auto index_string = std::to_string(index);
+    if (index_string.size() < digits) {
+        index_string.insert(0, digits - index_string.size(), '0');
+    }
+    const auto separator = filename.find_last_of("/\\");
+    const auto dot = filename.find_last_of('.');
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) {
+        return filename + "_" + index_string;
+    }
+    return filename.substr(0, dot) + "_" + index_string + filename.substr(dot);
+}
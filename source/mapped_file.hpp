@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// mapped_file exposes a read-only regular file as a contiguous range of bytes.
+class mapped_file {
+    public:
+    /// window_size is the number of bytes processed between two kernel hints.
+    /// It is a multiple of the 2 MiB huge page size, so that windows never split a huge page.
+    static constexpr std::size_t window_size = 1 << 24;
+
+    mapped_file(const uint8_t* data, std::size_t size) : _data(data), _size(size) {}
+    mapped_file(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file& operator=(mapped_file&& other) = delete;
+    virtual ~mapped_file() {
+#ifndef _WIN32
+        munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+    }
+
+    /// data returns a pointer to the first byte of the file.
+    virtual const uint8_t* data() const {
+        return _data;
+    }
+
+    /// size returns the file size in bytes.
+    virtual std::size_t size() const {
+        return _size;
+    }
+
+    /// read calls handle_bytes with consecutive windows of the range [begin, end).
+    /// The next window is prefetched while the current one is processed, and processed windows are released.
+    /// Window sizes are multiples of 4 bytes (except for the last one).
+    template <typename HandleBytes>
+    void read(std::size_t begin, std::size_t end, HandleBytes&& handle_bytes) const {
+        end = std::min(end, _size);
+        for (auto window_begin = begin; window_begin < end;) {
+            const auto window_end = std::min(end, window_begin + window_size);
+            advise(window_end, std::min(end, window_end + window_size), true);
+            handle_bytes(_data + window_begin, window_end - window_begin);
+            advise(window_begin, window_end, false);
+            window_begin = window_end;
+        }
+    }
+
+    protected:
+    /// advise tells the kernel that the range [begin, end) will be needed soon, or is not needed anymore.
+    virtual void advise(std::size_t begin, std::size_t end, bool will_need) const {
+#ifndef _WIN32
+        const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        begin = (begin / page_size) * page_size;
+        if (!will_need) {
+            end = (end / page_size) * page_size;
+        }
+        if (end > begin) {
+            madvise(const_cast<uint8_t*>(_data) + begin, end - begin, will_need ? MADV_WILLNEED : MADV_DONTNEED);
+        }
+#endif
+    }
+
+    const uint8_t* _data;
+    const std::size_t _size;
+};
+
+/// filename_to_mapped_file maps a regular file in memory.
+/// A null pointer is returned if the file is not a regular file (pipe, character device...),
+/// if the file is empty, or if memory mapping is not available on this platform.
+inline std::unique_ptr<mapped_file> filename_to_mapped_file(const std::string& filename) {
+#ifdef _WIN32
+    return nullptr;
+#else
+    const auto file_descriptor = open(filename.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(file_descriptor, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0) {
+        close(file_descriptor);
+        return nullptr;
+    }
+    const auto size = static_cast<std::size_t>(status.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    close(file_descriptor);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+    return std::unique_ptr<mapped_file>(new mapped_file(static_cast<const uint8_t*>(data), size));
+#endif
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+#include "../third_party/sepia/source/sepia.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// npy reads and writes NumPy arrays (https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html).
+namespace npy {
+    /// magic_number is written at the beginning of npy files.
+    constexpr const char* magic_number = "\x93NUMPY";
+
+    /// alignment is the size multiple of the npy preamble (magic number, version and header).
+    constexpr std::size_t alignment = 64;
+
+    /// is_little_endian returns true if the host stores integers in little endian.
+    inline bool is_little_endian() {
+        const uint16_t probe = 1;
+        uint8_t first_byte;
+        std::memcpy(&first_byte, &probe, 1);
+        return first_byte == 1;
+    }
+
+    /// descriptor returns the NumPy type descriptor of a type, in host byte order.
+    template <typename Type>
+    inline std::string descriptor();
+    template <>
+    inline std::string descriptor<bool>() {
+        return "|b1";
+    }
+    template <>
+    inline std::string descriptor<uint8_t>() {
+        return "|u1";
+    }
+    template <>
+    inline std::string descriptor<uint16_t>() {
+        return is_little_endian() ? "<u2" : ">u2";
+    }
+    template <>
+    inline std::string descriptor<uint64_t>() {
+        return is_little_endian() ? "<u8" : ">u8";
+    }
+    template <>
+    inline std::string descriptor<double>() {
+        return is_little_endian() ? "<f8" : ">f8";
+    }
+
+    /// field represents a named NumPy scalar.
+    struct field {
+        std::string name;
+        std::string descriptor;
+        std::size_t size;
+    };
+
+    /// make_field creates a field from a C++ type.
+    template <typename Type>
+    inline field make_field(const std::string& name) {
+        return {name, descriptor<Type>(), sizeof(Type)};
+    }
+
+    /// fields_to_descriptor returns the NumPy descriptor of an item.
+    /// A single unnamed field yields a scalar descriptor, otherwise the descriptor is structured.
+    inline std::string fields_to_descriptor(const std::vector<field>& fields, bool structured) {
+        if (!structured && fields.size() == 1) {
+            return "'" + fields.front().descriptor + "'";
+        }
+        std::string result("[");
+        for (std::size_t index = 0; index < fields.size(); ++index) {
+            if (index > 0) {
+                result.append(", ");
+            }
+            result.append("('" + fields[index].name + "', '" + fields[index].descriptor + "')");
+        }
+        result.append("]");
+        return result;
+    }
+
+    /// header_to_preamble pads a header, and prepends the magic number, version and header size.
+    /// reserved extra characters are included in the padding, so that the header can grow later without moving data.
+    inline std::string header_to_preamble(std::string header, std::size_t reserved) {
+        const auto padded_size = ((10 + header.size() + reserved + 1 + alignment - 1) / alignment) * alignment - 10;
+        header.append(padded_size - header.size() - 1, ' ');
+        header.push_back('\n');
+        std::string result(magic_number);
+        result.push_back(1);
+        result.push_back(0);
+        result.push_back(static_cast<char>(padded_size & 0xff));
+        result.push_back(static_cast<char>((padded_size >> 8) & 0xff));
+        result.append(header);
+        return result;
+    }
+
+    /// preamble returns the magic number, version and header of a one-dimensional array.
+    /// The header is padded as if the shape had 20 digits, so that its size does not depend on the number of items.
+    inline std::string preamble(const std::string& descriptor, uint64_t items) {
+        const auto items_string = std::to_string(items);
+        return header_to_preamble(
+            "{'descr': " + descriptor + ", 'fortran_order': False, 'shape': (" + items_string + ",), }",
+            20 - items_string.size());
+    }
+
+    /// write_array creates a npy file with the given shape (C order) from packed scalars in host byte order.
+    inline void write_array(
+        const std::string& filename,
+        const std::string& scalar_descriptor,
+        const std::vector<uint64_t>& shape,
+        const std::vector<uint8_t>& bytes) {
+        std::string shape_string;
+        for (std::size_t index = 0; index < shape.size(); ++index) {
+            if (index > 0) {
+                shape_string.append(", ");
+            }
+            shape_string.append(std::to_string(shape[index]));
+        }
+        if (shape.size() == 1) {
+            shape_string.push_back(',');
+        }
+        const auto header = header_to_preamble(
+            "{'descr': '" + scalar_descriptor + "', 'fortran_order': False, 'shape': (" + shape_string + "), }", 0);
+        std::ofstream stream(filename, std::ofstream::out | std::ofstream::binary);
+        if (!stream.good()) {
+            throw sepia::unwritable_file(filename);
+        }
+        stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+        stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        stream.close();
+        if (stream.fail()) {
+            throw sepia::unwritable_file(filename);
+        }
+    }
+
+    /// writer creates a one-dimensional npy file with an unknown number of items.
+    /// The header is written with a placeholder shape, and overwritten by close once all the items are known.
+    class writer {
+        public:
+        writer(const std::string& filename, const std::vector<field>& fields, bool structured) :
+            _filename(filename),
+            _stream(filename, std::ofstream::out | std::ofstream::binary),
+            _descriptor(fields_to_descriptor(fields, structured)),
+            _item_size(0),
+            _items(0),
+            _closed(false) {
+            if (!_stream.good()) {
+                throw sepia::unwritable_file(filename);
+            }
+            for (const auto& item_field : fields) {
+                _item_size += item_field.size;
+            }
+            const auto header = preamble(_descriptor, 0);
+            _stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+        }
+        writer(const writer&) = delete;
+        writer(writer&& other) = delete;
+        writer& operator=(const writer&) = delete;
+        writer& operator=(writer&& other) = delete;
+        virtual ~writer() {
+            if (!_closed) {
+                try {
+                    close();
+                } catch (...) {
+                }
+            }
+        }
+
+        /// write appends packed items in host byte order.
+        void write(const std::vector<uint8_t>& bytes) {
+            _stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            _items += bytes.size() / _item_size;
+        }
+
+        /// close writes the final shape and closes the file.
+        void close() {
+            _closed = true;
+            const auto header = preamble(_descriptor, _items);
+            _stream.seekp(0);
+            _stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+            _stream.close();
+            if (_stream.fail()) {
+                throw sepia::unwritable_file(_filename);
+            }
+        }
+
+        protected:
+        const std::string _filename;
+        std::ofstream _stream;
+        const std::string _descriptor;
+        std::size_t _item_size;
+        uint64_t _items;
+        bool _closed;
+    };
+
+    /// column reads the values of a field in an array mapped in memory.
+    /// Integers of any size and sign, and booleans, are converted to uint64_t. Negative values are rejected.
+    class column {
+        public:
+        column(const uint8_t* data, std::size_t stride, const field& column_field) :
+            _data(data), _stride(stride), _size(column_field.size), _is_signed(false), _swap(false) {
+            if (column_field.descriptor.size() < 3) {
+                throw std::runtime_error("unsupported npy descriptor '" + column_field.descriptor + "'");
+            }
+            const auto byte_order = column_field.descriptor[0];
+            const auto kind = column_field.descriptor[1];
+            if (kind == 'i') {
+                _is_signed = true;
+            } else if (kind != 'u' && !(kind == 'b' && _size == 1)) {
+                throw std::runtime_error(
+                    "unsupported npy descriptor '" + column_field.descriptor + "' (expected an integer or a boolean)");
+            }
+            if (_size != 1 && _size != 2 && _size != 4 && _size != 8) {
+                throw std::runtime_error("unsupported npy descriptor '" + column_field.descriptor + "'");
+            }
+            _swap = _size > 1
+                    && ((byte_order == '<' && !is_little_endian()) || (byte_order == '>' && is_little_endian()));
+        }
+
+        /// operator[] returns the value of an item.
+        uint64_t operator[](uint64_t index) const {
+            uint8_t bytes[8];
+            std::memcpy(bytes, _data + index * _stride, _size);
+            if (_swap) {
+                std::reverse(bytes, bytes + _size);
+            }
+            switch (_size) {
+                case 1: {
+                    if (_is_signed && (bytes[0] & 0x80) != 0) {
+                        throw std::runtime_error("negative values are not supported");
+                    }
+                    return bytes[0];
+                }
+                case 2: {
+                    uint16_t value_16;
+                    std::memcpy(&value_16, bytes, 2);
+                    if (_is_signed && (value_16 & 0x8000) != 0) {
+                        throw std::runtime_error("negative values are not supported");
+                    }
+                    return value_16;
+                }
+                case 4: {
+                    uint32_t value_32;
+                    std::memcpy(&value_32, bytes, 4);
+                    if (_is_signed && (value_32 & 0x80000000u) != 0) {
+                        throw std::runtime_error("negative values are not supported");
+                    }
+                    return value_32;
+                }
+                default: {
+                    uint64_t value;
+                    std::memcpy(&value, bytes, 8);
+                    if (_is_signed && (value >> 63) != 0) {
+                        throw std::runtime_error("negative values are not supported");
+                    }
+                    return value;
+                }
+            }
+        }
+
+        protected:
+        const uint8_t* _data;
+        const std::size_t _stride;
+        const std::size_t _size;
+        bool _is_signed;
+        bool _swap;
+    };
+
+    /// array describes a one-dimensional npy array stored in memory.
+    struct array {
+        std::vector<field> fields;
+        std::vector<std::size_t> offsets;
+        std::size_t item_size;
+        uint64_t items;
+        const uint8_t* data;
+
+        /// make_column returns a reader for the field with the given name.
+        /// A scalar array has a single field named after the empty string.
+        column make_column(const std::string& name) const {
+            for (std::size_t index = 0; index < fields.size(); ++index) {
+                if (fields[index].name == name) {
+                    return column(data + offsets[index], item_size, fields[index]);
+                }
+            }
+            throw std::runtime_error("the npy array has no field '" + name + "'");
+        }
+
+        /// has_field returns true if the array has a field with the given name.
+        bool has_field(const std::string& name) const {
+            for (const auto& array_field : fields) {
+                if (array_field.name == name) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    /// skip_spaces moves position to the next non-space character.
+    inline void skip_spaces(const std::string& header, std::size_t& position) {
+        while (position < header.size() && std::isspace(static_cast<uint8_t>(header[position]))) {
+            ++position;
+        }
+    }
+
+    /// parse_string parses a quoted Python string, and moves position after the closing quote.
+    inline std::string parse_string(const std::string& header, std::size_t& position) {
+        skip_spaces(header, position);
+        if (position >= header.size() || (header[position] != '\'' && header[position] != '"')) {
+            throw std::runtime_error("unsupported npy header '" + header + "'");
+        }
+        const auto quote = header[position];
+        const auto end = header.find(quote, position + 1);
+        if (end == std::string::npos) {
+            throw std::runtime_error("unsupported npy header '" + header + "'");
+        }
+        const auto result = header.substr(position + 1, end - position - 1);
+        position = end + 1;
+        return result;
+    }
+
+    /// descriptor_to_size returns the size in bytes of a scalar descriptor (for example, 8 for '<u8').
+    inline std::size_t descriptor_to_size(const std::string& scalar_descriptor) {
+        if (scalar_descriptor.size() < 3
+            || !std::all_of(scalar_descriptor.begin() + 2, scalar_descriptor.end(), [](char character) {
+                   return std::isdigit(static_cast<uint8_t>(character));
+               })) {
+            throw std::runtime_error("unsupported npy descriptor '" + scalar_descriptor + "'");
+        }
+        return static_cast<std::size_t>(std::stoull(scalar_descriptor.substr(2)));
+    }
+
+    /// parse reads the preamble of a npy file stored in memory, and returns a description of its array.
+    /// The data is not copied, hence the memory must outlive the array.
+    inline array parse(const uint8_t* data, std::size_t size) {
+        const auto magic_number_size = std::char_traits<char>::length(magic_number);
+        if (size < magic_number_size + 4 || std::memcmp(data, magic_number, magic_number_size) != 0) {
+            throw std::runtime_error("the file is not a npy file");
+        }
+        const auto major_version = data[magic_number_size];
+        std::size_t header_offset = magic_number_size + 4;
+        std::size_t header_size = static_cast<std::size_t>(data[magic_number_size + 2])
+                                  | (static_cast<std::size_t>(data[magic_number_size + 3]) << 8);
+        if (major_version >= 2) {
+            if (size < magic_number_size + 6) {
+                throw std::runtime_error("the npy header is truncated");
+            }
+            header_offset += 2;
+            header_size |= (static_cast<std::size_t>(data[magic_number_size + 4]) << 16)
+                           | (static_cast<std::size_t>(data[magic_number_size + 5]) << 24);
+        }
+        if (header_offset + header_size > size) {
+            throw std::runtime_error("the npy header is truncated");
+        }
+        const std::string header(reinterpret_cast<const char*>(data + header_offset), header_size);
+        array result;
+        result.item_size = 0;
+        {
+            auto position = header.find("'descr':");
+            if (position == std::string::npos) {
+                throw std::runtime_error("unsupported npy header '" + header + "'");
+            }
+            position += 8;
+            skip_spaces(header, position);
+            if (position < header.size() && header[position] == '[') {
+                ++position;
+                for (;;) {
+                    skip_spaces(header, position);
+                    if (position < header.size() && header[position] == ',') {
+                        ++position;
+                        skip_spaces(header, position);
+                    }
+                    if (position >= header.size() || header[position] != '(') {
+                        break;
+                    }
+                    ++position;
+                    const auto name = parse_string(header, position);
+                    skip_spaces(header, position);
+                    if (position >= header.size() || header[position] != ',') {
+                        throw std::runtime_error("unsupported npy header '" + header + "'");
+                    }
+                    ++position;
+                    const auto field_descriptor = parse_string(header, position);
+                    skip_spaces(header, position);
+                    if (position >= header.size() || header[position] != ')') {
+                        throw std::runtime_error("unsupported npy header '" + header + "' (nested fields)");
+                    }
+                    ++position;
+                    result.fields.push_back({name, field_descriptor, descriptor_to_size(field_descriptor)});
+                }
+                if (position >= header.size() || header[position] != ']') {
+                    throw std::runtime_error("unsupported npy header '" + header + "'");
+                }
+            } else {
+                const auto field_descriptor = parse_string(header, position);
+                result.fields.push_back({"", field_descriptor, descriptor_to_size(field_descriptor)});
+            }
+        }
+        for (const auto& array_field : result.fields) {
+            result.offsets.push_back(result.item_size);
+            result.item_size += array_field.size;
+        }
+        if (header.find("'fortran_order': True") != std::string::npos) {
+            throw std::runtime_error("Fortran-ordered npy arrays are not supported");
+        }
+        {
+            auto position = header.find("'shape':");
+            if (position == std::string::npos) {
+                throw std::runtime_error("unsupported npy header '" + header + "'");
+            }
+            position = header.find('(', position);
+            const auto end = header.find(')', position);
+            if (position == std::string::npos || end == std::string::npos) {
+                throw std::runtime_error("unsupported npy header '" + header + "'");
+            }
+            std::string shape;
+            for (auto character : header.substr(position + 1, end - position - 1)) {
+                if (!std::isspace(static_cast<uint8_t>(character))) {
+                    shape.push_back(character);
+                }
+            }
+            if (shape.empty() || shape.back() != ',' || shape.find(',') != shape.size() - 1
+                || !std::all_of(shape.begin(), shape.end() - 1, [](char character) {
+                       return std::isdigit(static_cast<uint8_t>(character));
+                   })) {
+                throw std::runtime_error("only one-dimensional npy arrays are supported");
+            }
+            result.items = std::stoull(shape.substr(0, shape.size() - 1));
+        }
+        result.data = data + header_offset + header_size;
+        if (result.item_size == 0 || result.items > (size - header_offset - header_size) / result.item_size) {
+            throw std::runtime_error("the npy data is truncated");
+        }
+        return result;
+    }
+
+    /// append copies a value at the end of a byte buffer, in host byte order.
+    template <typename Type>
+    inline void append(std::vector<uint8_t>& bytes, Type value) {
+        const auto size = bytes.size();
+        bytes.resize(size + sizeof(Type));
+        std::memcpy(bytes.data() + size, &value, sizeof(Type));
+    }
+}
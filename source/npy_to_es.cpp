@@ -0,0 +1,245 @@
+#include "../third_party/pontella/source/pontella.hpp"
+#include "../third_party/sepia/source/sepia.hpp"
+#include "mapped_file.hpp"
+#include "npy.hpp"
+#include <algorithm>
+#include <array>
+
+/// maximum_fields is the largest number of fields in a supported event type.
+constexpr std::size_t maximum_fields = 6;
+
+/// item_error creates an exception that points to an item of the input.
+inline std::runtime_error item_error(uint64_t index, const std::string& message) {
+    return std::runtime_error("item " + std::to_string(index) + ": " + message);
+}
+
+/// event_names returns the names of the fields of an event type, in order.
+inline std::vector<std::string> event_names(sepia::type event_stream_type) {
+    switch (event_stream_type) {
+        case sepia::type::generic:
+            break;
+        case sepia::type::dvs:
+            return {"t", "x", "y", "is_increase"};
+        case sepia::type::atis:
+            return {"t", "x", "y", "is_threshold_crossing", "polarity"};
+        case sepia::type::color:
+            return {"t", "x", "y", "r", "g", "b"};
+    }
+    throw std::runtime_error("Unsupported event type: generic");
+}
+
+/// values_to_event converts the values of an item to an event, and checks their range.
+template <sepia::type event_stream_type>
+sepia::event<event_stream_type> values_to_event(const std::array<uint64_t, maximum_fields>& values, uint64_t index);
+template <>
+sepia::dvs_event values_to_event<sepia::type::dvs>(const std::array<uint64_t, maximum_fields>& values, uint64_t index) {
+    if (values[3] > 1) {
+        throw item_error(index, "is_increase must be 0 or 1");
+    }
+    return {values[0], static_cast<uint16_t>(values[1]), static_cast<uint16_t>(values[2]), values[3] == 1};
+}
+template <>
+sepia::atis_event
+values_to_event<sepia::type::atis>(const std::array<uint64_t, maximum_fields>& values, uint64_t index) {
+    if (values[3] > 1 || values[4] > 1) {
+        throw item_error(index, "is_threshold_crossing and polarity must be 0 or 1");
+    }
+    return {
+        values[0],
+        static_cast<uint16_t>(values[1]),
+        static_cast<uint16_t>(values[2]),
+        values[3] == 1,
+        values[4] == 1,
+    };
+}
+template <>
+sepia::color_event
+values_to_event<sepia::type::color>(const std::array<uint64_t, maximum_fields>& values, uint64_t index) {
+    if (values[3] > 255 || values[4] > 255 || values[5] > 255) {
+        throw item_error(index, "r, g and b must be in the range [0, 255]");
+    }
+    return {
+        values[0],
+        static_cast<uint16_t>(values[1]),
+        static_cast<uint16_t>(values[2]),
+        static_cast<uint8_t>(values[3]),
+        static_cast<uint8_t>(values[4]),
+        static_cast<uint8_t>(values[5]),
+    };
+}
+
+/// npy_to_es reads the columns of mapped npy arrays, checks them, and writes the events.
+/// If width or height is zero, a first pass over the x and y columns calculates the sensor size.
+template <sepia::type event_stream_type>
+void npy_to_es(
+    const std::vector<npy::column>& columns,
+    uint64_t items,
+    uint16_t width,
+    uint16_t height,
+    const std::string& output) {
+    if (width == 0 || height == 0) {
+        uint64_t maximum_x = 0;
+        uint64_t maximum_y = 0;
+        for (uint64_t index = 0; index < items; ++index) {
+            maximum_x = std::max(maximum_x, columns[1][index]);
+            maximum_y = std::max(maximum_y, columns[2][index]);
+        }
+        if (width == 0) {
+            width = static_cast<uint16_t>(std::min(maximum_x + 1, uint64_t(std::numeric_limits<uint16_t>::max())));
+        }
+        if (height == 0) {
+            height = static_cast<uint16_t>(std::min(maximum_y + 1, uint64_t(std::numeric_limits<uint16_t>::max())));
+        }
+    }
+    sepia::write<event_stream_type> write(sepia::filename_to_ofstream(output), width, height);
+    std::array<uint64_t, maximum_fields> values;
+    uint64_t previous_t = 0;
+    for (uint64_t index = 0; index < items; ++index) {
+        for (std::size_t field_index = 0; field_index < columns.size(); ++field_index) {
+            values[field_index] = columns[field_index][index];
+        }
+        if (values[1] >= width || values[2] >= height) {
+            throw item_error(index, "the coordinates are out of the sensor's scope");
+        }
+        const auto event = values_to_event<event_stream_type>(values, index);
+        if (event.t < previous_t) {
+            throw item_error(index, "the timestamp is smaller than the previous one");
+        }
+        previous_t = event.t;
+        write(event);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    return pontella::main(
+        {"npy_to_es converts NumPy arrays (in the format generated by es_to_npy) into an Event Stream file",
+         "    If the input is a file, it must contain a structured array. Otherwise, the input is used",
+         "    as a prefix to find one array per field (for example, /path/to/input_t.npy, /path/to/input_x.npy...).",
+         "    The event type is determined by the fields (t, x, y, is_increase for DVS events,",
+         "    t, x, y, is_threshold_crossing, polarity for ATIS events and t, x, y, r, g, b for color events).",
+         "Syntax: ./npy_to_es [options] /path/to/input /path/to/output.es",
+         "Available options:",
+         "    -x size, --width size     sets the sensor width in pixels",
+         "                                  defaults to the largest x plus one",
+         "    -y size, --height size    sets the sensor height in pixels",
+         "                                  defaults to the largest y plus one",
+         "    -h, --help                shows this help message"},
+        argc,
+        argv,
+        2,
+        {
+            {"width", {"x"}},
+            {"height", {"y"}},
+        },
+        {},
+        [](pontella::command command) {
+            if (command.arguments[0] == command.arguments[1]) {
+                throw std::runtime_error("The npy input and the Event Stream output must be different files");
+            }
+            uint16_t width = 0;
+            {
+                const auto name_and_argument = command.options.find("width");
+                if (name_and_argument != command.options.end()) {
+                    width = static_cast<uint16_t>(std::stoull(name_and_argument->second));
+                    if (width == 0) {
+                        throw std::runtime_error("width must be larger than 0");
+                    }
+                }
+            }
+            uint16_t height = 0;
+            {
+                const auto name_and_argument = command.options.find("height");
+                if (name_and_argument != command.options.end()) {
+                    height = static_cast<uint16_t>(std::stoull(name_and_argument->second));
+                    if (height == 0) {
+                        throw std::runtime_error("height must be larger than 0");
+                    }
+                }
+            }
+            std::vector<std::unique_ptr<mapped_file>> files;
+            std::vector<npy::array> arrays;
+            std::vector<std::string> names;
+            {
+                auto file = filename_to_mapped_file(command.arguments[0]);
+                if (file) {
+                    arrays.push_back(npy::parse(file->data(), file->size()));
+                    files.push_back(std::move(file));
+                    for (const auto& array_field : arrays.front().fields) {
+                        names.push_back(array_field.name);
+                    }
+                } else {
+                    auto prefix = command.arguments[0];
+                    if (prefix.size() > 4 && prefix.compare(prefix.size() - 4, 4, ".npy") == 0) {
+                        prefix.resize(prefix.size() - 4);
+                    }
+                    for (const std::string name :
+                         {"t", "x", "y", "is_increase", "is_threshold_crossing", "polarity", "r", "g", "b"}) {
+                        auto field_file = filename_to_mapped_file(prefix + "_" + name + ".npy");
+                        if (field_file) {
+                            arrays.push_back(npy::parse(field_file->data(), field_file->size()));
+                            if (arrays.back().fields.size() != 1) {
+                                throw std::runtime_error(prefix + "_" + name + ".npy must contain a scalar array");
+                            }
+                            arrays.back().fields.front().name = name;
+                            files.push_back(std::move(field_file));
+                            names.push_back(name);
+                        }
+                    }
+                    if (files.empty()) {
+                        throw std::runtime_error(
+                            command.arguments[0] + " is neither a npy file nor the prefix of npy files");
+                    }
+                }
+            }
+            const auto has_name = [&](const std::string& name) {
+                return std::find(names.begin(), names.end(), name) != names.end();
+            };
+            std::vector<sepia::type> candidates;
+            std::string candidates_names;
+            for (const auto& type_and_name :
+                 std::vector<std::pair<sepia::type, std::string>>{
+                     {sepia::type::dvs, "DVS"}, {sepia::type::atis, "ATIS"}, {sepia::type::color, "color"}}) {
+                const auto names_of_type = event_names(type_and_name.first);
+                if (std::any_of(std::next(names_of_type.begin(), 3), names_of_type.end(), has_name)) {
+                    candidates.push_back(type_and_name.first);
+                    candidates_names += (candidates_names.empty() ? "" : ", ") + type_and_name.second;
+                }
+            }
+            if (candidates.empty()) {
+                throw std::runtime_error("the npy fields do not match a DVS, ATIS or color event type");
+            }
+            if (candidates.size() > 1) {
+                throw std::runtime_error("the npy fields match several event types (" + candidates_names + ")");
+            }
+            const auto event_stream_type = candidates.front();
+            std::vector<npy::column> columns;
+            uint64_t items = 0;
+            for (const auto& name : event_names(event_stream_type)) {
+                const auto array_and_name = std::find_if(arrays.begin(), arrays.end(), [&](const npy::array& array) {
+                    return array.has_field(name);
+                });
+                if (array_and_name == arrays.end()) {
+                    throw std::runtime_error("the npy input has no field '" + name + "'");
+                }
+                if (columns.empty()) {
+                    items = array_and_name->items;
+                } else if (array_and_name->items != items) {
+                    throw std::runtime_error("the npy arrays have different lengths");
+                }
+                columns.push_back(array_and_name->make_column(name));
+            }
+            switch (event_stream_type) {
+                case sepia::type::generic:
+                    break;
+                case sepia::type::dvs:
+                    npy_to_es<sepia::type::dvs>(columns, items, width, height, command.arguments[1]);
+                    break;
+                case sepia::type::atis:
+                    npy_to_es<sepia::type::atis>(columns, items, width, height, command.arguments[1]);
+                    break;
+                case sepia::type::color:
+                    npy_to_es<sepia::type::color>(columns, items, width, height, command.arguments[1]);
+                    break;
+            }
+        });
+}
@@ -0,0 +1,450 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace pipeline {
+    /// block_size is the default number of items in a block passed between two stages.
+    constexpr std::size_t block_size = 1 << 16;
+
+    /// default_depth is the default number of blocks buffered between two stages.
+    constexpr std::size_t default_depth = 4;
+
+    /// statistics counts the blocks passed through a ring, and the waits caused by back-pressure.
+    struct statistics {
+        std::size_t depth;
+        std::size_t blocks;
+        std::size_t producer_waits;
+        std::size_t consumer_waits;
+    };
+
+    /// operator<< prints statistics in human-readable form.
+    inline std::ostream& operator<<(std::ostream& stream, const statistics& ring_statistics) {
+        return stream << ring_statistics.blocks << " blocks through a queue of depth " << ring_statistics.depth
+                      << ", the producer waited " << ring_statistics.producer_waits
+                      << " times (queue full), the consumer waited " << ring_statistics.consumer_waits
+                      << " times (queue empty)";
+    }
+
+    /// wait backs off while a ring is full or empty.
+    /// It yields first, and sleeps once the wait lasts, so that an idle stage does not hog a core.
+    inline void wait(std::size_t& iteration) {
+        if (iteration < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        ++iteration;
+    }
+
+    /// ring passes blocks of items from a single producer thread to a single consumer thread, without locks.
+    /// push waits while the ring holds depth blocks, hence a slow consumer throttles the producer.
+    template <typename Item>
+    class ring {
+        public:
+        ring(std::size_t depth) :
+            _slots(std::max(depth, static_cast<std::size_t>(1)) + 1),
+            _head(0),
+            _tail(0),
+            _closed(false),
+            _cancelled(false),
+            _blocks(0),
+            _producer_waits(0),
+            _consumer_waits(0) {}
+        ring(const ring&) = delete;
+        ring(ring&& other) = delete;
+        ring& operator=(const ring&) = delete;
+        ring& operator=(ring&& other) = delete;
+        virtual ~ring() {}
+
+        /// push appends a block, and returns false if the ring was cancelled.
+        /// It must only be called by the producer thread.
+        bool push(std::vector<Item>&& block) {
+            const auto tail = _tail.load(std::memory_order_relaxed);
+            const auto next_tail = (tail + 1) % _slots.size();
+            if (next_tail == _head.load(std::memory_order_acquire)) {
+                _producer_waits.fetch_add(1, std::memory_order_relaxed);
+                for (std::size_t iteration = 0; next_tail == _head.load(std::memory_order_acquire);) {
+                    if (_cancelled.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                    wait(iteration);
+                }
+            }
+            _slots[tail] = std::move(block);
+            _tail.store(next_tail, std::memory_order_release);
+            _blocks.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /// close signals that the producer will not push any more blocks.
+        void close() {
+            _closed.store(true, std::memory_order_release);
+        }
+
+        /// pop retrieves the oldest block, and returns false once the ring is closed and empty, or cancelled.
+        /// It must only be called by the consumer thread.
+        bool pop(std::vector<Item>& block) {
+            const auto head = _head.load(std::memory_order_relaxed);
+            if (head == _tail.load(std::memory_order_acquire)) {
+                _consumer_waits.fetch_add(1, std::memory_order_relaxed);
+                for (std::size_t iteration = 0; head == _tail.load(std::memory_order_acquire);) {
+                    if (_cancelled.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                    if (_closed.load(std::memory_order_acquire)) {
+                        if (head == _tail.load(std::memory_order_acquire)) {
+                            return false;
+                        }
+                        break;
+                    }
+                    wait(iteration);
+                }
+            }
+            if (_cancelled.load(std::memory_order_acquire)) {
+                return false;
+            }
+            block = std::move(_slots[head]);
+            _head.store((head + 1) % _slots.size(), std::memory_order_release);
+            return true;
+        }
+
+        /// cancel releases both threads, and makes subsequent calls to push and pop fail.
+        void cancel() {
+            _cancelled.store(true, std::memory_order_release);
+        }
+
+        /// ring_statistics returns the number of blocks pushed so far, and the number of waits on either side.
+        statistics ring_statistics() const {
+            return {
+                _slots.size() - 1,
+                _blocks.load(std::memory_order_relaxed),
+                _producer_waits.load(std::memory_order_relaxed),
+                _consumer_waits.load(std::memory_order_relaxed),
+            };
+        }
+
+        protected:
+        std::vector<std::vector<Item>> _slots;
+        std::atomic<std::size_t> _head;
+        std::atomic<std::size_t> _tail;
+        std::atomic<bool> _closed;
+        std::atomic<bool> _cancelled;
+        std::atomic<std::size_t> _blocks;
+        std::atomic<std::size_t> _producer_waits;
+        std::atomic<std::size_t> _consumer_waits;
+    };
+
+    /// exchange passes blocks from a producer thread to a consumer thread, and recycles them once consumed.
+    /// depth blocks are copied from a model block on construction and no other block is ever created,
+    /// hence memory is bounded, allocations are reused, and a slow consumer throttles the producer.
+    template <typename Item>
+    class exchange {
+        public:
+        exchange(std::size_t depth, const std::vector<Item>& block) : _full(depth), _empty(depth) {
+            for (std::size_t index = 0; index < std::max(depth, static_cast<std::size_t>(1)); ++index) {
+                _empty.push(std::vector<Item>(block));
+            }
+        }
+        exchange(const exchange&) = delete;
+        exchange(exchange&& other) = delete;
+        exchange& operator=(const exchange&) = delete;
+        exchange& operator=(exchange&& other) = delete;
+        virtual ~exchange() {}
+
+        /// acquire retrieves a recycled block, and returns false if the exchange was cancelled.
+        /// It must only be called by the producer thread.
+        bool acquire(std::vector<Item>& block) {
+            return _empty.pop(block);
+        }
+
+        /// push passes a block to the consumer, and returns false if the exchange was cancelled.
+        /// It must only be called by the producer thread.
+        bool push(std::vector<Item>&& block) {
+            return _full.push(std::move(block));
+        }
+
+        /// close signals that the producer will not push any more blocks.
+        void close() {
+            _full.close();
+        }
+
+        /// pop retrieves the oldest block, and returns false once the exchange is closed and empty, or cancelled.
+        /// It must only be called by the consumer thread.
+        bool pop(std::vector<Item>& block) {
+            return _full.pop(block);
+        }
+
+        /// release gives a consumed block back to the producer, and returns false if the exchange was cancelled.
+        /// It must only be called by the consumer thread.
+        bool release(std::vector<Item>&& block) {
+            return _empty.push(std::move(block));
+        }
+
+        /// cancel releases both threads, and makes subsequent calls fail.
+        void cancel() {
+            _full.cancel();
+            _empty.cancel();
+        }
+
+        /// ring_statistics returns the number of blocks pushed so far, the number of times the producer waited
+        /// for a recycled block, and the number of times the consumer waited for a block.
+        statistics ring_statistics() const {
+            const auto full_statistics = _full.ring_statistics();
+            return {
+                full_statistics.depth,
+                full_statistics.blocks,
+                _empty.ring_statistics().consumer_waits,
+                full_statistics.consumer_waits,
+            };
+        }
+
+        protected:
+        ring<Item> _full;
+        ring<Item> _empty;
+    };
+
+    /// stage runs a function on a dedicated thread, and rethrows its exception (if any) when joined.
+    class stage {
+        public:
+        template <typename Function>
+        stage(Function function) :
+            _thread([this, function]() {
+                try {
+                    function();
+                } catch (...) {
+                    _exception = std::current_exception();
+                }
+            }) {}
+        stage(const stage&) = delete;
+        stage(stage&& other) = delete;
+        stage& operator=(const stage&) = delete;
+        stage& operator=(stage&& other) = delete;
+        virtual ~stage() {
+            if (_thread.joinable()) {
+                _thread.join();
+            }
+        }
+
+        /// join waits for the function to return, and rethrows its exception.
+        void join() {
+            if (_thread.joinable()) {
+                _thread.join();
+            }
+            if (_exception) {
+                std::rethrow_exception(_exception);
+            }
+        }
+
+        protected:
+        std::exception_ptr _exception;
+        std::thread _thread;
+    };
+
+    /// has_spare_core returns true if the machine has at least two hardware cores.
+    /// A dedicated thread on a single core only adds synchronization to the work.
+    inline bool has_spare_core() {
+        return std::thread::hardware_concurrency() >= 2;
+    }
+
+    /// writer calls handle_event on a dedicated thread, so that encoding and writing overlap with decoding.
+    /// Events are buffered in blocks, and at most depth blocks wait for the writer thread.
+    /// If threaded is false, handle_event is called directly on the calling thread.
+    /// close must be called once all the events have been passed, it rethrows the writer thread's exception (if any).
+    template <typename Event, typename HandleEvent>
+    class writer {
+        public:
+        writer(HandleEvent handle_event, std::size_t depth, bool threaded = has_spare_core()) :
+            _handle_event(std::move(handle_event)),
+            _ring(depth),
+            _closed(!threaded) {
+            if (threaded) {
+                _events.reserve(block_size);
+                _stage.reset(new stage([this]() {
+                    try {
+                        std::vector<Event> events;
+                        while (_ring.pop(events)) {
+                            for (const auto& event : events) {
+                                _handle_event(event);
+                            }
+                        }
+                    } catch (...) {
+                        _ring.cancel();
+                        throw;
+                    }
+                }));
+            }
+        }
+        writer(const writer&) = delete;
+        writer(writer&& other) = delete;
+        writer& operator=(const writer&) = delete;
+        writer& operator=(writer&& other) = delete;
+        virtual ~writer() {
+            if (!_closed) {
+                _ring.cancel();
+            }
+        }
+
+        /// operator() buffers an event.
+        void operator()(const Event& event) {
+            if (!_stage) {
+                _handle_event(event);
+                return;
+            }
+            _events.push_back(event);
+            if (_events.size() == block_size) {
+                flush();
+            }
+        }
+
+        /// close sends the buffered events and waits for the writer thread.
+        void close() {
+            if (!_stage) {
+                return;
+            }
+            if (!_events.empty()) {
+                flush();
+            }
+            _ring.close();
+            _closed = true;
+            _stage->join();
+        }
+
+        /// ring_statistics returns the back-pressure statistics of the writer's ring.
+        statistics ring_statistics() const {
+            return _ring.ring_statistics();
+        }
+
+        protected:
+        /// flush sends the buffered events to the writer thread.
+        void flush() {
+            if (!_ring.push(std::move(_events))) {
+                _closed = true;
+                _stage->join();
+                throw std::runtime_error("the writer stopped");
+            }
+            _events = std::vector<Event>();
+            _events.reserve(block_size);
+        }
+
+        HandleEvent _handle_event;
+        ring<Event> _ring;
+        std::vector<Event> _events;
+        bool _closed;
+        std::unique_ptr<stage> _stage;
+    };
+
+    /// pool splits loops over ranges of indices across persistent threads.
+    /// The calling thread processes the first range, hence a pool of n threads starts n - 1 threads.
+    class pool {
+        public:
+        pool(std::size_t threads) : _size(0), _generation(0), _remaining(0), _stopped(false) {
+            for (std::size_t index = 1; index < threads; ++index) {
+                _threads.emplace_back([this, index]() {
+                    uint64_t generation = 0;
+                    for (;;) {
+                        std::size_t size = 0;
+                        {
+                            std::unique_lock<std::mutex> lock(_mutex);
+                            _started.wait(lock, [&]() { return _stopped || _generation != generation; });
+                            if (_stopped) {
+                                return;
+                            }
+                            generation = _generation;
+                            size = _size;
+                        }
+                        std::exception_ptr exception;
+                        try {
+                            const auto count = _threads.size() + 1;
+                            _task(size * index / count, size * (index + 1) / count);
+                        } catch (...) {
+                            exception = std::current_exception();
+                        }
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        if (exception && !_exception) {
+                            _exception = exception;
+                        }
+                        --_remaining;
+                        if (_remaining == 0) {
+                            _finished.notify_one();
+                        }
+                    }
+                });
+            }
+        }
+        pool(const pool&) = delete;
+        pool(pool&& other) = delete;
+        pool& operator=(const pool&) = delete;
+        pool& operator=(pool&& other) = delete;
+        virtual ~pool() {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stopped = true;
+            }
+            _started.notify_all();
+            for (auto& thread : _threads) {
+                thread.join();
+            }
+        }
+
+        /// threads returns the number of threads that run tasks, including the calling thread.
+        std::size_t threads() const {
+            return _threads.size() + 1;
+        }
+
+        /// run calls task(begin, end) on contiguous ranges that cover [0, size), and waits for all of them.
+        /// The first exception thrown by a task (if any) is rethrown.
+        void run(std::size_t size, std::function<void(std::size_t, std::size_t)> task) {
+            if (_threads.empty() || size < 2) {
+                task(0, size);
+                return;
+            }
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _task = std::move(task);
+                _size = size;
+                _remaining = _threads.size();
+                _exception = nullptr;
+                ++_generation;
+            }
+            _started.notify_all();
+            std::exception_ptr exception;
+            try {
+                _task(0, size / (_threads.size() + 1));
+            } catch (...) {
+                exception = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _finished.wait(lock, [&]() { return _remaining == 0; });
+            if (!exception) {
+                exception = _exception;
+            }
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+
+        protected:
+        std::mutex _mutex;
+        std::condition_variable _started;
+        std::condition_variable _finished;
+        std::function<void(std::size_t, std::size_t)> _task;
+        std::size_t _size;
+        uint64_t _generation;
+        std::size_t _remaining;
+        bool _stopped;
+        std::exception_ptr _exception;
+        std::vector<std::thread> _threads;
+    };
+}
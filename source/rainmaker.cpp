@@ -3,6 +3,7 @@
 #include "../third_party/sepia/source/sepia.hpp"
 #include "../third_party/tarsier/source/stitch.hpp"
 #include "html.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
 #include <numeric>
 
@@ -88,29 +89,34 @@ int main(int argc, char* argv[]) {
                     break;
                 }
                 case sepia::type::dvs: {
-                    sepia::join_observable<
-                        sepia::type::
-                            dvs>(sepia::filename_to_ifstream(command.arguments[0]), [&](sepia::dvs_event dvs_event) {
-                        if (dvs_event.t >= end_t) {
-                            throw sepia::end_of_file();
-                        }
-                        if (dvs_event.t >= begin_t) {
-                            if (dvs_event.is_increase) {
-                                if (dark) {
-                                    color_events.push_back({dvs_event.t, dvs_event.x, dvs_event.y, 0xfb, 0xbc, 0x05});
-                                } else {
-                                    color_events.push_back({dvs_event.t, dvs_event.x, dvs_event.y, 0x00, 0x8c, 0xff});
-                                }
+                    // the ATIS and color base frames depend on the events before begin,
+                    // hence only the DVS case uses the time index
+                    time_index::join_observable<sepia::type::dvs>(
+                        command.arguments[0], begin_t, [&](sepia::dvs_event dvs_event) {
+                            if (dvs_event.t >= end_t) {
+                                throw sepia::end_of_file();
+                            }
+                            if (dvs_event.t >= begin_t) {
+                                if (dvs_event.is_increase) {
+                                    if (dark) {
+                                        color_events.push_back(
+                                            {dvs_event.t, dvs_event.x, dvs_event.y, 0xfb, 0xbc, 0x05});
+                                    } else {
+                                        color_events.push_back(
+                                            {dvs_event.t, dvs_event.x, dvs_event.y, 0x00, 0x8c, 0xff});
+                                    }
 
-                            } else {
-                                if (dark) {
-                                    color_events.push_back({dvs_event.t, dvs_event.x, dvs_event.y, 0x42, 0x85, 0xf4});
                                 } else {
-                                    color_events.push_back({dvs_event.t, dvs_event.x, dvs_event.y, 0x33, 0x4d, 0x5c});
+                                    if (dark) {
+                                        color_events.push_back(
+                                            {dvs_event.t, dvs_event.x, dvs_event.y, 0x42, 0x85, 0xf4});
+                                    } else {
+                                        color_events.push_back(
+                                            {dvs_event.t, dvs_event.x, dvs_event.y, 0x33, 0x4d, 0x5c});
+                                    }
                                 }
                             }
-                        }
-                    });
+                        });
                     if (color_events.empty()) {
                         throw std::runtime_error("there are no DVS events in the given file and range");
                     }
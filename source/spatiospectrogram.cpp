@@ -6,6 +6,7 @@
 #include "../third_party/tarsier/source/replicate.hpp"
 #include "../third_party/tarsier/source/stitch.hpp"
 #include "font.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
 #include <complex>
 #include <iomanip>
@@ -501,6 +502,13 @@ int main(int argc, char* argv[]) {
                 }
             }
             const auto header = sepia::read_header(*input);
+            uint64_t base_t = 0;
+            {
+                const auto name_and_argument = command.options.find("input");
+                if (name_and_argument != command.options.end()) {
+                    base_t = time_index::seek(*input, name_and_argument->second, begin_t);
+                }
+            }
             if (header.event_stream_type != sepia::type::dvs) {
                 throw std::runtime_error("unsupported event stream type");
             }
@@ -518,6 +526,7 @@ int main(int argc, char* argv[]) {
             auto first_t = std::numeric_limits<uint64_t>::max();
             frame output_frame(header.width, header.height, scale);
             sepia::join_observable<sepia::type::dvs>(std::move(input), header, [&](sepia::dvs_event event) {
+                event.t += base_t;
                 if (event.t < begin_t) {
                     return;
                 }
@@ -2,6 +2,7 @@
 #include "../third_party/lodepng/lodepng.h"
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
 #include <algorithm>
 #include <complex>
@@ -80,7 +81,7 @@ struct region_of_interest {
 /// compute_spectrogram calculates the spectrogram.
 template <sepia::type event_stream_type>
 spectrogram typed_compute_spectrogram(
-    std::unique_ptr<std::istream> stream,
+    const std::string& filename,
     uint64_t begin_t,
     uint64_t end_t,
     region_of_interest roi,
@@ -121,8 +122,8 @@ spectrogram typed_compute_spectrogram(
         }
         previous_update_t = t;
     };
-    std::size_t time_index = 0;
-    sepia::join_observable<event_stream_type>(std::move(stream), [&](sepia::event<event_stream_type> event) {
+    std::size_t time_position = 0;
+    time_index::join_observable<event_stream_type>(filename, begin_t, [&](sepia::event<event_stream_type> event) {
         if (event.t < begin_t) {
             return;
         }
@@ -160,27 +161,28 @@ spectrogram typed_compute_spectrogram(
                     break;
             }
         }
-        while (time_index < result.times.size() && event.t > result.times[time_index]) {
+        while (time_position < result.times.size() && event.t > result.times[time_position]) {
             for (std::size_t y = 0; y < frequencies; ++y) {
-                result.amplitudes[time_index + y * times] =
-                    amplitudes[y] * std::exp(-static_cast<double>(result.times[time_index] - previous_update_t) / tau);
+                result.amplitudes[time_position + y * times] =
+                    amplitudes[y]
+                    * std::exp(-static_cast<double>(result.times[time_position] - previous_update_t) / tau);
             }
-            ++time_index;
+            ++time_position;
         }
     });
-    for (; time_index < result.times.size(); ++time_index) {
+    for (; time_position < result.times.size(); ++time_position) {
         for (std::size_t y = 0; y < frequencies; ++y) {
-            result.amplitudes[time_index + y * times] =
-                amplitudes[y] * std::exp(-static_cast<double>(result.times[time_index] - previous_update_t) / tau);
+            result.amplitudes[time_position + y * times] =
+                amplitudes[y] * std::exp(-static_cast<double>(result.times[time_position] - previous_update_t) / tau);
         }
-        ++time_index;
+        ++time_position;
     }
     return result;
 }
 
 spectrogram compute_spectrogram(
     const sepia::header& header,
-    std::unique_ptr<std::istream> stream,
+    const std::string& filename,
     uint64_t begin_t,
     uint64_t end_t,
     region_of_interest roi,
@@ -196,7 +198,7 @@ spectrogram compute_spectrogram(
         }
         case sepia::type::dvs: {
             return typed_compute_spectrogram<sepia::type::dvs>(
-                std::move(stream),
+                filename,
                 begin_t,
                 end_t,
                 roi,
@@ -473,7 +475,7 @@ int main(int argc, char* argv[]) {
             }
             const auto complex_spectrogram = compute_spectrogram(
                 header,
-                sepia::filename_to_ifstream(command.arguments[0]),
+                command.arguments[0],
                 first_and_last_t.first,
                 first_and_last_t.second,
                 roi,
@@ -1,15 +1,29 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
-#include "../third_party/tarsier/source/convert.hpp"
 #include "../third_party/tarsier/source/hash.hpp"
-#include "../third_party/tarsier/source/replicate.hpp"
+#include "fast_hash.hpp"
+#include "npy.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
+#include <array>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <future>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #ifdef _WIN32
 #include <fcntl.h>
 #include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
 #endif
 
 /// type_to_string returns a text representation of the type enum.
@@ -28,6 +42,7 @@ std::string type_to_string(sepia::type type) {
 }
 
 /// hash_to_string converts a 128 bits hash to a hexadecimal representation.
+/// The leading zeros of the high word are omitted, so that legacy hashes do not change.
 std::string hash_to_string(std::pair<uint64_t, uint64_t> hash) {
     std::stringstream stream;
     stream << '"' << std::hex << std::get<1>(hash) << std::hex << std::setfill('0') << std::setw(16)
@@ -35,6 +50,14 @@ std::string hash_to_string(std::pair<uint64_t, uint64_t> hash) {
     return stream.str();
 }
 
+/// fixed_hash_to_string converts a 128 bits hash to a 32 digits hexadecimal representation.
+std::string fixed_hash_to_string(std::pair<uint64_t, uint64_t> hash) {
+    std::stringstream stream;
+    stream << '"' << std::hex << std::setfill('0') << std::setw(16) << std::get<1>(hash) << std::setw(16)
+           << std::get<0>(hash) << '"';
+    return stream.str();
+}
+
 /// properties_to_json converts a list of properties to pretty-printed JSON.
 std::string properties_to_json(const std::vector<std::pair<std::string, std::string>>& properties) {
     std::string json("{\n");
@@ -46,6 +69,904 @@ std::string properties_to_json(const std::vector<std::pair<std::string, std::str
     return json;
 }
 
+/// update_counters increments the type-specific counters, in the order of fields::counter_names.
+inline void update_counters(std::array<uint64_t, 3>&, const sepia::generic_event&) {}
+inline void update_counters(std::array<uint64_t, 3>& counters, const sepia::dvs_event& dvs_event) {
+    if (dvs_event.is_increase) {
+        ++counters[0];
+    }
+}
+inline void update_counters(std::array<uint64_t, 3>& counters, const sepia::atis_event& atis_event) {
+    if (!atis_event.is_threshold_crossing) {
+        ++counters[0];
+    }
+    if (atis_event.polarity) {
+        if (atis_event.is_threshold_crossing) {
+            ++counters[2];
+        } else {
+            ++counters[1];
+        }
+    }
+}
+inline void update_counters(std::array<uint64_t, 3>&, const sepia::color_event&) {}
+
+/// counts accumulates the number of events, their time range and the type-specific counters.
+/// The counts of consecutive ranges of events can be merged.
+template <sepia::type event_stream_type>
+struct counts {
+    uint64_t events;
+    uint64_t begin_t;
+    uint64_t end_t;
+    std::array<uint64_t, 3> counters;
+
+    /// operator() updates the counts with an event.
+    void operator()(const sepia::event<event_stream_type>& event) {
+        if (events == 0) {
+            begin_t = event.t;
+        }
+        end_t = event.t;
+        ++events;
+        update_counters(counters, event);
+    }
+
+    /// merge adds the counts of the events that follow.
+    void merge(const counts<event_stream_type>& following) {
+        if (following.events == 0) {
+            return;
+        }
+        if (events == 0) {
+            begin_t = following.begin_t;
+        }
+        end_t = following.end_t;
+        events += following.events;
+        for (std::size_t index = 0; index < counters.size(); ++index) {
+            counters[index] += following.counters[index];
+        }
+    }
+};
+
+/// fields lists the counters and hashes of an event type.
+/// hash calls observe with a function to call on every event, and returns the hash of each field.
+template <sepia::type event_stream_type>
+struct fields;
+template <>
+struct fields<sepia::type::generic> {
+    typedef std::array<std::pair<uint64_t, uint64_t>, 2> hashes;
+    static std::vector<std::string> counter_names() {
+        return {};
+    }
+    static std::vector<std::string> hash_names() {
+        return {"t_hash", "bytes_hash"};
+    }
+    template <typename Observe>
+    static hashes hash(Observe observe) {
+        hashes field_hashes;
+        {
+            auto t_hash = tarsier::make_hash<uint64_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[0] = hash_value; });
+            auto bytes_hash = tarsier::make_hash<uint8_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[1] = hash_value; });
+            observe([&](const sepia::generic_event& generic_event) {
+                t_hash(generic_event.t);
+                for (const auto character : generic_event.bytes) {
+                    bytes_hash(character);
+                }
+            });
+        }
+        return field_hashes;
+    }
+};
+template <>
+struct fields<sepia::type::dvs> {
+    typedef std::array<std::pair<uint64_t, uint64_t>, 3> hashes;
+    static std::vector<std::string> counter_names() {
+        return {"increase_events"};
+    }
+    static std::vector<std::string> hash_names() {
+        return {"t_hash", "x_hash", "y_hash"};
+    }
+    template <typename Observe>
+    static hashes hash(Observe observe) {
+        hashes field_hashes;
+        {
+            auto t_hash = tarsier::make_hash<uint64_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[0] = hash_value; });
+            auto x_hash = tarsier::make_hash<uint16_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[1] = hash_value; });
+            auto y_hash = tarsier::make_hash<uint16_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[2] = hash_value; });
+            observe([&](const sepia::dvs_event& dvs_event) {
+                t_hash(dvs_event.t);
+                x_hash(dvs_event.x);
+                y_hash(dvs_event.y);
+            });
+        }
+        return field_hashes;
+    }
+};
+template <>
+struct fields<sepia::type::atis> {
+    typedef std::array<std::pair<uint64_t, uint64_t>, 3> hashes;
+    static std::vector<std::string> counter_names() {
+        return {"dvs_events", "increase_events", "second_events"};
+    }
+    static std::vector<std::string> hash_names() {
+        return {"t_hash", "x_hash", "y_hash"};
+    }
+    template <typename Observe>
+    static hashes hash(Observe observe) {
+        hashes field_hashes;
+        {
+            auto t_hash = tarsier::make_hash<uint64_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[0] = hash_value; });
+            auto x_hash = tarsier::make_hash<uint16_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[1] = hash_value; });
+            auto y_hash = tarsier::make_hash<uint16_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[2] = hash_value; });
+            observe([&](const sepia::atis_event& atis_event) {
+                t_hash(atis_event.t);
+                x_hash(atis_event.x);
+                y_hash(atis_event.y);
+            });
+        }
+        return field_hashes;
+    }
+};
+template <>
+struct fields<sepia::type::color> {
+    typedef std::array<std::pair<uint64_t, uint64_t>, 6> hashes;
+    static std::vector<std::string> counter_names() {
+        return {};
+    }
+    static std::vector<std::string> hash_names() {
+        return {"t_hash", "x_hash", "y_hash", "r_hash", "g_hash", "b_hash"};
+    }
+    template <typename Observe>
+    static hashes hash(Observe observe) {
+        hashes field_hashes;
+        {
+            auto t_hash = tarsier::make_hash<uint64_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[0] = hash_value; });
+            auto x_hash = tarsier::make_hash<uint16_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[1] = hash_value; });
+            auto y_hash = tarsier::make_hash<uint16_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[2] = hash_value; });
+            auto r_hash = tarsier::make_hash<uint8_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[3] = hash_value; });
+            auto g_hash = tarsier::make_hash<uint8_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[4] = hash_value; });
+            auto b_hash = tarsier::make_hash<uint8_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[5] = hash_value; });
+            observe([&](const sepia::color_event& color_event) {
+                t_hash(color_event.t);
+                x_hash(color_event.x);
+                y_hash(color_event.y);
+                r_hash(color_event.r);
+                g_hash(color_event.g);
+                b_hash(color_event.b);
+            });
+        }
+        return field_hashes;
+    }
+};
+
+/// pixel holds the activity counters of a pixel.
+/// Polarities are counted for change detection events only (DVS events, and ATIS events that are not
+/// threshold crossings).
+struct pixel {
+    uint64_t events;
+    uint64_t increase_events;
+    uint64_t decrease_events;
+    uint64_t first_t;
+    uint64_t last_t;
+};
+
+/// update_polarity counts the event's polarity, if it has one.
+inline void update_polarity(pixel&, const sepia::generic_event&) {}
+inline void update_polarity(pixel& event_pixel, const sepia::dvs_event& dvs_event) {
+    if (dvs_event.is_increase) {
+        ++event_pixel.increase_events;
+    } else {
+        ++event_pixel.decrease_events;
+    }
+}
+inline void update_polarity(pixel& event_pixel, const sepia::atis_event& atis_event) {
+    if (!atis_event.is_threshold_crossing) {
+        if (atis_event.polarity) {
+            ++event_pixel.increase_events;
+        } else {
+            ++event_pixel.decrease_events;
+        }
+    }
+}
+inline void update_polarity(pixel&, const sepia::color_event&) {}
+
+/// pixel_index returns the position of the event's pixel in a row-major map.
+inline std::size_t pixel_index(const sepia::generic_event&, uint16_t) {
+    return 0;
+}
+template <typename Event>
+inline std::size_t pixel_index(const Event& event, uint16_t width) {
+    return static_cast<std::size_t>(event.x) + static_cast<std::size_t>(event.y) * width;
+}
+
+/// activity accumulates per-pixel counters and a time series of event counts, in the same pass as the statistics.
+/// The counters of all the pixels are stored in a single flat array, so that an event touches one cache line.
+template <sepia::type event_stream_type>
+class activity {
+    public:
+    activity(uint16_t width, uint16_t height, uint64_t bin_duration) :
+        _width(width),
+        _height(height),
+        _bin_duration(bin_duration),
+        _pixels(static_cast<std::size_t>(width) * height, pixel{0, 0, 0, 0, 0}),
+        _bins_begin_t(0) {}
+    activity(const activity&) = delete;
+    activity(activity&&) = default;
+    activity& operator=(const activity&) = delete;
+    activity& operator=(activity&&) = default;
+    virtual ~activity() {}
+
+    /// operator() handles an event.
+    virtual void operator()(const sepia::event<event_stream_type>& event) {
+        auto& event_pixel = _pixels[pixel_index(event, _width)];
+        if (event_pixel.events == 0) {
+            event_pixel.first_t = event.t;
+        }
+        event_pixel.last_t = event.t;
+        ++event_pixel.events;
+        update_polarity(event_pixel, event);
+        if (_bin_duration > 0) {
+            if (_bins.empty()) {
+                _bins_begin_t = event.t;
+            }
+            const auto bin = static_cast<std::size_t>((event.t - _bins_begin_t) / _bin_duration);
+            if (bin >= _bins.size()) {
+                _bins.resize(bin + 1, 0);
+            }
+            ++_bins[bin];
+        }
+    }
+
+    /// append_properties adds a summary of the activity to the JSON properties.
+    virtual void append_properties(std::vector<std::pair<std::string, std::string>>& properties, std::size_t top) {
+        std::vector<std::size_t> active_indices;
+        for (std::size_t index = 0; index < _pixels.size(); ++index) {
+            if (_pixels[index].events > 0) {
+                active_indices.push_back(index);
+            }
+        }
+        properties.emplace_back("active_pixels", std::to_string(active_indices.size()));
+        if (top > 0) {
+            top = std::min(top, active_indices.size());
+            std::partial_sort(
+                active_indices.begin(),
+                std::next(active_indices.begin(), static_cast<std::ptrdiff_t>(top)),
+                active_indices.end(),
+                [&](std::size_t first, std::size_t second) {
+                    return _pixels[first].events > _pixels[second].events
+                           || (_pixels[first].events == _pixels[second].events && first < second);
+                });
+            std::string hot_pixels("[");
+            for (std::size_t index = 0; index < top; ++index) {
+                const auto& hot_pixel = _pixels[active_indices[index]];
+                hot_pixels.append(
+                    std::string(index > 0 ? ", " : "") + "{\"x\": " + std::to_string(active_indices[index] % _width)
+                    + ", \"y\": " + std::to_string(active_indices[index] / _width)
+                    + ", \"events\": " + std::to_string(hot_pixel.events));
+                if (has_polarity) {
+                    hot_pixels.append(
+                        ", \"increase_events\": " + std::to_string(hot_pixel.increase_events)
+                        + ", \"decrease_events\": " + std::to_string(hot_pixel.decrease_events));
+                }
+                hot_pixels.push_back('}');
+            }
+            hot_pixels.append("]");
+            properties.emplace_back("hot_pixels", hot_pixels);
+        }
+        if (_bin_duration > 0) {
+            properties.emplace_back("bin_duration", std::to_string(_bin_duration));
+            properties.emplace_back("bins", std::to_string(_bins.size()));
+            const auto maximum_bin = std::max_element(_bins.begin(), _bins.end());
+            if (maximum_bin != _bins.end()) {
+                properties.emplace_back("maximum_bin_events", std::to_string(*maximum_bin));
+                properties.emplace_back(
+                    "maximum_bin_begin_t",
+                    std::to_string(
+                        _bins_begin_t
+                        + static_cast<uint64_t>(std::distance(_bins.begin(), maximum_bin)) * _bin_duration));
+            }
+        }
+    }
+
+    /// write creates the npy arrays, named after the given prefix.
+    /// Per-pixel arrays have the shape (height, width). The mean interval is NaN for pixels with less than two events.
+    virtual void write(const std::string& prefix) {
+        const std::vector<uint64_t> shape{_height, _width};
+        const auto write_map = [&](const std::string& name, std::function<uint64_t(const pixel&)> pixel_to_value) {
+            std::vector<uint8_t> bytes;
+            bytes.reserve(_pixels.size() * sizeof(uint64_t));
+            for (const auto& map_pixel : _pixels) {
+                npy::append(bytes, pixel_to_value(map_pixel));
+            }
+            npy::write_array(prefix + "_" + name + ".npy", npy::descriptor<uint64_t>(), shape, bytes);
+        };
+        write_map("events", [](const pixel& map_pixel) { return map_pixel.events; });
+        if (has_polarity) {
+            write_map("increase_events", [](const pixel& map_pixel) { return map_pixel.increase_events; });
+            write_map("decrease_events", [](const pixel& map_pixel) { return map_pixel.decrease_events; });
+        }
+        {
+            std::vector<uint8_t> bytes;
+            bytes.reserve(_pixels.size() * sizeof(double));
+            for (const auto& map_pixel : _pixels) {
+                npy::append(
+                    bytes,
+                    map_pixel.events < 2 ? std::numeric_limits<double>::quiet_NaN() :
+                                           static_cast<double>(map_pixel.last_t - map_pixel.first_t)
+                                               / static_cast<double>(map_pixel.events - 1));
+            }
+            npy::write_array(prefix + "_mean_interval.npy", npy::descriptor<double>(), shape, bytes);
+        }
+        if (_bin_duration > 0) {
+            std::vector<uint8_t> bytes;
+            bytes.reserve(_bins.size() * sizeof(uint64_t));
+            for (const auto bin : _bins) {
+                npy::append(bytes, bin);
+            }
+            npy::write_array(prefix + "_bins.npy", npy::descriptor<uint64_t>(), {_bins.size()}, bytes);
+        }
+    }
+
+    /// has_polarity is true if the events have a polarity.
+    static constexpr bool has_polarity =
+        event_stream_type == sepia::type::dvs || event_stream_type == sepia::type::atis;
+
+    protected:
+    const uint16_t _width;
+    const uint16_t _height;
+    const uint64_t _bin_duration;
+    std::vector<pixel> _pixels;
+    uint64_t _bins_begin_t;
+    std::vector<uint64_t> _bins;
+};
+
+/// observe_stream dispatches the events of an Event Stream, and updates counts (and activity, if any) on the way.
+template <sepia::type event_stream_type>
+struct observe_stream {
+    std::unique_ptr<std::istream>& input;
+    const sepia::header& header;
+    counts<event_stream_type>& event_counts;
+    activity<event_stream_type>* event_activity;
+
+    template <typename HandleEvent>
+    void operator()(HandleEvent handle_event) {
+        sepia::join_observable<event_stream_type>(
+            std::move(input), header, [&](sepia::event<event_stream_type> event) {
+                event_counts(event);
+                if (event_activity) {
+                    (*event_activity)(event);
+                }
+                handle_event(event);
+            });
+    }
+};
+
+/// observe_events dispatches the events of a vector.
+template <sepia::type event_stream_type>
+struct observe_events {
+    const std::vector<sepia::event<event_stream_type>>& events;
+
+    template <typename HandleEvent>
+    void operator()(HandleEvent handle_event) {
+        for (const auto& event : events) {
+            handle_event(event);
+        }
+    }
+};
+
+/// leaf_size is the number of events hashed by each leaf of the tree digest.
+/// Leaves are aligned on the event index, hence the digest does not depend on how the file is split.
+constexpr uint64_t leaf_size = 1 << 16;
+
+/// chunk contains the partial statistics of consecutive events.
+/// The events before the chunk's first leaf boundary (head) and after its last (tail) cannot be hashed
+/// by the chunk alone, and are kept for the next merge step.
+template <sepia::type event_stream_type>
+struct chunk {
+    counts<event_stream_type> event_counts;
+    std::vector<sepia::event<event_stream_type>> head;
+    bool has_boundary;
+    std::vector<typename fields<event_stream_type>::hashes> leaves;
+    std::vector<sepia::event<event_stream_type>> tail;
+};
+
+/// chunk_builder calculates the chunk of events starting at a given index.
+template <sepia::type event_stream_type>
+class chunk_builder {
+    public:
+    chunk_builder(uint64_t first_index) : _index(first_index), _chunk{} {
+        _chunk.has_boundary = first_index % leaf_size == 0;
+        _events.reserve(leaf_size);
+    }
+    chunk_builder(const chunk_builder&) = delete;
+    chunk_builder(chunk_builder&&) = default;
+    chunk_builder& operator=(const chunk_builder&) = delete;
+    chunk_builder& operator=(chunk_builder&&) = default;
+    virtual ~chunk_builder() {}
+
+    /// operator() handles an event.
+    virtual void operator()(const sepia::event<event_stream_type>& event) {
+        _chunk.event_counts(event);
+        _events.push_back(event);
+        ++_index;
+        if (_index % leaf_size == 0) {
+            if (_chunk.has_boundary) {
+                _chunk.leaves.push_back(fields<event_stream_type>::hash(observe_events<event_stream_type>{_events}));
+                _events.clear();
+            } else {
+                _chunk.head.swap(_events);
+                _chunk.has_boundary = true;
+            }
+        }
+    }
+
+    /// finish returns the chunk. The builder must not be used afterwards.
+    virtual chunk<event_stream_type> finish() {
+        (_chunk.has_boundary ? _chunk.tail : _chunk.head).swap(_events);
+        return std::move(_chunk);
+    }
+
+    protected:
+    uint64_t _index;
+    chunk<event_stream_type> _chunk;
+    std::vector<sepia::event<event_stream_type>> _events;
+};
+
+/// tree merges consecutive chunks, and calculates the tree digest.
+/// Each field's digest is the hash of the field's leaf hashes, in order.
+template <sepia::type event_stream_type>
+class tree {
+    public:
+    tree() : _event_counts{} {}
+    tree(const tree&) = delete;
+    tree(tree&&) = default;
+    tree& operator=(const tree&) = delete;
+    tree& operator=(tree&&) = default;
+    virtual ~tree() {}
+
+    /// operator() merges the chunk that follows the previous ones.
+    virtual void operator()(chunk<event_stream_type> next_chunk) {
+        _event_counts.merge(next_chunk.event_counts);
+        _pending.insert(_pending.end(), next_chunk.head.begin(), next_chunk.head.end());
+        if (next_chunk.has_boundary) {
+            flush();
+            _leaves.insert(_leaves.end(), next_chunk.leaves.begin(), next_chunk.leaves.end());
+            _pending.swap(next_chunk.tail);
+        }
+    }
+
+    /// event_counts returns the merged counts.
+    virtual const counts<event_stream_type>& event_counts() const {
+        return _event_counts;
+    }
+
+    /// root returns the digest of each field. It must be called after the last chunk.
+    virtual typename fields<event_stream_type>::hashes root() {
+        flush();
+        typename fields<event_stream_type>::hashes field_hashes;
+        for (std::size_t index = 0; index < field_hashes.size(); ++index) {
+            auto hash = tarsier::make_hash<uint64_t>(
+                [&](std::pair<uint64_t, uint64_t> hash_value) { field_hashes[index] = hash_value; });
+            for (const auto& leaf : _leaves) {
+                hash(leaf[index].first);
+                hash(leaf[index].second);
+            }
+        }
+        return field_hashes;
+    }
+
+    protected:
+    /// flush hashes the pending events as a leaf.
+    virtual void flush() {
+        if (!_pending.empty()) {
+            _leaves.push_back(fields<event_stream_type>::hash(observe_events<event_stream_type>{_pending}));
+            _pending.clear();
+        }
+    }
+
+    counts<event_stream_type> _event_counts;
+    std::vector<sepia::event<event_stream_type>> _pending;
+    std::vector<typename fields<event_stream_type>::hashes> _leaves;
+};
+
+/// append_counts adds the counts to the JSON properties.
+template <sepia::type event_stream_type>
+void append_counts(
+    std::vector<std::pair<std::string, std::string>>& properties,
+    const counts<event_stream_type>& event_counts) {
+    properties.emplace_back(
+        "begin_representation", std::string("\"") + timecode(event_counts.begin_t).to_string() + "\"");
+    properties.emplace_back("end_representation", std::string("\"") + timecode(event_counts.end_t).to_string() + "\"");
+    properties.emplace_back(
+        "duration_representation",
+        std::string("\"") + timecode(event_counts.end_t - event_counts.begin_t).to_string() + "\"");
+    properties.emplace_back("begin_t", std::to_string(event_counts.begin_t));
+    properties.emplace_back("end_t", std::to_string(event_counts.end_t));
+    properties.emplace_back("duration", std::to_string(event_counts.end_t - event_counts.begin_t));
+    properties.emplace_back("events", std::to_string(event_counts.events));
+    const auto counter_names = fields<event_stream_type>::counter_names();
+    for (std::size_t index = 0; index < counter_names.size(); ++index) {
+        properties.emplace_back(counter_names[index], std::to_string(event_counts.counters[index]));
+    }
+}
+
+/// append_properties adds the counts and hashes to the JSON properties.
+/// The digest name is omitted for legacy hashes, so that their output does not change.
+/// The other digests are printed with a fixed width.
+template <sepia::type event_stream_type>
+void append_properties(
+    std::vector<std::pair<std::string, std::string>>& properties,
+    const counts<event_stream_type>& event_counts,
+    const std::string& digest,
+    const typename fields<event_stream_type>::hashes& field_hashes) {
+    append_counts(properties, event_counts);
+    if (!digest.empty()) {
+        properties.emplace_back("digest", std::string("\"") + digest + "\"");
+    }
+    const auto hash_names = fields<event_stream_type>::hash_names();
+    for (std::size_t index = 0; index < hash_names.size(); ++index) {
+        properties.emplace_back(
+            hash_names[index],
+            digest.empty() ? hash_to_string(field_hashes[index]) : fixed_hash_to_string(field_hashes[index]));
+    }
+}
+
+/// legacy_statistics hashes each field over the whole stream, in a single pass.
+template <sepia::type event_stream_type>
+void legacy_statistics(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    activity<event_stream_type>* event_activity,
+    std::vector<std::pair<std::string, std::string>>& properties) {
+    counts<event_stream_type> event_counts{};
+    const auto field_hashes = fields<event_stream_type>::hash(
+        observe_stream<event_stream_type>{input, header, event_counts, event_activity});
+    append_properties(properties, event_counts, "", field_hashes);
+}
+
+/// tree_statistics calculates the tree digest, splitting the work across threads.
+/// If the input is a file with a valid time index, each thread decodes its own byte range.
+/// Otherwise, the stream is decoded by the calling thread, and blocks of events are hashed in parallel.
+/// The activity (if any) is updated by the decoding thread, hence it disables the index.
+template <sepia::type event_stream_type>
+void tree_statistics(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    const std::string& filename,
+    std::size_t threads,
+    activity<event_stream_type>* event_activity,
+    std::vector<std::pair<std::string, std::string>>& properties) {
+    tree<event_stream_type> digest_tree;
+    std::deque<std::future<chunk<event_stream_type>>> chunks;
+    const auto push = [&](std::future<chunk<event_stream_type>> next_chunk) {
+        if (chunks.size() >= 2 * threads) {
+            digest_tree(chunks.front().get());
+            chunks.pop_front();
+        }
+        chunks.push_back(std::move(next_chunk));
+    };
+    const auto entries = filename.empty() || event_activity ? std::vector<time_index::entry>() :
+                                                              time_index::read(filename);
+    if (threads < 2) {
+        chunk_builder<event_stream_type> builder(0);
+        sepia::join_observable<event_stream_type>(
+            std::move(input), header, [&](sepia::event<event_stream_type> event) {
+                if (event_activity) {
+                    (*event_activity)(event);
+                }
+                builder(event);
+            });
+        digest_tree(builder.finish());
+    } else if (!entries.empty()) {
+        std::vector<time_index::entry> boundaries{{static_cast<uint64_t>(input->tellg()), 0, 0}};
+        input.reset();
+        const auto ranges = threads * 4;
+        for (std::size_t index = 1; index < ranges; ++index) {
+            const auto& index_entry = entries[index * entries.size() / ranges];
+            if (index_entry.offset > boundaries.back().offset) {
+                boundaries.push_back(index_entry);
+            }
+        }
+        boundaries.push_back({time_index::filename_to_signature(filename).size, 0, 0});
+        for (std::size_t index = 0; index < boundaries.size() - 1; ++index) {
+            const auto begin = boundaries[index];
+            const auto end = boundaries[index + 1];
+            push(std::async(std::launch::async, [&filename, &header, begin, end]() {
+                chunk_builder<event_stream_type> builder(begin.events);
+                time_index::range_observable<event_stream_type>(
+                    filename, header, begin.offset, end.offset, begin.t, builder);
+                return builder.finish();
+            }));
+        }
+    } else {
+        std::vector<sepia::event<event_stream_type>> events;
+        events.reserve(leaf_size);
+        uint64_t first_index = 0;
+        const auto send = [&]() {
+            push(std::async(
+                std::launch::async,
+                [](std::vector<sepia::event<event_stream_type>> block, uint64_t block_first_index) {
+                    chunk_builder<event_stream_type> builder(block_first_index);
+                    for (const auto& event : block) {
+                        builder(event);
+                    }
+                    return builder.finish();
+                },
+                std::move(events),
+                first_index));
+            first_index += leaf_size;
+            events = std::vector<sepia::event<event_stream_type>>();
+            events.reserve(leaf_size);
+        };
+        sepia::join_observable<event_stream_type>(
+            std::move(input), header, [&](sepia::event<event_stream_type> event) {
+                if (event_activity) {
+                    (*event_activity)(event);
+                }
+                events.push_back(std::move(event));
+                if (events.size() == leaf_size) {
+                    send();
+                }
+            });
+        if (!events.empty()) {
+            send();
+        }
+    }
+    for (auto& next_chunk : chunks) {
+        digest_tree(next_chunk.get());
+    }
+    append_properties(properties, digest_tree.event_counts(), "tree", digest_tree.root());
+}
+
+/// fast_batch_size is the number of events hashed at once by the fast digest.
+constexpr std::size_t fast_batch_size = 1 << 12;
+
+/// store_coordinates writes the event's coordinates, if it has any.
+inline void store_coordinates(uint16_t&, uint16_t&, const sepia::generic_event&) {}
+template <typename Event>
+inline void store_coordinates(uint16_t& x, uint16_t& y, const Event& event) {
+    x = event.x;
+    y = event.y;
+}
+
+/// append_payload copies the type-specific fields of an event as bytes.
+inline void append_payload(std::vector<uint8_t>& payload, const sepia::generic_event& generic_event) {
+    const auto size = static_cast<uint32_t>(generic_event.bytes.size());
+    for (std::size_t index = 0; index < 4; ++index) {
+        payload.push_back(static_cast<uint8_t>((size >> (8 * index)) & 0xff));
+    }
+    payload.insert(payload.end(), generic_event.bytes.begin(), generic_event.bytes.end());
+}
+inline void append_payload(std::vector<uint8_t>& payload, const sepia::dvs_event& dvs_event) {
+    payload.push_back(dvs_event.is_increase ? 1 : 0);
+}
+inline void append_payload(std::vector<uint8_t>& payload, const sepia::atis_event& atis_event) {
+    payload.push_back(static_cast<uint8_t>((atis_event.is_threshold_crossing ? 1 : 0) | (atis_event.polarity ? 2 : 0)));
+}
+inline void append_payload(std::vector<uint8_t>& payload, const sepia::color_event& color_event) {
+    payload.push_back(color_event.r);
+    payload.push_back(color_event.g);
+    payload.push_back(color_event.b);
+}
+
+/// event_batch stores events as a structure of arrays, so that the fast digest hashes each field in one call.
+/// A batch is hashed as its timestamps, then its x coordinates, its y coordinates and its payloads.
+/// Timestamps and coordinates are written at the batch's current index into arrays allocated once.
+template <sepia::type event_stream_type>
+class event_batch {
+    public:
+    /// has_coordinates is false for generic events, whose x and y arrays are not hashed.
+    static constexpr bool has_coordinates = event_stream_type != sepia::type::generic;
+
+    event_batch() : _size(0) {
+        _payload.reserve(fast_batch_size * 3);
+    }
+    event_batch(const event_batch&) = delete;
+    event_batch(event_batch&&) = default;
+    event_batch& operator=(const event_batch&) = delete;
+    event_batch& operator=(event_batch&&) = default;
+    virtual ~event_batch() {}
+
+    /// operator() appends an event, and hashes the batch when it is full.
+    virtual void operator()(const sepia::event<event_stream_type>& event, fast_hash::hash& hash) {
+        _ts[_size] = event.t;
+        store_coordinates(_xs[_size], _ys[_size], event);
+        append_payload(_payload, event);
+        ++_size;
+        if (_size == fast_batch_size) {
+            flush(hash);
+        }
+    }
+
+    /// flush hashes the pending events.
+    virtual void flush(fast_hash::hash& hash) {
+        hash.update_values(_ts.data(), _size);
+        hash.update_values(_xs.data(), has_coordinates ? _size : 0);
+        hash.update_values(_ys.data(), has_coordinates ? _size : 0);
+        hash.update(_payload.data(), _payload.size());
+        _size = 0;
+        _payload.clear();
+    }
+
+    protected:
+    std::array<uint64_t, fast_batch_size> _ts;
+    std::array<uint16_t, fast_batch_size> _xs;
+    std::array<uint16_t, fast_batch_size> _ys;
+    std::vector<uint8_t> _payload;
+    std::size_t _size;
+};
+
+/// fast_statistics calculates a single fingerprint over all the fields of the events.
+template <sepia::type event_stream_type>
+void fast_statistics(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    activity<event_stream_type>* event_activity,
+    std::vector<std::pair<std::string, std::string>>& properties) {
+    counts<event_stream_type> event_counts{};
+    fast_hash::hash hash;
+    event_batch<event_stream_type> batch;
+    sepia::join_observable<event_stream_type>(std::move(input), header, [&](sepia::event<event_stream_type> event) {
+        event_counts(event);
+        if (event_activity) {
+            (*event_activity)(event);
+        }
+        batch(event, hash);
+    });
+    batch.flush(hash);
+    append_counts(properties, event_counts);
+    properties.emplace_back("digest", "\"fast\"");
+    properties.emplace_back("hash", fixed_hash_to_string(hash.digest()));
+}
+
+/// digest_algorithm lists the available hashes.
+enum class digest_algorithm {
+    legacy,
+    tree,
+    fast,
+};
+
+/// settings gathers the command-line parameters.
+struct settings {
+    std::string filename;
+    digest_algorithm digest;
+    std::size_t threads;
+    std::string prefix;
+    std::size_t top;
+    uint64_t bin_duration;
+    bool cache;
+    std::string cache_directory;
+    bool refresh;
+
+    /// report returns true if the activity must be calculated.
+    bool report() const {
+        return !prefix.empty() || top > 0 || bin_duration > 0;
+    }
+
+    /// parameters returns a representation of the settings that change the JSON output.
+    std::string parameters() const {
+        return std::to_string(static_cast<uint32_t>(digest)) + " " + std::to_string(top) + " "
+               + std::to_string(bin_duration);
+    }
+};
+
+/// statistics calculates the properties of an Event Stream, and its activity if requested.
+template <sepia::type event_stream_type>
+void statistics(
+    std::unique_ptr<std::istream> input,
+    const sepia::header& header,
+    const settings& statistics_settings,
+    std::vector<std::pair<std::string, std::string>>& properties) {
+    std::unique_ptr<activity<event_stream_type>> event_activity;
+    if (statistics_settings.report()) {
+        event_activity = sepia::make_unique<activity<event_stream_type>>(
+            header.width, header.height, statistics_settings.bin_duration);
+    }
+    switch (statistics_settings.digest) {
+        case digest_algorithm::legacy:
+            legacy_statistics<event_stream_type>(std::move(input), header, event_activity.get(), properties);
+            break;
+        case digest_algorithm::tree:
+            tree_statistics<event_stream_type>(
+                std::move(input),
+                header,
+                statistics_settings.filename,
+                statistics_settings.threads,
+                event_activity.get(),
+                properties);
+            break;
+        case digest_algorithm::fast:
+            fast_statistics<event_stream_type>(std::move(input), header, event_activity.get(), properties);
+            break;
+    }
+    if (event_activity) {
+        event_activity->append_properties(properties, statistics_settings.top);
+        if (!statistics_settings.prefix.empty()) {
+            event_activity->write(statistics_settings.prefix);
+        }
+    }
+}
+
+/// cache_version is incremented whenever the cached output or the cache key changes.
+constexpr uint32_t cache_version = 3;
+
+/// file_to_cache_key identifies a file and the parameters used to calculate its statistics.
+/// The identity combines the file's device and inode with its index signature (size, modification time in
+/// nanoseconds and a fingerprint of evenly spaced blocks of its content), so that the file is read only partially.
+/// An empty identity is returned if the file cannot be read.
+inline std::pair<std::string, std::string>
+file_to_cache_key(const std::string& filename, const std::string& parameters) {
+    struct stat status;
+    if (stat(filename.c_str(), &status) != 0) {
+        return {};
+    }
+    const auto file_signature = time_index::filename_to_signature(filename);
+    const auto location = std::to_string(static_cast<uint64_t>(status.st_dev)) + " "
+                          + std::to_string(static_cast<uint64_t>(status.st_ino)) + " " + parameters;
+    return {
+        location,
+        "statistics cache " + std::to_string(cache_version) + " " + location + " "
+            + std::to_string(file_signature.size) + " " + std::to_string(file_signature.modification_time) + " "
+            + std::to_string(file_signature.fingerprint),
+    };
+}
+
+/// read_cache loads the JSON output stored in a cache file.
+/// It returns false if the file does not exist, or if it was created for another key.
+inline bool read_cache(const std::string& cache_filename, const std::string& key, std::string& json) {
+    std::ifstream stream(cache_filename, std::ifstream::in | std::ifstream::binary);
+    if (!stream.good()) {
+        return false;
+    }
+    std::string cached_key;
+    std::getline(stream, cached_key);
+    if (!stream.good() || cached_key != key) {
+        return false;
+    }
+    json.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    return !json.empty();
+}
+
+/// write_cache stores the JSON output in a cache file.
+/// The file is written under a temporary name and renamed, so that concurrent readers never see a partial file.
+/// Failures are ignored, since the cache is an optimization.
+inline void write_cache(const std::string& cache_filename, const std::string& key, const std::string& json) {
+#ifdef _WIN32
+    const auto temporary_filename = cache_filename + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    const auto temporary_filename = cache_filename + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    {
+        std::ofstream stream(temporary_filename, std::ofstream::out | std::ofstream::binary);
+        if (!stream.good()) {
+            return;
+        }
+        stream << key << '\n' << json;
+        stream.close();
+        if (stream.fail()) {
+            std::remove(temporary_filename.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    std::remove(cache_filename.c_str());
+#endif
+    if (std::rename(temporary_filename.c_str(), cache_filename.c_str()) != 0) {
+        std::remove(temporary_filename.c_str());
+    }
+}
+
 int main(int argc, char* argv[]) {
     return pontella::main(
         {
@@ -54,15 +975,49 @@ int main(int argc, char* argv[]) {
             "Available options:",
             "    -i file, --input file                  sets the path to the input .es file",
             "                                               defaults to standard input",
+            "    -d digest, --digest digest             sets the hash algorithm, one of {legacy, tree, fast}",
+            "                                               defaults to legacy",
+            "                                               tree hashes fixed runs of events independently,",
+            "                                               then hashes the runs' hashes",
+            "                                               fast calculates a single hash over all the fields",
+            "    -t threads, --threads threads          sets the number of threads (requires the tree digest)",
+            "                                               0 uses all the available cores",
+            "                                               defaults to 1",
+            "    -o prefix, --output prefix             writes per-pixel maps as npy files named after prefix",
+            "                                               (prefix_events.npy, prefix_increase_events.npy,",
+            "                                               prefix_decrease_events.npy, prefix_mean_interval.npy)",
+            "    -k count, --top count                  lists the count most active pixels",
+            "                                               defaults to 10 if --output is set, 0 otherwise",
+            "    -b duration, --bin duration            counts events in bins of the given duration (timecode)",
+            "                                               the series is written to prefix_bins.npy",
+            "                                               if --output is set",
+            "    -c, --cache                            stores the output next to the input file",
+            "                                               (/path/to/input.es.statistics), and reuses it",
+            "                                               as long as the file does not change",
+            "    -s directory, --cache-directory directory",
+            "                                           stores the cached output in a directory instead",
+            "    -r, --refresh                          ignores the cached output (the cache is updated)",
             "    -h, --help    shows this help message",
         },
         argc,
         argv,
         -1,
-        {{"input", {"i"}}},
-        {},
+        {
+            {"input", {"i"}},
+            {"digest", {"d"}},
+            {"threads", {"t"}},
+            {"output", {"o"}},
+            {"top", {"k"}},
+            {"bin", {"b"}},
+            {"cache-directory", {"s"}},
+        },
+        {
+            {"cache", {"c"}},
+            {"refresh", {"r"}},
+        },
         [](pontella::command command) {
             std::unique_ptr<std::istream> input;
+            settings statistics_settings{"", digest_algorithm::legacy, 1, "", 0, 0, false, "", false};
             {
                 const auto name_and_argument = command.options.find("input");
                 if (name_and_argument == command.options.end()) {
@@ -72,13 +1027,15 @@ int main(int argc, char* argv[]) {
 #endif
                         input = sepia::make_unique<std::istream>(std::cin.rdbuf());
                     } else if (command.arguments.size() == 1) {
-                        input = sepia::filename_to_ifstream(command.arguments.front());
+                        statistics_settings.filename = command.arguments.front();
+                        input = sepia::filename_to_ifstream(statistics_settings.filename);
                     } else {
                         throw std::runtime_error("too many arguments (expected 0 or 1)");
                     }
                 } else {
                     if (command.arguments.empty()) {
-                        input = sepia::filename_to_ifstream(name_and_argument->second);
+                        statistics_settings.filename = name_and_argument->second;
+                        input = sepia::filename_to_ifstream(statistics_settings.filename);
                     } else if (command.arguments.size() == 1) {
                         throw std::runtime_error("a filename can be passed either as a positional argument or to the "
                                                  "--input option, not both");
@@ -87,6 +1044,100 @@ int main(int argc, char* argv[]) {
                     }
                 }
             }
+            {
+                const auto name_and_argument = command.options.find("digest");
+                if (name_and_argument != command.options.end()) {
+                    if (name_and_argument->second == "tree") {
+                        statistics_settings.digest = digest_algorithm::tree;
+                    } else if (name_and_argument->second == "fast") {
+                        statistics_settings.digest = digest_algorithm::fast;
+                    } else if (name_and_argument->second != "legacy") {
+                        throw std::runtime_error("digest must be one of {legacy, tree, fast}");
+                    }
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("threads");
+                if (name_and_argument != command.options.end()) {
+                    statistics_settings.threads = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                    if (statistics_settings.threads == 0) {
+                        statistics_settings.threads = std::max(1u, std::thread::hardware_concurrency());
+                    }
+                    if (statistics_settings.threads > 1 && statistics_settings.digest != digest_algorithm::tree) {
+                        throw std::runtime_error(
+                            "only the tree digest can be calculated in parallel, use --digest tree with --threads");
+                    }
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("output");
+                if (name_and_argument != command.options.end()) {
+                    statistics_settings.prefix = name_and_argument->second;
+                    if (statistics_settings.prefix.size() > 4
+                        && statistics_settings.prefix.compare(statistics_settings.prefix.size() - 4, 4, ".npy") == 0) {
+                        statistics_settings.prefix.resize(statistics_settings.prefix.size() - 4);
+                    }
+                    if (statistics_settings.prefix.empty()) {
+                        throw std::runtime_error("the output prefix must not be empty");
+                    }
+                    statistics_settings.top = 10;
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("top");
+                if (name_and_argument != command.options.end()) {
+                    statistics_settings.top = static_cast<std::size_t>(std::stoull(name_and_argument->second));
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("bin");
+                if (name_and_argument != command.options.end()) {
+                    statistics_settings.bin_duration = timecode(name_and_argument->second).value();
+                    if (statistics_settings.bin_duration == 0) {
+                        throw std::runtime_error("the bin duration must be larger than 0");
+                    }
+                }
+            }
+            {
+                const auto name_and_argument = command.options.find("cache-directory");
+                if (name_and_argument != command.options.end()) {
+                    statistics_settings.cache = true;
+                    statistics_settings.cache_directory = name_and_argument->second;
+                }
+            }
+            if (command.flags.find("cache") != command.flags.end()) {
+                statistics_settings.cache = true;
+            }
+            statistics_settings.refresh = command.flags.find("refresh") != command.flags.end();
+            std::string cache_filename;
+            std::string cache_key;
+            if (statistics_settings.cache) {
+                if (statistics_settings.filename.empty()) {
+                    throw std::runtime_error("the cache requires an input file (standard input cannot be cached)");
+                }
+                const auto location_and_key =
+                    file_to_cache_key(statistics_settings.filename, statistics_settings.parameters());
+                cache_key = location_and_key.second;
+                if (!cache_key.empty()) {
+                    if (statistics_settings.cache_directory.empty()) {
+                        cache_filename = statistics_settings.filename + ".statistics";
+                    } else {
+                        fast_hash::hash location_hash;
+                        location_hash.update(
+                            reinterpret_cast<const uint8_t*>(location_and_key.first.data()),
+                            location_and_key.first.size());
+                        const auto name = fixed_hash_to_string(location_hash.digest());
+                        cache_filename =
+                            statistics_settings.cache_directory + "/" + name.substr(1, name.size() - 2) + ".json";
+                    }
+                    std::string json;
+                    if (!statistics_settings.refresh && statistics_settings.prefix.empty()
+                        && read_cache(cache_filename, cache_key, json)) {
+                        std::cout << json << std::endl;
+                        return;
+                    }
+                }
+            }
             const auto header = sepia::read_header(*input);
             std::vector<std::pair<std::string, std::string>> properties{
                 {"version",
@@ -100,248 +1151,27 @@ int main(int argc, char* argv[]) {
                 properties.emplace_back("height", std::to_string(header.height));
             }
             switch (header.event_stream_type) {
-                case sepia::type::generic: {
-                    auto first = true;
-                    uint64_t begin_t;
-                    uint64_t end_t;
-                    std::size_t events = 0;
-                    std::string t_hash;
-                    std::string bytes_hash;
-                    {
-                        auto hash = tarsier::make_hash<uint8_t>(
-                            [&](std::pair<uint64_t, uint64_t> hash_value) { bytes_hash = hash_to_string(hash_value); });
-                        sepia::join_observable<sepia::type::generic>(
-                            std::move(input),
-                            header,
-                            tarsier::make_replicate<sepia::generic_event>(
-                                [&](sepia::generic_event generic_event) {
-                                    if (first) {
-                                        first = false;
-                                        begin_t = generic_event.t;
-                                    }
-                                    end_t = generic_event.t;
-                                    ++events;
-                                    for (const auto character : generic_event.bytes) {
-                                        hash(character);
-                                    }
-                                },
-                                tarsier::make_convert<sepia::generic_event>(
-                                    [](sepia::generic_event generic_event) -> uint64_t { return generic_event.t; },
-                                    tarsier::make_hash<uint64_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                        t_hash = hash_to_string(hash_value);
-                                    }))));
+                case sepia::type::generic:
+                    if (statistics_settings.report()) {
+                        throw std::runtime_error("the activity report is not available for generic events");
                     }
-                    properties.emplace_back(
-                        "begin_representation", std::string("\"") + timecode(begin_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "end_representation", std::string("\"") + timecode(end_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "duration_representation", std::string("\"") + timecode(end_t - begin_t).to_string() + "\"");
-                    properties.emplace_back("begin_t", std::to_string(begin_t));
-                    properties.emplace_back("end_t", std::to_string(end_t));
-                    properties.emplace_back("duration", std::to_string(end_t - begin_t));
-                    properties.emplace_back("events", std::to_string(events));
-                    properties.emplace_back("t_hash", t_hash);
-                    properties.emplace_back("bytes_hash", bytes_hash);
-                    std::cout << properties_to_json(properties) << std::endl;
+                    statistics<sepia::type::generic>(std::move(input), header, statistics_settings, properties);
                     break;
-                }
-                case sepia::type::dvs: {
-                    auto first = true;
-                    uint64_t begin_t;
-                    uint64_t end_t;
-                    std::size_t events = 0;
-                    std::size_t increase_events = 0;
-                    std::string t_hash;
-                    std::string x_hash;
-                    std::string y_hash;
-                    sepia::join_observable<sepia::type::dvs>(
-                        std::move(input),
-                        header,
-                        tarsier::make_replicate<sepia::dvs_event>(
-                            [&](sepia::dvs_event dvs_event) {
-                                if (first) {
-                                    first = false;
-                                    begin_t = dvs_event.t;
-                                }
-                                end_t = dvs_event.t;
-                                ++events;
-                                if (dvs_event.is_increase) {
-                                    ++increase_events;
-                                }
-                            },
-                            tarsier::make_convert<sepia::dvs_event>(
-                                [](sepia::dvs_event dvs_event) -> uint64_t { return dvs_event.t; },
-                                tarsier::make_hash<uint64_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    t_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::dvs_event>(
-                                [](sepia::dvs_event dvs_event) -> uint16_t { return dvs_event.x; },
-                                tarsier::make_hash<uint16_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    x_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::dvs_event>(
-                                [](sepia::dvs_event dvs_event) -> uint16_t { return dvs_event.y; },
-                                tarsier::make_hash<uint16_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    y_hash = hash_to_string(hash_value);
-                                }))));
-                    properties.emplace_back(
-                        "begin_representation", std::string("\"") + timecode(begin_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "end_representation", std::string("\"") + timecode(end_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "duration_representation", std::string("\"") + timecode(end_t - begin_t).to_string() + "\"");
-                    properties.emplace_back("begin_t", std::to_string(begin_t));
-                    properties.emplace_back("end_t", std::to_string(end_t));
-                    properties.emplace_back("duration", std::to_string(end_t - begin_t));
-                    properties.emplace_back("events", std::to_string(events));
-                    properties.emplace_back("increase_events", std::to_string(increase_events));
-                    properties.emplace_back("t_hash", t_hash);
-                    properties.emplace_back("x_hash", x_hash);
-                    properties.emplace_back("y_hash", y_hash);
-                    std::cout << properties_to_json(properties) << std::endl;
+                case sepia::type::dvs:
+                    statistics<sepia::type::dvs>(std::move(input), header, statistics_settings, properties);
                     break;
-                }
-                case sepia::type::atis: {
-                    auto first = true;
-                    uint64_t begin_t;
-                    uint64_t end_t;
-                    std::size_t events = 0;
-                    std::size_t dvs_events = 0;
-                    std::size_t increase_events = 0;
-                    std::size_t second_events = 0;
-                    std::string t_hash;
-                    std::string x_hash;
-                    std::string y_hash;
-                    sepia::join_observable<sepia::type::atis>(
-                        std::move(input),
-                        header,
-                        tarsier::make_replicate<sepia::atis_event>(
-                            [&](sepia::atis_event atis_event) {
-                                if (first) {
-                                    first = false;
-                                    begin_t = atis_event.t;
-                                }
-                                end_t = atis_event.t;
-                                ++events;
-                                if (!atis_event.is_threshold_crossing) {
-                                    ++dvs_events;
-                                }
-                                if (atis_event.polarity) {
-                                    if (atis_event.is_threshold_crossing) {
-                                        ++second_events;
-                                    } else {
-                                        ++increase_events;
-                                    }
-                                }
-                            },
-                            tarsier::make_convert<sepia::atis_event>(
-                                [](sepia::atis_event atis_event) -> uint64_t { return atis_event.t; },
-                                tarsier::make_hash<uint64_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    t_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::atis_event>(
-                                [](sepia::atis_event atis_event) -> uint16_t { return atis_event.x; },
-                                tarsier::make_hash<uint16_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    x_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::atis_event>(
-                                [](sepia::atis_event atis_event) -> uint16_t { return atis_event.y; },
-                                tarsier::make_hash<uint16_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    y_hash = hash_to_string(hash_value);
-                                }))));
-                    properties.emplace_back(
-                        "begin_representation", std::string("\"") + timecode(begin_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "end_representation", std::string("\"") + timecode(end_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "duration_representation", std::string("\"") + timecode(end_t - begin_t).to_string() + "\"");
-                    properties.emplace_back("begin_t", std::to_string(begin_t));
-                    properties.emplace_back("end_t", std::to_string(end_t));
-                    properties.emplace_back("duration", std::to_string(end_t - begin_t));
-                    properties.emplace_back("events", std::to_string(events));
-                    properties.emplace_back("dvs_events", std::to_string(dvs_events));
-                    properties.emplace_back("increase_events", std::to_string(increase_events));
-                    properties.emplace_back("second_events", std::to_string(second_events));
-                    properties.emplace_back("t_hash", t_hash);
-                    properties.emplace_back("x_hash", x_hash);
-                    properties.emplace_back("y_hash", y_hash);
-                    std::cout << properties_to_json(properties) << std::endl;
+                case sepia::type::atis:
+                    statistics<sepia::type::atis>(std::move(input), header, statistics_settings, properties);
                     break;
-                }
-                case sepia::type::color: {
-                    auto first = true;
-                    uint64_t begin_t;
-                    uint64_t end_t;
-                    std::size_t events = 0;
-                    std::string t_hash;
-                    std::string x_hash;
-                    std::string y_hash;
-                    std::string r_hash;
-                    std::string g_hash;
-                    std::string b_hash;
-                    sepia::join_observable<sepia::type::color>(
-                        std::move(input),
-                        header,
-                        tarsier::make_replicate<sepia::color_event>(
-                            [&](sepia::color_event color_event) {
-                                if (first) {
-                                    first = false;
-                                    begin_t = color_event.t;
-                                }
-                                end_t = color_event.t;
-                                ++events;
-                            },
-                            tarsier::make_convert<sepia::color_event>(
-                                [](sepia::color_event color_event) -> uint64_t { return color_event.t; },
-                                tarsier::make_hash<uint64_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    t_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::color_event>(
-                                [](sepia::color_event color_event) -> uint16_t { return color_event.x; },
-                                tarsier::make_hash<uint16_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    x_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::color_event>(
-                                [](sepia::color_event color_event) -> uint16_t { return color_event.y; },
-                                tarsier::make_hash<uint16_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    y_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::color_event>(
-                                [](sepia::color_event color_event) -> uint8_t { return color_event.r; },
-                                tarsier::make_hash<uint8_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    r_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::color_event>(
-                                [](sepia::color_event color_event) -> uint8_t { return color_event.g; },
-                                tarsier::make_hash<uint8_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    g_hash = hash_to_string(hash_value);
-                                })),
-                            tarsier::make_convert<sepia::color_event>(
-                                [](sepia::color_event color_event) -> uint8_t { return color_event.b; },
-                                tarsier::make_hash<uint8_t>([&](std::pair<uint64_t, uint64_t> hash_value) {
-                                    b_hash = hash_to_string(hash_value);
-                                }))));
-                    properties.emplace_back(
-                        "begin_representation", std::string("\"") + timecode(begin_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "end_representation", std::string("\"") + timecode(end_t).to_string() + "\"");
-                    properties.emplace_back(
-                        "duration_representation", std::string("\"") + timecode(end_t - begin_t).to_string() + "\"");
-                    properties.emplace_back("begin_t", std::to_string(begin_t));
-                    properties.emplace_back("end_t", std::to_string(end_t));
-                    properties.emplace_back("duration", std::to_string(end_t - begin_t));
-                    properties.emplace_back("events", std::to_string(events));
-                    properties.emplace_back("t_hash", t_hash);
-                    properties.emplace_back("x_hash", x_hash);
-                    properties.emplace_back("y_hash", y_hash);
-                    properties.emplace_back("r_hash", r_hash);
-                    properties.emplace_back("g_hash", g_hash);
-                    properties.emplace_back("b_hash", b_hash);
-                    std::cout << properties_to_json(properties) << std::endl;
+                case sepia::type::color:
+                    statistics<sepia::type::color>(std::move(input), header, statistics_settings, properties);
                     break;
-                }
             }
+            const auto json = properties_to_json(properties);
+            if (!cache_filename.empty()) {
+                write_cache(cache_filename, cache_key, json);
+            }
+            std::cout << json << std::endl;
         });
     return 0;
 }
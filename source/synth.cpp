@@ -1,5 +1,6 @@
 #include "../third_party/pontella/source/pontella.hpp"
 #include "../third_party/sepia/source/sepia.hpp"
+#include "time_index.hpp"
 #include "timecode.hpp"
 #include <iostream>
 #include <sstream>
@@ -29,7 +30,7 @@ enum class output_mode {
 template <sepia::type event_stream_type>
 void synth(
     const sepia::header& header,
-    std::unique_ptr<std::istream> input_stream,
+    const std::string& input_filename,
     std::unique_ptr<std::ostream> output_stream,
     uint64_t begin_t,
     uint64_t end_t,
@@ -69,7 +70,7 @@ void synth(
     const auto sample_factor = static_cast<double>(playback_speed) / static_cast<double>(sampling_rate) * 1e6;
     const auto output_modulo =
         std::min(1u, static_cast<uint32_t>(std::round(static_cast<double>(sampling_rate) / 100.0)));
-    sepia::join_observable<event_stream_type>(std::move(input_stream), [&](sepia::event<event_stream_type> event) {
+    time_index::join_observable<event_stream_type>(input_filename, begin_t, [&](sepia::event<event_stream_type> event) {
         if (event.t >= begin_t) {
             if (event.t >= end_t) {
                 throw sepia::end_of_file();
@@ -322,7 +323,6 @@ int main(int argc, char* argv[]) {
             }
 
             const auto header = sepia::read_header(sepia::filename_to_ifstream(command.arguments[0]));
-            auto input_stream = sepia::filename_to_ifstream(command.arguments[0]);
             auto output_stream = sepia::filename_to_ofstream(command.arguments[1]);
             switch (header.event_stream_type) {
                 case sepia::type::generic: {
@@ -332,7 +332,7 @@ int main(int argc, char* argv[]) {
                 case sepia::type::dvs: {
                     synth<sepia::type::dvs>(
                         header,
-                        std::move(input_stream),
+                        command.arguments[0],
                         std::move(output_stream),
                         begin_t,
                         end_t,
@@ -349,7 +349,7 @@ int main(int argc, char* argv[]) {
                 case sepia::type::atis: {
                     synth<sepia::type::atis>(
                         header,
-                        std::move(input_stream),
+                        command.arguments[0],
                         std::move(output_stream),
                         begin_t,
                         end_t,
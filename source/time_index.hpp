@@ -0,0 +1,301 @@
+#pragma once
+
+#include "../third_party/sepia/source/sepia.hpp"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/// time_index maps timestamps to byte offsets in an Event Stream file, so that tools can skip the beginning of long
+/// recordings. The index is stored in a sidecar file (the Event Stream filename followed by .idx), built by es_index.
+namespace time_index {
+    /// entry maps a byte offset to the number of events before it, and to the timestamp of the last of them.
+    /// The offset is always an event boundary, hence decoding can resume from it with t as base timestamp.
+    struct entry {
+        uint64_t offset;
+        uint64_t t;
+        uint64_t events;
+    };
+
+    /// signature identifies the indexed file's content.
+    /// modification_time is in nanoseconds, with the resolution of the file system (seconds on Windows).
+    /// fingerprint hashes evenly spaced blocks of the content, to detect rewrites within that resolution.
+    struct signature {
+        uint64_t size;
+        uint64_t modification_time;
+        uint64_t fingerprint;
+    };
+
+    /// magic_number is written at the beginning of index files.
+    constexpr const char* magic_number = "Event Stream Index";
+
+    /// version is incremented whenever the index format changes.
+    constexpr uint8_t version = 2;
+
+    /// default_period is the default number of events between two entries.
+    constexpr uint64_t default_period = 1 << 16;
+
+    /// filename_to_index_filename returns the index sidecar's filename.
+    inline std::string filename_to_index_filename(const std::string& filename) {
+        return filename + ".idx";
+    }
+
+    /// fingerprint_samples is the number of blocks hashed to fingerprint a file.
+    constexpr uint64_t fingerprint_samples = 16;
+
+    /// fingerprint_sample_size is the size in bytes of a fingerprint block.
+    constexpr uint64_t fingerprint_sample_size = 1 << 12;
+
+    /// filename_to_fingerprint hashes (FNV-1a) evenly spaced blocks of a file, including its first and last bytes.
+    inline uint64_t filename_to_fingerprint(const std::string& filename, uint64_t size) {
+        std::ifstream stream(filename, std::ifstream::in | std::ifstream::binary);
+        uint64_t fingerprint = 0xcbf29ce484222325ull;
+        std::vector<char> bytes(fingerprint_sample_size);
+        const auto last_offset = size > fingerprint_sample_size ? size - fingerprint_sample_size : 0;
+        for (uint64_t index = 0; stream.good() && index < fingerprint_samples; ++index) {
+            stream.seekg(static_cast<std::streamoff>(last_offset * index / (fingerprint_samples - 1)));
+            stream.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            const auto read_size = static_cast<std::size_t>(stream.gcount());
+            for (std::size_t byte_index = 0; byte_index < read_size; ++byte_index) {
+                fingerprint = (fingerprint ^ static_cast<uint8_t>(bytes[byte_index])) * 0x100000001b3ull;
+            }
+            stream.clear();
+        }
+        return fingerprint;
+    }
+
+    /// filename_to_signature returns the size, modification time and fingerprint of a file.
+    /// A zero signature is returned if the file does not exist.
+    inline signature filename_to_signature(const std::string& filename) {
+        struct stat status;
+        if (stat(filename.c_str(), &status) != 0) {
+            return {0, 0, 0};
+        }
+        const auto size = static_cast<uint64_t>(status.st_size);
+#if defined(__APPLE__)
+        const auto modification_time = static_cast<uint64_t>(status.st_mtimespec.tv_sec) * 1000000000
+                                       + static_cast<uint64_t>(status.st_mtimespec.tv_nsec);
+#elif defined(_WIN32)
+        const auto modification_time = static_cast<uint64_t>(status.st_mtime) * 1000000000;
+#else
+        const auto modification_time = static_cast<uint64_t>(status.st_mtim.tv_sec) * 1000000000
+                                       + static_cast<uint64_t>(status.st_mtim.tv_nsec);
+#endif
+        return {size, modification_time, filename_to_fingerprint(filename, size)};
+    }
+
+    /// write_uint64 writes an integer in little endian.
+    inline void write_uint64(std::ostream& stream, uint64_t value) {
+        std::array<uint8_t, 8> bytes;
+        for (std::size_t index = 0; index < bytes.size(); ++index) {
+            bytes[index] = static_cast<uint8_t>((value >> (8 * index)) & 0xff);
+        }
+        stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    /// read_uint64 reads an integer in little endian.
+    inline uint64_t read_uint64(std::istream& stream) {
+        std::array<uint8_t, 8> bytes;
+        stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        uint64_t value = 0;
+        for (std::size_t index = 0; index < bytes.size(); ++index) {
+            value |= static_cast<uint64_t>(bytes[index]) << (8 * index);
+        }
+        return value;
+    }
+
+    /// build decodes an Event Stream and returns an entry every period events.
+    /// The stream must be positioned after the header, at the given offset.
+    template <sepia::type event_stream_type>
+    inline std::vector<entry> build(
+        std::istream& stream,
+        const sepia::header& header,
+        uint64_t offset,
+        uint64_t period) {
+        std::vector<entry> entries;
+        sepia::handle_byte<event_stream_type> handle_byte(header.width, header.height);
+        sepia::event<event_stream_type> event = {};
+        uint64_t events = 0;
+        std::vector<uint8_t> bytes(1 << 16);
+        for (;;) {
+            stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+            const auto size = static_cast<std::size_t>(stream.gcount());
+            for (std::size_t index = 0; index < size; ++index) {
+                if (handle_byte(bytes[index], event)) {
+                    ++events;
+                    if (events % period == 0) {
+                        entries.push_back({offset + index + 1, event.t, events});
+                    }
+                }
+            }
+            offset += size;
+            if (stream.eof()) {
+                break;
+            }
+        }
+        return entries;
+    }
+
+    /// write creates an index file.
+    inline void write(const std::string& index_filename, signature file_signature, const std::vector<entry>& entries) {
+        auto stream = sepia::filename_to_ofstream(index_filename);
+        stream->write(magic_number, std::char_traits<char>::length(magic_number));
+        stream->put(static_cast<char>(version));
+        write_uint64(*stream, file_signature.size);
+        write_uint64(*stream, file_signature.modification_time);
+        write_uint64(*stream, file_signature.fingerprint);
+        write_uint64(*stream, entries.size());
+        for (const auto& index_entry : entries) {
+            write_uint64(*stream, index_entry.offset);
+            write_uint64(*stream, index_entry.t);
+            write_uint64(*stream, index_entry.events);
+        }
+    }
+
+    /// read loads the index of an Event Stream file.
+    /// An empty vector is returned if the index does not exist, is invalid,
+    /// or was built before the last modification of the Event Stream file.
+    inline std::vector<entry> read(const std::string& filename) {
+        std::ifstream stream(filename_to_index_filename(filename), std::ifstream::in | std::ifstream::binary);
+        if (!stream.good()) {
+            return {};
+        }
+        std::string read_magic_number(std::char_traits<char>::length(magic_number), '\0');
+        stream.read(&read_magic_number[0], read_magic_number.size());
+        if (!stream.good() || read_magic_number != magic_number || stream.get() != version) {
+            return {};
+        }
+        const auto file_signature = filename_to_signature(filename);
+        const auto size = read_uint64(stream);
+        const auto modification_time = read_uint64(stream);
+        const auto fingerprint = read_uint64(stream);
+        if (!stream.good() || size != file_signature.size || modification_time != file_signature.modification_time
+            || fingerprint != file_signature.fingerprint) {
+            return {};
+        }
+        const auto entries_size = read_uint64(stream);
+        if (!stream.good() || entries_size > size) {
+            return {};
+        }
+        std::vector<entry> entries(static_cast<std::size_t>(entries_size));
+        for (auto& index_entry : entries) {
+            index_entry.offset = read_uint64(stream);
+            index_entry.t = read_uint64(stream);
+            index_entry.events = read_uint64(stream);
+        }
+        if (!stream.good()) {
+            return {};
+        }
+        return entries;
+    }
+
+    /// read_or_build loads the index of an Event Stream file, or builds it in memory if the file has no valid index.
+    template <sepia::type event_stream_type>
+    inline std::vector<entry> read_or_build(const std::string& filename, uint64_t period) {
+        auto entries = read(filename);
+        if (entries.empty()) {
+            auto stream = sepia::filename_to_ifstream(filename);
+            const auto header = sepia::read_header(*stream);
+            const auto offset = static_cast<uint64_t>(stream->tellg());
+            entries = build<event_stream_type>(*stream, header, offset, period);
+        }
+        return entries;
+    }
+
+    /// seek moves a stream forward to the last entry whose previous events are all before begin_t,
+    /// and returns the timestamp of the last event before the new position.
+    /// The stream must be positioned after the header. It is left untouched (and 0 is returned) if no entry
+    /// precedes begin_t. Events before begin_t may still follow the new position.
+    inline uint64_t seek(std::istream& stream, const std::vector<entry>& entries, uint64_t begin_t) {
+        const auto entry_after =
+            std::lower_bound(entries.begin(), entries.end(), begin_t, [](const entry& index_entry, uint64_t t) {
+                return index_entry.t < t;
+            });
+        if (entry_after == entries.begin()) {
+            return 0;
+        }
+        const auto index_entry = *std::prev(entry_after);
+        stream.seekg(static_cast<std::streamoff>(index_entry.offset));
+        return index_entry.t;
+    }
+
+    /// seek moves a stream forward using the index of an Event Stream file (see the entries overload).
+    /// The stream is left untouched (and 0 is returned) if the file has no valid index.
+    inline uint64_t seek(std::istream& stream, const std::string& filename, uint64_t begin_t) {
+        if (begin_t == 0) {
+            return 0;
+        }
+        return seek(stream, read(filename), begin_t);
+    }
+
+    /// range_observable dispatches the events stored between two event boundaries of an Event Stream file.
+    /// base_t must be the timestamp of the last event before begin (0 if begin is the end of the header).
+    /// Each call opens its own stream, hence ranges can be decoded concurrently.
+    template <sepia::type event_stream_type, typename HandleEvent>
+    inline void range_observable(
+        const std::string& filename,
+        const sepia::header& header,
+        uint64_t begin,
+        uint64_t end,
+        uint64_t base_t,
+        HandleEvent&& handle_event) {
+        auto stream = sepia::filename_to_ifstream(filename);
+        stream->seekg(static_cast<std::streamoff>(begin));
+        sepia::handle_byte<event_stream_type> handle_byte(header.width, header.height);
+        sepia::event<event_stream_type> event = {};
+        event.t = base_t;
+        std::vector<uint8_t> bytes(1 << 16);
+        for (auto offset = begin; offset < end;) {
+            stream->read(
+                reinterpret_cast<char*>(bytes.data()),
+                static_cast<std::streamsize>(std::min(static_cast<uint64_t>(bytes.size()), end - offset)));
+            const auto size = static_cast<std::size_t>(stream->gcount());
+            if (size == 0) {
+                break;
+            }
+            for (std::size_t index = 0; index < size; ++index) {
+                if (handle_byte(bytes[index], event)) {
+                    handle_event(event);
+                }
+            }
+            offset += size;
+        }
+    }
+
+    /// join_observable dispatches the events of an Event Stream file, using the given entries
+    /// to skip most of the events before begin_t. Events before begin_t may still be dispatched.
+    template <sepia::type event_stream_type, typename HandleEvent>
+    inline void join_observable(
+        const std::string& filename,
+        const std::vector<entry>& entries,
+        uint64_t begin_t,
+        HandleEvent&& handle_event) {
+        auto stream = sepia::filename_to_ifstream(filename);
+        const auto header = sepia::read_header(*stream);
+        const auto base_t = seek(*stream, entries, begin_t);
+        if (base_t == 0) {
+            sepia::join_observable<event_stream_type>(
+                std::move(stream), header, std::forward<HandleEvent>(handle_event));
+        } else {
+            sepia::join_observable<event_stream_type>(
+                std::move(stream), header, [&](sepia::event<event_stream_type> event) {
+                    event.t += base_t;
+                    handle_event(event);
+                });
+        }
+    }
+
+    /// join_observable dispatches the events of an Event Stream file, using its index (if any)
+    /// to skip most of the events before begin_t. Events before begin_t may still be dispatched.
+    template <sepia::type event_stream_type, typename HandleEvent>
+    inline void join_observable(const std::string& filename, uint64_t begin_t, HandleEvent&& handle_event) {
+        join_observable<event_stream_type>(
+            filename,
+            begin_t == 0 ? std::vector<entry>() : read(filename),
+            begin_t,
+            std::forward<HandleEvent>(handle_event));
+    }
+}